@@ -0,0 +1,137 @@
+/*
+    CPU placement benchmark for bg --place.
+    Runs N CPU-bound children for a fixed time, first all inheriting
+    the parent's affinity (what plain bg does) and then pinned one per
+    cpu round robin (bg --place=rr), and reports the total work done
+    and how often the scheduler migrated them between cpus.
+
+    Run: make bench-affinity
+    Or:  ./bench/bench_affinity [jobs] [seconds]
+ */
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// What one child reports back through the pipe
+typedef struct {
+    unsigned long long iterations;
+    long migrations;
+} Result;
+
+// Monotonic clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// se.nr_migrations of the calling process, -1 without CONFIG_SCHED_DEBUG
+static long own_migrations(void) {
+    FILE *file = fopen("/proc/self/sched", "r");
+    char line[256];
+    long migrations = -1;
+
+    if (file == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "se.nr_migrations", 16) == 0) {
+            char *colon = strchr(line, ':');
+            migrations = colon ? atol(colon + 1) : -1;
+            break;
+        }
+    }
+    fclose(file);
+    return migrations;
+}
+
+// Child body: spin for seconds, counting loop iterations
+static void spin(double seconds, int fd) {
+    volatile unsigned long long counter = 0;
+    double end = now_seconds() + seconds;
+    Result result;
+
+    while (now_seconds() < end) {
+        for (int i = 0; i < 100000; i++) {
+            counter++;
+        }
+    }
+    result.iterations = counter;
+    result.migrations = own_migrations();
+    write(fd, &result, sizeof(result));
+    _exit(0);
+}
+
+// Runs the children, pinned round robin over the allowed cpus if pin is set
+static void run(const char *name, int jobs, double seconds, int pin, const cpu_set_t *allowed) {
+    int fds[2];
+    int cpu = -1;
+    Result total = {0, 0};
+
+    if (pipe(fds) == -1) {
+        perror("pipe failed");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        pid_t pid = fork();
+
+        if (pid == -1) {
+            perror("fork failed");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            spin(seconds, fds[1]);
+        }
+        if (pin) {
+            cpu_set_t one;
+
+            // Next allowed cpu after the last one used
+            do {
+                cpu = (cpu + 1) % CPU_SETSIZE;
+            } while (!CPU_ISSET(cpu, allowed));
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            sched_setaffinity(pid, sizeof(one), &one);
+        }
+    }
+    close(fds[1]);
+
+    Result result;
+    while (read(fds[0], &result, sizeof(result)) == sizeof(result)) {
+        total.iterations += result.iterations;
+        total.migrations += result.migrations;
+    }
+    close(fds[0]);
+    while (wait(NULL) > 0) {
+    }
+
+    printf("%-10s %6d %14.1f %12ld\n", name, jobs,
+           total.iterations / seconds / 1e6, total.migrations);
+}
+
+int main(int argc, char **argv) {
+    cpu_set_t allowed;
+
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int jobs = (argc > 1) ? atoi(argv[1]) : CPU_COUNT(&allowed);
+    double seconds = (argc > 2) ? atof(argv[2]) : 2.0;
+
+    if (jobs <= 0 || seconds <= 0) {
+        fprintf(stderr, "Usage: %s [jobs] [seconds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d cpus, %d jobs, %.1f s each\n", CPU_COUNT(&allowed), jobs, seconds);
+    printf("%-10s %6s %14s %12s\n", "placement", "jobs", "Miter/s total", "migrations");
+    run("inherit", jobs, seconds, 0, &allowed);
+    run("rr", jobs, seconds, 1, &allowed);
+    return 0;
+}
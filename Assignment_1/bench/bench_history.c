@@ -0,0 +1,79 @@
+/*
+    Memory and speed of the finished jobs history (bghistory).
+    Records a million synthetic exits, then reports how much the
+    process grew, what one recordExit() costs and how long the
+    bghistory summary over all of them takes.
+
+    Run: make bench-history
+    Or:  ./bench/bench_history [jobs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "../exit_history.h"
+
+// Monotonic clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Resident set size of this process in MB, from /proc/self/statm
+static double rss_mb(void) {
+    FILE *file = fopen("/proc/self/statm", "r");
+    long size = 0, resident = 0;
+
+    if (file == NULL) {
+        return 0;
+    }
+    if (fscanf(file, "%ld %ld", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(file);
+    return resident * (double) sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+int main(int argc, char **argv) {
+    const char *paths[] = {"/bin/true", "/bin/sleep", "/usr/bin/make", "/usr/bin/gcc",
+                           "/home/user/build/worker", "/usr/bin/python3", "/bin/sh", "./a.out"};
+    long jobs = (argc > 1) ? atol(argv[1]) : HISTORY_CAPACITY;
+    ExitHistory history;
+    struct rusage usage;
+
+    if (jobs <= 0) {
+        fprintf(stderr, "Usage: %s [jobs]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double before = rss_mb();
+    initExitHistory(&history, HISTORY_CAPACITY);
+
+    memset(&usage, 0, sizeof(usage));
+    double start = now_seconds();
+    for (long i = 0; i < jobs; i++) {
+        usage.ru_utime.tv_usec = i % 1000000;
+        usage.ru_stime.tv_usec = (i * 7) % 1000000;
+        usage.ru_maxrss = 1000 + i % 50000;
+        usage.ru_inblock = i % 13;
+        usage.ru_oublock = i % 17;
+        recordExit(&history, 1000 + (pid_t) (i % 4000000), paths[i % 8], (int) (i % 3) << 8,
+                   &usage, 1000 + (uint64_t) (i * 2654435761u % 10000000));
+    }
+    double record_seconds = now_seconds() - start;
+    double after = rss_mb();
+
+    printf("%ld exits recorded, history keeps %zu\n", jobs, history.count);
+    printf("recordExit:     %.1f ns each\n", record_seconds / jobs * 1e9);
+    printf("history:        %.1f MB reserved, process grew %.1f MB\n",
+           exitHistoryBytes(&history) / (double) (1 << 20), after - before);
+
+    // The summary goes to stdout like bghistory -s, timed around it
+    start = now_seconds();
+    printExitSummary(&history);
+    printf("summary:        %.1f ms\n", (now_seconds() - start) * 1e3);
+    return 0;
+}
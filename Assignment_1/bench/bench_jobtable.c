@@ -0,0 +1,64 @@
+/*
+    Microbenchmark for the pman job table.
+    For each table size N the table is first filled with N jobs, then
+    one "command" (add a job, look it up, remove it) is timed over many
+    rounds. With the hash table the per-command time should stay flat
+    from 10 to 100k tracked jobs.
+
+    Run: make bench-jobtable
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/types.h>
+#include "../job_table.h"
+
+#define ROUNDS 200000
+
+// Monotonic clock in nanoseconds
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void) {
+    const int sizes[] = {10, 100, 1000, 10000, 100000};
+    const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("%10s %14s %14s %14s\n", "jobs", "add ns", "find ns", "remove ns");
+    for (int s = 0; s < num_sizes; s++) {
+        JobTable table;
+        int n = sizes[s];
+
+        initJobTable(&table);
+        // Pids are spread out like a busy system would hand them out
+        for (int i = 0; i < n; i++) {
+            add_newJob(&table, 1000 + i * 7, "/bin/sleep");
+        }
+
+        double add_ns = 0, find_ns = 0, remove_ns = 0;
+        pid_t probe = 5000000;
+        for (int r = 0; r < ROUNDS; r++) {
+            double t0 = now_ns();
+            Job *job = add_newJob(&table, probe + r, "/bin/true");
+            double t1 = now_ns();
+            if (findJob(&table, probe + r) != job) {
+                fprintf(stderr, "lookup mismatch for %d\n", probe + r);
+                return EXIT_FAILURE;
+            }
+            double t2 = now_ns();
+            removeJob(&table, job);
+            double t3 = now_ns();
+
+            add_ns += t1 - t0;
+            find_ns += t2 - t1;
+            remove_ns += t3 - t2;
+        }
+
+        printf("%10d %14.1f %14.1f %14.1f\n", n,
+               add_ns / ROUNDS, find_ns / ROUNDS, remove_ns / ROUNDS);
+        freeJobTable(&table);
+    }
+    return 0;
+}
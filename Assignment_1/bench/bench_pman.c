@@ -0,0 +1,323 @@
+/*
+    End to end latency benchmark for pman's command paths.
+    Starts pman --daemon, fills its job table with sleeping jobs and,
+    at every table size, times samples of each command through the
+    control socket, the way pmanctl sends them:
+        bg        launching /bin/sleep
+        pstat     of one job
+        bgstop    and bgstart of one job
+        bgkill    round trip, the exit is reported later by the pidfd
+        reap      from kill() outside pman until pman reports the exit
+    One CSV row per command and table size goes to stdout (or -o file),
+    p50/p99 in microseconds and the rate of back to back requests.
+    jobs is the number of sleeping jobs in the table besides the samples.
+    Table sizes go 1, 10, 100, ... up to -m, sizes the pid or fd limits
+    cannot hold are skipped with a note on stderr.
+
+    Run: make bench-pman
+    Or:  ./bench/bench_pman [-m max_jobs] [-n samples] [-o file]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include "../protocol.h"
+
+// Commands timed at every table size, in CSV order
+enum { OP_BG, OP_PSTAT, OP_BGSTOP, OP_BGSTART, OP_BGKILL, OP_REAP, OP_COUNT };
+static const char *op_names[OP_COUNT] = {"bg", "pstat", "bgstop", "bgstart", "bgkill", "reap"};
+
+// Jobs pman may need beyond the table itself: the samples and some slack
+#define HEADROOM 64
+
+static pid_t pman_pid = -1;
+static FILE *pman_out;     // pman's stdout, where exits are reported
+static int ctl_fd = -1;
+static char socket_path[64];
+static pid_t jobs_pgid = -1;  // process group every table job joins (bg --pgroup=bench)
+
+// Monotonic clock in microseconds
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/*  Sends one command and waits for the answer, *elapsed gets the
+    round trip in microseconds. The answer is malloc'd.
+ */
+static char * request(const char *command, double *elapsed) {
+    uint32_t len;
+    double start = now_us();
+
+    if (sendFrame(ctl_fd, command, strlen(command)) == -1) {
+        perror("sending to pman failed");
+        exit(EXIT_FAILURE);
+    }
+    char *answer = recvFrame(ctl_fd, &len);
+    if (answer == NULL) {
+        fprintf(stderr, "pman closed the connection\n");
+        exit(EXIT_FAILURE);
+    }
+    if (elapsed != NULL) {
+        *elapsed = now_us() - start;
+    }
+    return answer;
+}
+
+/*  Starts pman --daemon and the first table job, which leads the
+    process group the others join. Jobs lead a group of their own
+    otherwise, killing pman's group would not reach them.
+ */
+static void start_pman(void) {
+    int fds[2];
+    char line[256];
+
+    snprintf(socket_path, sizeof(socket_path), "/tmp/pman-bench-%d.sock", getpid());
+    if (pipe(fds) == -1) {
+        perror("pipe failed");
+        exit(EXIT_FAILURE);
+    }
+    pman_pid = fork();
+    if (pman_pid == -1) {
+        perror("fork failed");
+        exit(EXIT_FAILURE);
+    }
+    if (pman_pid == 0) {
+        setpgid(0, 0);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl("./pman", "pman", "--daemon", "--socket", socket_path, "--state", "off", (char *) NULL);
+        perror("./pman");
+        _exit(127);
+    }
+    close(fds[1]);
+    pman_out = fdopen(fds[0], "r");
+
+    // The first line says the socket is ready
+    if (fgets(line, sizeof(line), pman_out) == NULL) {
+        fprintf(stderr, "pman did not start\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    ctl_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ctl_fd == -1 || connect(ctl_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        perror(socket_path);
+        exit(EXIT_FAILURE);
+    }
+
+    char *answer = request("bg --log=off --pgroup=bench /bin/sleep 100000", NULL);
+    if (sscanf(answer, "Process with PID %d", &jobs_pgid) != 1) {
+        fprintf(stderr, "bg failed: %s", answer);
+        exit(EXIT_FAILURE);
+    }
+    free(answer);
+}
+
+// Quits pman and kills every table job, the leader keeps their group alive until then
+static void stop_pman(void) {
+    free(request("q", NULL));
+    kill(-jobs_pgid, SIGKILL);
+    kill(-pman_pid, SIGKILL);
+    waitpid(pman_pid, NULL, 0);
+    fclose(pman_out);
+}
+
+// Largest table the pid and fd limits leave room for
+static long table_limit(void) {
+    struct rlimit limit;
+    long most = 0;
+    FILE *file = fopen("/proc/sys/kernel/pid_max", "r");
+
+    if (file != NULL) {
+        if (fscanf(file, "%ld", &most) != 1) {
+            most = 0;
+        }
+        fclose(file);
+    }
+    // Every job holds one pidfd in pman
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_max != RLIM_INFINITY
+        && (most == 0 || (long) limit.rlim_max < most)) {
+        most = limit.rlim_max;
+    }
+    if (getrlimit(RLIMIT_NPROC, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+        && (most == 0 || (long) limit.rlim_cur < most)) {
+        most = limit.rlim_cur;
+    }
+    return most;
+}
+
+// Grows the table to size sleeping jobs with one bgmany
+static void fill_table(long *current, long size) {
+    char command[128];
+
+    if (size <= *current) {
+        return;
+    }
+    snprintf(command, sizeof(command), "bgmany %ld --log=off --pgroup=bench /bin/sleep 100000", size - *current);
+    char *answer = request(command, NULL);
+    if (strncmp(answer, "Started", 7) != 0) {
+        fprintf(stderr, "bgmany failed: %s", answer);
+        exit(EXIT_FAILURE);
+    }
+    free(answer);
+    *current = size;
+}
+
+// Waits until pman reports that pid was killed
+static void wait_for_exit(pid_t pid) {
+    char line[256];
+    char expect[64];
+
+    snprintf(expect, sizeof(expect), "Process %d was killed", pid);
+    while (fgets(line, sizeof(line), pman_out) != NULL) {
+        if (strncmp(line, expect, strlen(expect)) == 0) {
+            return;
+        }
+    }
+    fprintf(stderr, "pman exited\n");
+    exit(EXIT_FAILURE);
+}
+
+// Prints the CSV row of one command at one table size
+static void report(FILE *out, int op, long size, double *times, int count) {
+    double total = 0;
+
+    if (count == 0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        total += times[i];
+    }
+    qsort(times, count, sizeof(double), compare_doubles);
+    fprintf(out, "%s,%ld,%d,%.1f,%.1f,%.0f\n", op_names[op], size, count,
+            times[count / 2], times[(count * 99) / 100], count / (total / 1e6));
+    fflush(out);
+}
+
+/*  Times every command samples times against a table of size jobs.
+    The sampled jobs are started by the bg samples and are gone again
+    afterwards, half through bgkill and half killed from outside.
+ */
+static void run_size(FILE *out, long size, int samples) {
+    double *times[OP_COUNT];
+    int counts[OP_COUNT] = {0};
+    pid_t *pids = malloc(samples * sizeof(pid_t));
+    char command[64];
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        times[op] = malloc(samples * sizeof(double));
+    }
+
+    for (int i = 0; i < samples; i++) {
+        char *answer = request("bg --log=off /bin/sleep 100000", &times[OP_BG][counts[OP_BG]++]);
+        if (sscanf(answer, "Process with PID %d", &pids[i]) != 1) {
+            fprintf(stderr, "bg failed: %s", answer);
+            exit(EXIT_FAILURE);
+        }
+        free(answer);
+    }
+
+    // Each command over all samples in turn, so the rate is of like requests
+    const int per_job[] = {OP_PSTAT, OP_BGSTOP, OP_BGSTART};
+    for (int k = 0; k < 3; k++) {
+        int op = per_job[k];
+        for (int i = 0; i < samples; i++) {
+            snprintf(command, sizeof(command), "%s %d", op_names[op], pids[i]);
+            free(request(command, &times[op][counts[op]++]));
+        }
+    }
+
+    for (int i = 0; i < samples; i++) {
+        if (i % 2 == 0) {
+            snprintf(command, sizeof(command), "bgkill %d", pids[i]);
+            free(request(command, &times[OP_BGKILL][counts[OP_BGKILL]++]));
+        }
+        else {
+            double start = now_us();
+            kill(pids[i], SIGKILL);
+            wait_for_exit(pids[i]);
+            times[OP_REAP][counts[OP_REAP]++] = now_us() - start;
+        }
+    }
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        report(out, op, size, times[op], counts[op]);
+        free(times[op]);
+    }
+    free(pids);
+}
+
+int main(int argc, char **argv) {
+    long max_jobs = 100000;
+    int samples = 200;
+    FILE *out = stdout;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:n:o:")) != -1) {
+        switch (opt) {
+        case 'm':
+            max_jobs = atol(optarg);
+            break;
+        case 'n':
+            samples = atoi(optarg);
+            break;
+        case 'o':
+            out = fopen(optarg, "w");
+            if (out == NULL) {
+                perror(optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-m max_jobs] [-n samples] [-o file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_jobs <= 0 || samples < 2) {
+        fprintf(stderr, "Usage: %s [-m max_jobs] [-n samples] [-o file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // pman raises its soft fd limit to the hard one, the sizes are checked against that
+    long limit = table_limit() - samples - HEADROOM;
+
+    signal(SIGPIPE, SIG_IGN);
+    start_pman();
+    fprintf(out, "op,jobs,samples,p50_us,p99_us,ops_per_sec\n");
+
+    // The group leader is the first table job
+    long current = 1;
+    for (long size = 1; size <= max_jobs; size *= 10) {
+        if (limit > 0 && size > limit) {
+            fprintf(stderr, "skipping %ld jobs: pid/fd limits leave room for %ld\n", size, limit);
+            break;
+        }
+        fill_table(&current, size);
+        run_size(out, size, samples);
+    }
+
+    stop_pman();
+    unlink(socket_path);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Many short jobs through pman's bgqueue against xargs -P.
+# pman runs in a scratch directory with --state off and bgqueue --log=off,
+# so neither side creates files for the jobs.
+# Run: make bench-queue
+# Or:  sh bench/bench_queue.sh [commands] [parallel]
+N=${1:-2000}
+P=${2:-4}
+PMAN=$(cd "$(dirname "$0")/.." && pwd)/pman
+WORK=$(mktemp -d)
+LIST="$WORK/commands.txt"
+trap 'rm -rf "$WORK"' EXIT
+
+# Both run /bin/true with one argument per command
+i=0
+while [ "$i" -lt "$N" ]; do
+    echo "/bin/true $i"
+    i=$((i + 1))
+done > "$LIST"
+
+now() {
+    date +%s.%N
+}
+
+echo "$N commands, $P at a time"
+
+start=$(now)
+cut -d ' ' -f 2 "$LIST" | xargs -P "$P" -n 1 /bin/true
+end=$(now)
+echo "xargs -P   $(echo "$start $end $N" | awk '{ printf "%.3f s  %.0f commands/s", $2 - $1, $3 / ($2 - $1) }')"
+
+start=$(now)
+echo "bgqueue -j $P --log=off -f $LIST" | (cd "$WORK" && "$PMAN" --state off > /dev/null 2>&1)
+end=$(now)
+echo "bgqueue    $(echo "$start $end $N" | awk '{ printf "%.3f s  %.0f commands/s", $2 - $1, $3 / ($2 - $1) }')"
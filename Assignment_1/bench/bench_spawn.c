@@ -0,0 +1,96 @@
+/*
+    Spawn rate benchmark for pman's launcher.
+    Compares the old fork() + exec path of func_BG with posix_spawn
+    (clone(CLONE_VM | CLONE_VFORK) in glibc) while the parent holds
+    a growing amount of touched memory, the way a long running pman
+    with a big job table would.
+
+    Run: make bench-spawn
+    Or:  ./bench/bench_spawn [spawns] [parent_mb ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// Monotonic clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Old path: fork, then exec in the child
+static pid_t spawn_fork(char *const argv[]) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+// New path: posix_spawn
+static pid_t spawn_posix(char *const argv[]) {
+    pid_t pid;
+
+    if (posix_spawn(&pid, argv[0], NULL, NULL, argv, environ) != 0) {
+        return -1;
+    }
+    return pid;
+}
+
+// Launches n children, returns spawns per second of the launch phase
+static double run(pid_t (*spawn)(char *const[]), int n) {
+    char *argv[] = {"/bin/true", NULL};
+    double start = now_seconds();
+
+    for (int i = 0; i < n; i++) {
+        if (spawn(argv) < 0) {
+            perror("spawn failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    // Reap outside the timed section
+    while (wait(NULL) > 0) {
+    }
+    return n / elapsed;
+}
+
+int main(int argc, char **argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : 2000;
+    int default_sizes[] = {0, 64, 256};
+    int num_sizes = (argc > 2) ? argc - 2 : 3;
+
+    printf("%10s %16s %16s %8s\n", "parent MB", "fork+exec/s", "posix_spawn/s", "speedup");
+    for (int s = 0; s < num_sizes; s++) {
+        int mb = (argc > 2) ? atoi(argv[s + 2]) : default_sizes[s];
+        size_t bytes = (size_t)mb << 20;
+        char *ballast = NULL;
+
+        // Touch every page so it is really mapped in the parent
+        if (bytes > 0) {
+            ballast = malloc(bytes);
+            if (ballast == NULL) {
+                perror("malloc failed");
+                return EXIT_FAILURE;
+            }
+            memset(ballast, 1, bytes);
+        }
+
+        double forked = run(spawn_fork, n);
+        double spawned = run(spawn_posix, n);
+        printf("%10d %16.0f %16.0f %7.1fx\n", mb, forked, spawned, spawned / forked);
+        free(ballast);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+    Startup time of pman with a large state file.
+    Writes a state file with 100k job records, of which a thousand
+    belong to sleeping children of the benchmark and the rest to
+    jobs that are gone, then times ./pman --state <file> until it
+    has reattached the live ones and quit, against --state off.
+    A second run shows the file once the gone jobs are freed.
+
+    Run: make bench-state
+    Or:  ./bench/bench_state [records] [live]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "../job_state.h"
+#include "../proc_sampler.h"
+
+// Monotonic clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Start time of pid in clock ticks after boot, 0 if it cannot be read
+static unsigned long long starttime_of(pid_t pid) {
+    ProcSampler sampler;
+    ProcSample sample;
+    unsigned long long starttime = 0;
+
+    initProcSampler(&sampler, pid);
+    if (sampleProc(&sampler, &sample, SAMPLE_STAT) == 0) {
+        starttime = sample.starttime;
+    }
+    closeProcSampler(&sampler);
+    return starttime;
+}
+
+// Runs ./pman with --state value on empty input, returns how long it took in ms
+static double time_pman(const char *value) {
+    double start = now_seconds();
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execl("./pman", "./pman", "--state", value, "-f", "/dev/null", (char *) NULL);
+        perror("./pman");
+        _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+    return (now_seconds() - start) * 1e3;
+}
+
+int main(int argc, char **argv) {
+    long records = (argc > 1) ? atol(argv[1]) : 100000;
+    long live = (argc > 2) ? atol(argv[2]) : 1000;
+    char path[64];
+
+    if (records <= 0 || live < 0 || live > records) {
+        fprintf(stderr, "Usage: %s [records] [live]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    snprintf(path, sizeof(path), "/tmp/pman-bench-%d.state", getpid());
+
+    pid_t *children = calloc(live ? live : 1, sizeof(pid_t));
+    if (children == NULL) {
+        perror("calloc failed");
+        return EXIT_FAILURE;
+    }
+    for (long i = 0; i < live; i++) {
+        children[i] = fork();
+        if (children[i] == 0) {
+            pause();
+            _exit(0);
+        }
+    }
+
+    // Written from a child, so its lock on the file is gone once it exits
+    double start = now_seconds();
+    pid_t writer = fork();
+    if (writer == 0) {
+        if (openJobState(path, NULL) == -1) {
+            _exit(1);
+        }
+        for (long i = 0; i < records; i++) {
+            if (i < live) {
+                saveJobState(children[i], starttime_of(children[i]), children[i], "/bin/sleep", NULL, "bench");
+            }
+            else {
+                // A pid that may exist, but never with this start time
+                saveJobState(2 + (pid_t) (i % 30000), 1, 0, "/home/user/build/worker", NULL, NULL);
+            }
+        }
+        _exit(0);
+    }
+    int status;
+    waitpid(writer, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Could not write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    printf("%ld records (%ld live) written in %.1f ms\n", records, live, (now_seconds() - start) * 1e3);
+    fflush(stdout);
+
+    // pman prints how many it reattached, the times include its whole startup
+    double off = time_pman("off");
+    double full = time_pman(path);
+    double again = time_pman(path);
+    printf("pman --state off:            %.1f ms\n", off);
+    printf("pman with %ld records:   %.1f ms\n", records, full);
+    printf("pman with %ld live left:    %.1f ms\n", live, again);
+
+    for (long i = 0; i < live; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+    }
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+    Cost of many pending deadlines on the timer wheel (bg --timeout).
+    Starts 100k timers due in 1 to 10 minutes and times the starts,
+    then lets the event loop sit for a few seconds and reports how
+    often it woke up and the cpu it used. Then stops them all, and
+    finally fires 100k timers spread over one second to see how late
+    they run.
+
+    Run: make bench-timers
+    Or:  ./bench/bench_timers [timers] [idle seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "../event_loop.h"
+#include "../timer_wheel.h"
+
+static long fired = 0;
+static double late_total_ms = 0;
+static double late_max_ms = 0;
+
+// Monotonic clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// User plus system cpu time of this process in seconds
+static double cpu_seconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+           + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Counts a timer and how long after its due time it ran, data holds that time
+static void on_fire(Timer *timer) {
+    double late = (now_seconds() - *(double *) timer->data) * 1e3;
+
+    fired++;
+    late_total_ms += late;
+    if (late > late_max_ms) {
+        late_max_ms = late;
+    }
+}
+
+int main(int argc, char **argv) {
+    long count = (argc > 1) ? atol(argv[1]) : 100000;
+    double idle = (argc > 2) ? atof(argv[2]) : 5;
+
+    if (count <= 0 || idle < 0) {
+        fprintf(stderr, "Usage: %s [timers] [idle seconds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    Timer *timers = calloc(count, sizeof(Timer));
+    double *due = calloc(count, sizeof(double));
+    if (timers == NULL || due == NULL || initEventLoop() == -1 || initTimerWheel() == -1) {
+        fprintf(stderr, "Could not set up the timers\n");
+        return EXIT_FAILURE;
+    }
+    srand(1);
+
+    double start = now_seconds();
+    for (long i = 0; i < count; i++) {
+        initTimer(&timers[i], on_fire, &due[i]);
+        startTimer(&timers[i], 60000 + rand() % 540000);
+    }
+    double elapsed = now_seconds() - start;
+    printf("%ld timers started in %.1f ms (%.0f ns each)\n", count, elapsed * 1e3, elapsed * 1e9 / count);
+
+    // Nothing is due, the loop should hardly wake up
+    long wakeups = 0;
+    double cpu = cpu_seconds();
+    start = now_seconds();
+    while (now_seconds() - start < idle) {
+        wakeups += runEventLoopOnce((int) ((idle - (now_seconds() - start)) * 1e3) + 1);
+    }
+    printf("Idle %.0f s with %zu pending: %ld wakeups, %.2f ms cpu\n", idle, pendingTimers(), wakeups,
+           (cpu_seconds() - cpu) * 1e3);
+
+    start = now_seconds();
+    for (long i = 0; i < count; i++) {
+        stopTimer(&timers[i]);
+    }
+    elapsed = now_seconds() - start;
+    printf("%ld timers stopped in %.1f ms (%.0f ns each)\n", count, elapsed * 1e3, elapsed * 1e9 / count);
+
+    // Spread over one second, every one is checked for how late it ran
+    for (long i = 0; i < count; i++) {
+        long delay = rand() % 1000;
+        due[i] = now_seconds() + delay / 1e3;
+        startTimer(&timers[i], delay);
+    }
+    wakeups = 0;
+    while (pendingTimers() > 0) {
+        wakeups += runEventLoopOnce(-1);
+    }
+    printf("%ld of %ld timers fired over 1 s in %ld wakeups, %.2f ms late on average, %.2f ms at most\n",
+           fired, count, wakeups, late_total_ms / fired, late_max_ms);
+
+    free(timers);
+    free(due);
+    return 0;
+}
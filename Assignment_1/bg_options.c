@@ -0,0 +1,330 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include "bg_options.h"
+#include "placement.h"
+#include "pgroup.h"
+
+// Function to set every option to "not given"
+void initBgOptions(BgOptions *opts) {
+    opts->group = NULL;
+    opts->cpu_max_us = -1;
+    opts->mem_max = -1;
+    opts->has_cpus = 0;
+    CPU_ZERO(&opts->cpus);
+    opts->place = -1;
+    opts->capture = 1;
+    opts->restart = RESTART_NO;
+    opts->max_restarts = 5;
+    opts->backoff_ms = 1000;
+    opts->pgroup = NULL;
+    opts->tags = NULL;
+    opts->perf = 0;
+    initJobPriority(&opts->priority);
+    opts->after = NULL;
+    opts->after_ok = NULL;
+    opts->timeout_ms = -1;
+    opts->kill_after_ms = 5000;
+}
+
+/*  Parses a placement policy name.
+    Returns one of the PLACE_ values, -1 if unknown.
+ */
+int parsePlacement(const char *value) {
+    if (strcmp(value, "none") == 0 || strcmp(value, "off") == 0) {
+        return PLACE_NONE;
+    }
+    if (strcmp(value, "rr") == 0) {
+        return PLACE_RR;
+    }
+    if (strcmp(value, "least") == 0) {
+        return PLACE_LEAST;
+    }
+    return -1;
+}
+
+/*  Parses a cpu limit in cores: "1.5" or "150%" are both one and a half
+    cores. Returns the quota in us per 100ms period, -1 if invalid.
+ */
+static long parse_cpu_max(const char *value) {
+    char *end;
+    double cores = strtod(value, &end);
+
+    if (end == value) {
+        return -1;
+    }
+    if (*end == '%') {
+        cores /= 100.0;
+        end++;
+    }
+    if (*end != '\0' || cores <= 0) {
+        return -1;
+    }
+
+    // The kernel wants at least 1ms of quota
+    long quota = (long)(cores * 100000);
+    return quota < 1000 ? 1000 : quota;
+}
+
+/*  Parses a size with an optional K, M or G suffix.
+    Returns the size in bytes, -1 if invalid.
+ */
+static long long parse_size(const char *value) {
+    char *end;
+    long long size = strtoll(value, &end, 10);
+
+    if (end == value || size <= 0) {
+        return -1;
+    }
+    switch (toupper((unsigned char)*end)) {
+        case 'K': size <<= 10; end++; break;
+        case 'M': size <<= 20; end++; break;
+        case 'G': size <<= 30; end++; break;
+        default: break;
+    }
+    return (*end == '\0') ? size : -1;
+}
+
+/*  Function to parse a duration: "500ms", "2s", "1.5m", "2h" or plain seconds.
+    Returns it in milliseconds, -1 if invalid.
+ */
+long parseDuration(const char *value) {
+    char *end;
+    double amount = strtod(value, &end);
+
+    if (end == value || amount < 0) {
+        return -1;
+    }
+    if (strcmp(end, "ms") == 0) {
+        return (long) amount;
+    }
+    if (*end == '\0' || strcmp(end, "s") == 0) {
+        return (long) (amount * 1000);
+    }
+    if (strcmp(end, "m") == 0) {
+        return (long) (amount * 60000);
+    }
+    if (strcmp(end, "h") == 0) {
+        return (long) (amount * 3600000);
+    }
+    return -1;
+}
+
+/*  Function to parse one of --nice, --sched or --ioprio with its value.
+    Shared by bg and bgrenice. Returns 1 if it was one of them, 0 if the
+    option is another one, -1 after printing that the value is invalid.
+ */
+int parsePriorityOption(const char *option, const char *value, JobPriority *prio) {
+    if (strncmp(option, "--nice=", 7) == 0) {
+        char *end;
+        long nice = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || nice < -20 || nice > 19) {
+            printf("Invalid --nice %s (-20 to 19)\n", value);
+            return -1;
+        }
+        prio->has_nice = 1;
+        prio->nice = (int) nice;
+    }
+    else if (strncmp(option, "--sched=", 8) == 0) {
+        if (parseSchedPolicy(value, prio) == -1) {
+            printf("Invalid --sched %s (other, batch, idle, fifo[:1-99] or rr[:1-99])\n", value);
+            return -1;
+        }
+    }
+    else if (strncmp(option, "--ioprio=", 9) == 0) {
+        if (parseIoPriority(value, prio) == -1) {
+            printf("Invalid --ioprio %s (rt,0-7, be,0-7, idle or none)\n", value);
+            return -1;
+        }
+    }
+    else {
+        return 0;
+    }
+    return 1;
+}
+
+/*  Function to split the option at cmd[*i] into its name and value.
+    name gets the option up to and with its '=', "--nice 5" is read as
+    "--nice=5" and *i is moved onto the value. Returns the value, NULL
+    if there is none.
+ */
+char *splitOption(char **cmd, int *i, char *name, size_t size) {
+    char *value = strchr(cmd[*i], '=');
+
+    if (value != NULL) {
+        snprintf(name, size, "%.*s", (int) (value - cmd[*i] + 1), cmd[*i]);
+        value++;
+    }
+    else {
+        snprintf(name, size, "%s=", cmd[*i]);
+        if (cmd[*i + 1] == NULL) {
+            return NULL;
+        }
+        value = cmd[++*i];
+    }
+    return (value[0] != '\0') ? value : NULL;
+}
+
+/*  Function to parse the --options that follow bg
+    cmd[0] is "bg". Returns the index of the executable in cmd,
+    or -1 after printing an error.
+ */
+int parseBgOptions(char **cmd, BgOptions *opts) {
+    int i = 1;
+
+    for (; cmd[i] != NULL && strncmp(cmd[i], "--", 2) == 0; i++) {
+        char option[OPTION_NAME_SIZE];
+
+        // A bare "--" ends the options
+        if (cmd[i][2] == '\0') {
+            i++;
+            break;
+        }
+        char *value = splitOption(cmd, &i, option, sizeof(option));
+        if (value == NULL) {
+            printf("Option %.*s needs a value (%.*s=... or %.*s ...)\n", OPTION_NAME(option),
+                   OPTION_NAME(option), OPTION_NAME(option));
+            return -1;
+        }
+
+        if (strncmp(option, "--group=", 8) == 0) {
+            opts->group = value;
+        }
+        else if (strncmp(option, "--cpu-max=", 10) == 0) {
+            opts->cpu_max_us = parse_cpu_max(value);
+            if (opts->cpu_max_us == -1) {
+                printf("Invalid --cpu-max %s (cores like 1.5 or 150%%)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--mem-max=", 10) == 0) {
+            opts->mem_max = parse_size(value);
+            if (opts->mem_max == -1) {
+                printf("Invalid --mem-max %s (bytes with optional K, M or G)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--cpus=", 7) == 0) {
+            if (parseCpuList(value, &opts->cpus) == -1) {
+                printf("Invalid --cpus %s (a list like 0-3,6)\n", value);
+                return -1;
+            }
+            if (usableCpus(&opts->cpus) == 0) {
+                printf("None of the cpus in %s are available to pman\n", value);
+                return -1;
+            }
+            opts->has_cpus = 1;
+        }
+        else if (strncmp(option, "--place=", 8) == 0) {
+            opts->place = parsePlacement(value);
+            if (opts->place == -1) {
+                printf("Invalid --place %s (rr, least or none)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--log=", 6) == 0) {
+            if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0) {
+                printf("Invalid --log %s (on or off)\n", value);
+                return -1;
+            }
+            opts->capture = (strcmp(value, "on") == 0);
+        }
+        else if (strncmp(option, "--restart=", 10) == 0) {
+            if (strcmp(value, "no") == 0) {
+                opts->restart = RESTART_NO;
+            }
+            else if (strcmp(value, "on-failure") == 0) {
+                opts->restart = RESTART_ON_FAILURE;
+            }
+            else if (strcmp(value, "always") == 0) {
+                opts->restart = RESTART_ALWAYS;
+            }
+            else {
+                printf("Invalid --restart %s (no, on-failure or always)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--max-restarts=", 15) == 0) {
+            char *end;
+            long count = strtol(value, &end, 10);
+            if (*end != '\0' || count < 0 || count > 1000000) {
+                printf("Invalid --max-restarts %s (a count)\n", value);
+                return -1;
+            }
+            opts->max_restarts = (int) count;
+        }
+        else if (strncmp(option, "--backoff=", 10) == 0) {
+            opts->backoff_ms = parseDuration(value);
+            if (opts->backoff_ms == -1) {
+                printf("Invalid --backoff %s (like 500ms, 2s or 1m)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--timeout=", 10) == 0) {
+            opts->timeout_ms = parseDuration(value);
+            if (opts->timeout_ms <= 0) {
+                printf("Invalid --timeout %s (like 500ms, 30s, 5m or 2h)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--kill-after=", 13) == 0) {
+            opts->kill_after_ms = parseDuration(value);
+            if (opts->kill_after_ms == -1) {
+                printf("Invalid --kill-after %s (like 500ms, 5s or 1m)\n", value);
+                return -1;
+            }
+        }
+        else if (strncmp(option, "--perf=", 7) == 0) {
+            if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0) {
+                printf("Invalid --perf %s (on or off)\n", value);
+                return -1;
+            }
+            opts->perf = (strcmp(value, "on") == 0);
+        }
+        else if (strncmp(option, "--pgroup=", 9) == 0) {
+            // A number would read as a pgid for bgkill -g
+            if (strspn(value, "0123456789") == strlen(value)) {
+                printf("Invalid --pgroup %s (a name, not a number)\n", value);
+                return -1;
+            }
+            opts->pgroup = value;
+        }
+        else if (strncmp(option, "--after=", 8) == 0 || strncmp(option, "--after-ok=", 11) == 0) {
+            // Same list syntax as tags, each one is a pid or a tag
+            if (!validTags(value)) {
+                printf("Invalid %.*s %s (pids or tags separated by commas)\n", OPTION_NAME(option), value);
+                return -1;
+            }
+            if (option[7] == '=') {
+                opts->after = value;
+            }
+            else {
+                opts->after_ok = value;
+            }
+        }
+        else if (strncmp(option, "--tag=", 6) == 0) {
+            if (!validTags(value)) {
+                printf("Invalid --tag %s (names separated by commas)\n", value);
+                return -1;
+            }
+            opts->tags = value;
+        }
+        else {
+            int known = parsePriorityOption(option, value, &opts->priority);
+            if (known == 0) {
+                printf("Unknown option %.*s\n", OPTION_NAME(option));
+            }
+            if (known != 1) {
+                return -1;
+            }
+        }
+    }
+    return i;
+}
+
+// Returns 1 if the options need the job to be placed in a cgroup
+int wantsCgroup(const BgOptions *opts) {
+    return opts->group != NULL || opts->cpu_max_us != -1 || opts->mem_max != -1;
+}
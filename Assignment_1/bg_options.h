@@ -0,0 +1,58 @@
+#ifndef _BGOPTIONS_H_
+#define _BGOPTIONS_H_
+
+// Needs _GNU_SOURCE before the first include for cpu_set_t
+#include <sched.h>
+#include <string.h>
+#include "priority.h"
+
+typedef struct BgOptions BgOptions;
+
+/*  Options given to bg before the executable
+    Example: bg --group=build --mem-max=512M make
+ */
+struct BgOptions{
+    const char * group;     // --group=<name>, NULL for none
+    long cpu_max_us;        // --cpu-max, quota in us per 100ms period, -1 for none
+    long long mem_max;      // --mem-max, bytes, -1 for none
+    int has_cpus;           // 1 if --cpus was given
+    cpu_set_t cpus;         // --cpus=<list>, cpus the job may run on
+    int place;              // --place=rr|least|none, -1 for pman's default
+    int capture;            // --log=on|off, 1 sends output to <pid>.log under pman --logs
+    int restart;            // --restart=no|on-failure|always, one of the RESTART_ values
+    int max_restarts;       // --max-restarts, restarts in a row before pman gives up
+    long backoff_ms;        // --backoff, delay before the first restart, doubled each time
+    const char * pgroup;    // --pgroup=<name>, NULL for a process group of its own
+    const char * tags;      // --tag=<a,b>, comma separated, NULL for none
+    int perf;               // --perf=on|off, 1 attaches perf counters from the start
+    JobPriority priority;   // --nice, --sched and --ioprio
+    const char * after;     // --after=<pid|tag,...>, starts once all of them ended, NULL for none
+    const char * after_ok;  // --after-ok=<pid|tag,...>, only if they all exited with 0
+    long timeout_ms;        // --timeout, SIGTERM once the job has run this long, -1 for none
+    long kill_after_ms;     // --kill-after, SIGKILL this long after the SIGTERM, 0 skips the SIGTERM
+};
+
+// When a job is started again after it exits (bg --restart)
+#define RESTART_NO         0
+#define RESTART_ON_FAILURE 1   // exit code other than 0, or killed by a signal
+#define RESTART_ALWAYS     2
+
+
+// Room for an option name and its '=', longer ones are cut and never match
+#define OPTION_NAME_SIZE 32
+
+// printf arguments for "%.*s" that print an option name without the '='
+#define OPTION_NAME(name) (int) strcspn(name, "="), name
+
+
+void initBgOptions(BgOptions *opts);
+int parseBgOptions(char **cmd, BgOptions *opts);
+int parsePlacement(const char *value);
+int wantsCgroup(const BgOptions *opts);
+long parseDuration(const char *value);
+int parsePriorityOption(const char *option, const char *value, JobPriority *prio);
+char *splitOption(char **cmd, int *i, char *name, size_t size);
+
+
+
+#endif
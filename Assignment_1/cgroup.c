@@ -0,0 +1,452 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "cgroup.h"
+#include "stats.h"
+
+// 0 before the first use, 1 once set up, -1 if cgroup v2 is not usable
+static int cgroup_state = 0;
+
+// pman's own subtree: <cgroup2 mount>/<pman's cgroup>/pman-<pid>
+static char root_path[PATH_MAX * 2 + 32];
+static int root_fd = -1;
+
+/*  pman itself moves to <root>/pman. A cgroup with processes in it
+    cannot pass controllers on to its children (the no internal
+    process rule), so pman's subtree may not keep pman in it.
+ */
+#define SELF_GROUP "pman"
+static int moved_self = 0;
+static char parent_path[PATH_MAX * 2];
+
+static JobGroup *groups = NULL;
+static unsigned long next_job_group = 1;
+
+// Reads a small file relative to dirfd, returns the length or -1
+static ssize_t read_file(int dirfd, const char *name, char *buf, size_t size) {
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n >= 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+// Writes value to a cgroup file relative to dirfd, returns 0 or -1
+static int write_file(int dirfd, const char *name, const char *value) {
+    int fd = openat(dirfd, name, O_WRONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = write(fd, value, strlen(value));
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return (n == (ssize_t)strlen(value)) ? 0 : -1;
+}
+
+// Finds where the cgroup2 hierarchy is mounted, 0 on success
+static int find_cgroup2_mount(char *mount, size_t size) {
+    FILE *file = fopen("/proc/self/mountinfo", "r");
+    char line[4096];
+    int found = -1;
+
+    if (file == NULL) {
+        return -1;
+    }
+    // Fields: id parent major:minor root mount_point options ... - fstype ...
+    while (found == -1 && fgets(line, sizeof(line), file)) {
+        char mount_point[PATH_MAX];
+        char *separator = strstr(line, " - ");
+
+        if (separator == NULL || strncmp(separator + 3, "cgroup2 ", 8) != 0) {
+            continue;
+        }
+        if (sscanf(line, "%*s %*s %*s %*s %4095s", mount_point) == 1) {
+            snprintf(mount, size, "%s", mount_point);
+            found = 0;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// Finds pman's own cgroup v2 path ("0::/path" in /proc/self/cgroup)
+static int find_own_cgroup(char *path, size_t size) {
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    char line[4096];
+    int found = -1;
+
+    if (file == NULL) {
+        return -1;
+    }
+    while (found == -1 && fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "0::", 3) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(path, size, "%s", line + 3);
+            found = 0;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+/*  Makes cpu, memory and io available to the groups under pman's subtree.
+    Only the controllers pman's own cgroup already passes on to its
+    children can be, that cgroup is not pman's to change. The missing
+    ones are reported, their limits do not apply.
+ */
+static void enable_controllers(void) {
+    static const char *controllers[] = {"cpu", "memory", "io"};
+    char available[256];
+    char missing[32] = "";
+
+    if (read_file(root_fd, "cgroup.controllers", available, sizeof(available)) == -1) {
+        available[0] = '\0';
+    }
+    for (int i = 0; i < 3; i++) {
+        char request[32];
+
+        snprintf(request, sizeof(request), "+%s", controllers[i]);
+        if (strstr(available, controllers[i]) == NULL || write_file(root_fd, "cgroup.subtree_control", request) == -1) {
+            snprintf(missing + strlen(missing), sizeof(missing) - strlen(missing), "%s%s",
+                     missing[0] ? ", " : "", controllers[i]);
+        }
+    }
+    if (missing[0] != '\0') {
+        printf("cgroup controllers not delegated to pman (%s), their limits do not apply\n", missing);
+    }
+}
+
+/*  Moves pman from the cgroup it was started in to <root>/pman.
+    Returns 0, -1 if it stays where it is.
+ */
+static int move_self(void) {
+    char pid[32];
+    int fd;
+
+    if (mkdirat(root_fd, SELF_GROUP, 0755) == -1 && errno != EEXIST) {
+        return -1;
+    }
+    fd = openat(root_fd, SELF_GROUP, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    countStat(COUNT_SYSCALLS, 3);
+    if (fd == -1 || write_file(fd, "cgroup.procs", pid) == -1) {
+        int saved = errno;
+        if (fd != -1) {
+            close(fd);
+        }
+        unlinkat(root_fd, SELF_GROUP, AT_REMOVEDIR);
+        errno = saved;
+        return -1;
+    }
+    close(fd);
+    moved_self = 1;
+    return 0;
+}
+
+// Removes dir under parent_fd and the groups in it, those still holding processes stay
+static void remove_subtree(int parent_fd, const char *dir) {
+    int fd = openat(parent_fd, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *entries = (fd == -1) ? NULL : fdopendir(fd);
+    struct dirent *entry;
+
+    if (entries == NULL) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+    while ((entry = readdir(entries)) != NULL) {
+        if (entry->d_type == DT_DIR && strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            unlinkat(dirfd(entries), entry->d_name, AT_REMOVEDIR);
+        }
+    }
+    closedir(entries);
+    unlinkat(parent_fd, dir, AT_REMOVEDIR);
+}
+
+/*  Removes the pman-<pid> subtrees of pmans that are gone. A pman that
+    moved itself into its subtree cannot remove it when it exits.
+ */
+static void remove_stale_subtrees(int parent_fd) {
+    int fd = dup(parent_fd);
+    DIR *entries = (fd == -1) ? NULL : fdopendir(fd);
+    struct dirent *entry;
+
+    if (entries == NULL) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+    while ((entry = readdir(entries)) != NULL) {
+        char *end;
+        long pid;
+
+        if (strncmp(entry->d_name, "pman-", 5) != 0) {
+            continue;
+        }
+        pid = strtol(entry->d_name + 5, &end, 10);
+        if (*end != '\0' || pid <= 0 || pid == getpid() || kill((pid_t) pid, 0) == 0 || errno != ESRCH) {
+            continue;
+        }
+        remove_subtree(parent_fd, entry->d_name);
+    }
+    closedir(entries);
+}
+
+/*  Removes every group that is empty and pman's subtree, called at exit.
+    pman goes back to the cgroup it came from first, that fails if that
+    cgroup passes controllers on and the next pman removes the rest.
+ */
+static void cleanup_cgroups(void) {
+    for (JobGroup *group = groups; group != NULL; group = group->next) {
+        unlinkat(root_fd, group->name, AT_REMOVEDIR);
+    }
+    if (moved_self) {
+        char pid[32];
+        int parent_fd = open(parent_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        snprintf(pid, sizeof(pid), "%d", getpid());
+        if (parent_fd != -1 && write_file(parent_fd, "cgroup.procs", pid) == 0) {
+            unlinkat(root_fd, SELF_GROUP, AT_REMOVEDIR);
+        }
+        if (parent_fd != -1) {
+            close(parent_fd);
+        }
+    }
+    rmdir(root_path);
+}
+
+/*  Function to set up pman's cgroup subtree on first use.
+    Returns 0 if jobs can be placed in cgroups, -1 otherwise;
+    the reason is printed once and later calls fail quietly.
+ */
+int initCgroups(void) {
+    char mount[PATH_MAX];
+    char own[PATH_MAX];
+
+    if (cgroup_state != 0) {
+        return (cgroup_state == 1) ? 0 : -1;
+    }
+    cgroup_state = -1;
+
+    if (find_cgroup2_mount(mount, sizeof(mount)) == -1 || find_own_cgroup(own, sizeof(own)) == -1) {
+        printf("cgroup v2 is not mounted, jobs run without a cgroup\n");
+        return -1;
+    }
+    snprintf(parent_path, sizeof(parent_path), "%s%s", mount, strcmp(own, "/") == 0 ? "" : own);
+    snprintf(root_path, sizeof(root_path), "%s/pman-%d", parent_path, getpid());
+
+    if (mkdir(root_path, 0755) == -1 && errno != EEXIST) {
+        printf("cgroup delegation not available (%s: %s), jobs run without a cgroup\n",
+               root_path, strerror(errno));
+        return -1;
+    }
+    root_fd = open(root_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd == -1) {
+        printf("cgroup delegation not available (%s: %s), jobs run without a cgroup\n",
+               root_path, strerror(errno));
+        rmdir(root_path);
+        return -1;
+    }
+
+    // Out of the way first, the subtree can only pass controllers on without processes
+    if (move_self() == -1) {
+        printf("Could not move pman into %s/%s (%s), cgroup limits may not apply\n",
+               root_path, SELF_GROUP, strerror(errno));
+    }
+    int parent_fd = open(parent_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parent_fd >= 0) {
+        remove_stale_subtrees(parent_fd);
+        close(parent_fd);
+    }
+    enable_controllers();
+
+    atexit(cleanup_cgroups);
+    cgroup_state = 1;
+    return 0;
+}
+
+// Writes the limits to a group, a missing controller is reported not fatal
+static void apply_limits(JobGroup *group, long cpu_max_us, long long mem_max) {
+    char value[64];
+
+    if (cpu_max_us != -1) {
+        snprintf(value, sizeof(value), "%ld 100000", cpu_max_us);
+        if (write_file(group->dir_fd, "cpu.max", value) == -1) {
+            printf("cgroup %s: cpu controller not available (%s), --cpu-max ignored\n",
+                   group->name, strerror(errno));
+        }
+    }
+    if (mem_max != -1) {
+        snprintf(value, sizeof(value), "%lld", mem_max);
+        if (write_file(group->dir_fd, "memory.max", value) == -1) {
+            printf("cgroup %s: memory controller not available (%s), --mem-max ignored\n",
+                   group->name, strerror(errno));
+        }
+    }
+}
+
+/*  Function to find or create the group a new job goes into.
+    name NULL creates a group for this job alone. Limits that are not
+    -1 are (re)applied to the group.
+    Returns the group with the new member counted, or NULL if the job
+    has to run without a cgroup.
+ */
+JobGroup * getJobGroup(const char *name, long cpu_max_us, long long mem_max) {
+    char job_name[32];
+    JobGroup *group;
+
+    if (initCgroups() == -1) {
+        return NULL;
+    }
+
+    if (name != NULL) {
+        if (strchr(name, '/') != NULL || strcmp(name, ".") == 0 || strcmp(name, "..") == 0
+            || strncmp(name, "job-", 4) == 0 || strcmp(name, SELF_GROUP) == 0) {
+            printf("Group name %s is not valid\n", name);
+            return NULL;
+        }
+        for (group = groups; group != NULL; group = group->next) {
+            if (strcmp(group->name, name) == 0) {
+                apply_limits(group, cpu_max_us, mem_max);
+                group->members++;
+                return group;
+            }
+        }
+    }
+    else {
+        snprintf(job_name, sizeof(job_name), "job-%lu", next_job_group++);
+        name = job_name;
+    }
+
+    if (mkdirat(root_fd, name, 0755) == -1 && errno != EEXIST) {
+        printf("Could not create cgroup %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    group = malloc(sizeof(JobGroup));
+    countStat(COUNT_ALLOCS, 1);
+    if (group == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    group->name = strdup(name);
+    countStat(COUNT_ALLOCS, 1);
+    group->dir_fd = openat(root_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    group->members = 1;
+    if (group->dir_fd == -1) {
+        printf("Could not open cgroup %s: %s\n", name, strerror(errno));
+        unlinkat(root_fd, name, AT_REMOVEDIR);
+        free(group->name);
+        free(group);
+        return NULL;
+    }
+    apply_limits(group, cpu_max_us, mem_max);
+
+    group->next = groups;
+    groups = group;
+    return group;
+}
+
+/*  Function to take a job out of its group's member count.
+    Single job groups are removed once empty, named ones are kept
+    so their totals stay visible.
+ */
+void releaseJobGroup(JobGroup *group) {
+    if (group == NULL || --group->members > 0 || strncmp(group->name, "job-", 4) != 0) {
+        return;
+    }
+
+    JobGroup **link = &groups;
+    while (*link != group) {
+        link = &(*link)->next;
+    }
+    *link = group->next;
+
+    close(group->dir_fd);
+    unlinkat(root_fd, group->name, AT_REMOVEDIR);
+    free(group->name);
+    free(group);
+}
+
+// Returns the value after "key" in a "key value" or "key=value" list, -1 if absent
+static long long find_value(const char *buf, const char *key) {
+    size_t key_len = strlen(key);
+    const char *p = buf;
+
+    while ((p = strstr(p, key)) != NULL) {
+        // Must start a word and be followed by the separator
+        if ((p == buf || p[-1] == '\n' || p[-1] == ' ') && (p[key_len] == ' ' || p[key_len] == '=')) {
+            return strtoll(p + key_len + 1, NULL, 10);
+        }
+        p += key_len;
+    }
+    return -1;
+}
+
+/*  Function to read the accounting of a group, covering every process
+    in it (children of children too) without walking /proc.
+    Returns 0 on success, -1 if cpu.stat could not be read.
+ */
+int readGroupStats(JobGroup *group, GroupStats *stats) {
+    char buf[4096];
+
+    if (read_file(group->dir_fd, "cpu.stat", buf, sizeof(buf)) == -1) {
+        return -1;
+    }
+    stats->usage_usec = find_value(buf, "usage_usec");
+    stats->user_usec = find_value(buf, "user_usec");
+    stats->system_usec = find_value(buf, "system_usec");
+
+    stats->memory_current = -1;
+    if (read_file(group->dir_fd, "memory.current", buf, sizeof(buf)) > 0) {
+        stats->memory_current = strtoll(buf, NULL, 10);
+    }
+    stats->memory_peak = -1;
+    if (read_file(group->dir_fd, "memory.peak", buf, sizeof(buf)) > 0) {
+        stats->memory_peak = strtoll(buf, NULL, 10);
+    }
+
+    // io.stat has one line per device, add them up
+    stats->io_rbytes = -1;
+    stats->io_wbytes = -1;
+    if (read_file(group->dir_fd, "io.stat", buf, sizeof(buf)) >= 0) {
+        stats->io_rbytes = 0;
+        stats->io_wbytes = 0;
+        for (char *line = buf; line != NULL && *line != '\0'; ) {
+            char *eol = strchr(line, '\n');
+            if (eol != NULL) {
+                *eol = '\0';
+            }
+            long long rbytes = find_value(line, "rbytes");
+            long long wbytes = find_value(line, "wbytes");
+            stats->io_rbytes += rbytes > 0 ? rbytes : 0;
+            stats->io_wbytes += wbytes > 0 ? wbytes : 0;
+            line = (eol != NULL) ? eol + 1 : NULL;
+        }
+    }
+    return 0;
+}
+
+// Function to start iterating over the groups, follow ->next
+JobGroup * firstJobGroup(void) {
+    return groups;
+}
@@ -0,0 +1,37 @@
+#ifndef _CGROUP_H_
+#define _CGROUP_H_
+
+typedef struct JobGroup JobGroup;
+
+/*  A cgroup v2 directory under pman's own subtree.
+    Named groups (bg --group=name) are shared by every job started
+    with that name, unnamed ones hold a single job.
+ */
+struct JobGroup{
+    char * name;
+    int dir_fd;       // the cgroup directory, used to spawn into it
+    int members;      // jobs currently in the group
+    JobGroup * next;
+};
+
+// Accounting read from a group, -1 where the controller is missing
+typedef struct {
+    long long usage_usec;
+    long long user_usec;
+    long long system_usec;
+    long long memory_current;
+    long long memory_peak;
+    long long io_rbytes;
+    long long io_wbytes;
+} GroupStats;
+
+
+int initCgroups(void);
+JobGroup * getJobGroup(const char *name, long cpu_max_us, long long mem_max);
+void releaseJobGroup(JobGroup *group);
+int readGroupStats(JobGroup *group, GroupStats *stats);
+JobGroup * firstJobGroup(void);
+
+
+
+#endif
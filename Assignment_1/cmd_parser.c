@@ -0,0 +1,147 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include "cmd_parser.h"
+#include "stats.h"
+
+// Initial sizes, both grow by doubling when needed
+#define READER_MIN_CAPACITY 65536
+#define ARGS_MIN_CAPACITY 16
+
+// Function to initialize an empty reader
+void initLineReader(LineReader *reader) {
+    reader->buf = malloc(READER_MIN_CAPACITY);
+    countStat(COUNT_ALLOCS, 1);
+    if (reader->buf == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    reader->start = 0;
+    reader->len = 0;
+    reader->cap = READER_MIN_CAPACITY;
+    reader->eof = 0;
+}
+
+// Drops handed out lines from the front and grows the buffer if it is full
+static void make_room(LineReader *reader) {
+    if (reader->start > 0) {
+        memmove(reader->buf, reader->buf + reader->start, reader->len - reader->start);
+        reader->len -= reader->start;
+        reader->start = 0;
+    }
+
+    // A line longer than the buffer, grow it
+    if (reader->len == reader->cap) {
+        char *bigger = realloc(reader->buf, reader->cap * 2);
+        countStat(COUNT_ALLOCS, 1);
+        if (bigger == NULL) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        reader->buf = bigger;
+        reader->cap *= 2;
+    }
+}
+
+/*  Function to read whatever fd has available with one read() call.
+    Returns the bytes read, 0 at end of input, -1 on error
+    (EAGAIN if a non blocking fd has nothing yet).
+ */
+ssize_t fillLineReader(LineReader *reader, int fd) {
+    make_room(reader);
+
+    ssize_t n = read(fd, reader->buf + reader->len, reader->cap - reader->len);
+    countStat(COUNT_SYSCALLS, 1);
+    if (n == 0) {
+        reader->eof = 1;
+    }
+    else if (n > 0) {
+        reader->len += n;
+    }
+    return n;
+}
+
+/*  Function to take the next complete line out of the buffer.
+    The newline is replaced by '\0' in place. At end of input a last
+    line without a newline is returned too.
+    Returns NULL when no complete line is buffered.
+ */
+char * nextLine(LineReader *reader) {
+    char *line = reader->buf + reader->start;
+    size_t avail = reader->len - reader->start;
+    char *newline = memchr(line, '\n', avail);
+
+    if (newline != NULL) {
+        *newline = '\0';
+        reader->start += (newline - line) + 1;
+        return line;
+    }
+
+    // Unterminated last line, needs one spare byte for the '\0'
+    if (reader->eof && avail > 0) {
+        if (reader->len == reader->cap) {
+            make_room(reader);
+            line = reader->buf;
+        }
+        line[avail] = '\0';
+        reader->start = reader->len;
+        return line;
+    }
+    return NULL;
+}
+
+// Function to initialize an empty argument vector
+void initArgVector(ArgVector *args) {
+    args->argv = malloc(ARGS_MIN_CAPACITY * sizeof(char *));
+    countStat(COUNT_ALLOCS, 1);
+    if (args->argv == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    args->argc = 0;
+    args->cap = ARGS_MIN_CAPACITY;
+    args->argv[0] = NULL;
+}
+
+/*  Function to split a line on spaces and tabs, in place.
+    Fills args->argv (NULL terminated) and returns the count.
+ */
+size_t splitArgs(char *line, ArgVector *args) {
+    char *p = line;
+
+    args->argc = 0;
+    while (1) {
+        // Skip separators
+        while (*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+
+        // Keep room for the token and the terminating NULL
+        if (args->argc + 2 > args->cap) {
+            char **bigger = realloc(args->argv, args->cap * 2 * sizeof(char *));
+            countStat(COUNT_ALLOCS, 1);
+            if (bigger == NULL) {
+                perror("realloc failed");
+                exit(EXIT_FAILURE);
+            }
+            args->argv = bigger;
+            args->cap *= 2;
+        }
+        args->argv[args->argc++] = p;
+
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        *p++ = '\0';
+    }
+    args->argv[args->argc] = NULL;
+    return args->argc;
+}
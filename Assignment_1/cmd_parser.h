@@ -0,0 +1,38 @@
+#ifndef _CMDPARSER_H_
+#define _CMDPARSER_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*  Buffered line reader over a raw fd.
+    The buffer grows to fit the longest line seen and is then reused,
+    so lines have no length limit and reading does not allocate.
+ */
+typedef struct {
+    char * buf;
+    size_t start;   // first byte not handed out yet
+    size_t len;     // bytes in buf
+    size_t cap;
+    int eof;
+} LineReader;
+
+/*  Argument vector of one command line.
+    argv points into the line itself and is NULL terminated,
+    the array is grown once and reused for every line.
+ */
+typedef struct {
+    char ** argv;
+    size_t argc;
+    size_t cap;
+} ArgVector;
+
+
+void initLineReader(LineReader *reader);
+ssize_t fillLineReader(LineReader *reader, int fd);
+char * nextLine(LineReader *reader);
+void initArgVector(ArgVector *args);
+size_t splitArgs(char *line, ArgVector *args);
+
+
+
+#endif
@@ -0,0 +1,304 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include "control_server.h"
+#include "event_loop.h"
+#include "protocol.h"
+#include "stats.h"
+
+// Bytes read from a client per wakeup
+#define CLIENT_READ_SIZE 65536
+
+// Responses a client has not read yet, past this its requests wait
+#define CLIENT_OUT_LIMIT (4 << 20)
+
+typedef struct Client Client;
+
+/*  One connected pmanctl (or any other client).
+    in holds received bytes until a whole frame is there, out holds
+    responses the socket did not take yet.
+ */
+struct Client{
+    int fd;
+    Watch watch;
+    char * in;
+    size_t in_len;
+    size_t in_cap;
+    char * out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    int want_out;       // EPOLLOUT is being waited for
+    Client * prev;
+    Client * next;
+};
+
+static int listen_fd = -1;
+static Watch listen_watch;
+static char socket_path[108];
+static request_handler handle_request = NULL;
+
+static Client *clients = NULL;
+static size_t client_count = 0;
+
+// Grows a buffer to hold at least need bytes
+static void reserve(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) {
+        return;
+    }
+    size_t new_cap = (*cap > 0) ? *cap : 4096;
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+    char *bigger = realloc(*buf, new_cap);
+    countStat(COUNT_ALLOCS, 1);
+    if (bigger == NULL) {
+        perror("realloc failed");
+        exit(EXIT_FAILURE);
+    }
+    *buf = bigger;
+    *cap = new_cap;
+}
+
+// Function to disconnect a client and free it
+static void close_client(Client *client) {
+    unwatchFd(&client->watch);
+    close(client->fd);
+
+    if (client->prev) {
+        client->prev->next = client->next;
+    }
+    else {
+        clients = client->next;
+    }
+    if (client->next) {
+        client->next->prev = client->prev;
+    }
+    client_count--;
+
+    free(client->in);
+    free(client->out);
+    free(client);
+}
+
+/*  Sends as much of the pending responses as the socket takes.
+    Returns 0, or -1 if the client is gone.
+ */
+static int flush_client(Client *client) {
+    while (client->out_sent < client->out_len) {
+        countStat(COUNT_SYSCALLS, 1);
+        ssize_t n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                break;
+            }
+            return -1;
+        }
+        client->out_sent += n;
+    }
+
+    if (client->out_sent == client->out_len) {
+        client->out_len = 0;
+        client->out_sent = 0;
+    }
+
+    // Wait for room only while something is left to send
+    int want_out = client->out_len > 0;
+    if (want_out != client->want_out) {
+        changeWatch(&client->watch, want_out ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+        client->want_out = want_out;
+    }
+    return 0;
+}
+
+// Runs one request and queues its response frame
+static void answer(Client *client, char *request) {
+    char *response = NULL;
+    size_t response_len = 0;
+    FILE *stream = open_memstream(&response, &response_len);
+
+    if (stream == NULL) {
+        perror("open_memstream failed");
+        exit(EXIT_FAILURE);
+    }
+    // Room for the header first, filled in once the length is known
+    fwrite("\0\0\0\0", 1, FRAME_HEADER_SIZE, stream);
+    handle_request(request, stream);
+    fclose(stream);
+    putFrameHeader(response, response_len - FRAME_HEADER_SIZE);
+
+    reserve(&client->out, &client->out_cap, client->out_len + response_len);
+    memcpy(client->out + client->out_len, response, response_len);
+    client->out_len += response_len;
+    free(response);
+}
+
+/*  Runs every complete request in the input buffer.
+    Returns 0, or -1 if the client sent a frame that is too long.
+ */
+static int process_requests(Client *client) {
+    size_t pos = 0;
+
+    while (client->in_len - pos >= FRAME_HEADER_SIZE && client->out_len < CLIENT_OUT_LIMIT) {
+        uint32_t len = getFrameHeader(client->in + pos);
+
+        if (len > MAX_REQUEST_SIZE) {
+            return -1;
+        }
+        if (client->in_len - pos < FRAME_HEADER_SIZE + (size_t) len) {
+            break;
+        }
+
+        // The request is text, the spare byte after it takes the '\0'
+        char *request = client->in + pos + FRAME_HEADER_SIZE;
+        char saved = request[len];
+        request[len] = '\0';
+        answer(client, request);
+        request[len] = saved;
+        pos += FRAME_HEADER_SIZE + len;
+    }
+
+    // Keep the unfinished frame at the front
+    memmove(client->in, client->in + pos, client->in_len - pos);
+    client->in_len -= pos;
+    return 0;
+}
+
+// Runs when a client sent something, closed, or has room for output
+static void on_client(Watch *watch, uint32_t events) {
+    Client *client = watch->data;
+
+    if (events & EPOLLIN) {
+        reserve(&client->in, &client->in_cap, client->in_len + CLIENT_READ_SIZE + 1);
+        countStat(COUNT_SYSCALLS, 1);
+        ssize_t n = read(client->fd, client->in + client->in_len, CLIENT_READ_SIZE);
+
+        if (n == 0 || (n == -1 && errno != EAGAIN && errno != EINTR)) {
+            close_client(client);
+            return;
+        }
+        if (n > 0) {
+            client->in_len += n;
+        }
+    }
+    else if (events & (EPOLLHUP | EPOLLERR)) {
+        close_client(client);
+        return;
+    }
+
+    // Requests held back by a full output buffer run once it drains
+    if (process_requests(client) == -1 || flush_client(client) == -1) {
+        close_client(client);
+    }
+}
+
+// Runs when clients are waiting to be accepted
+static void on_accept(Watch *watch, uint32_t events) {
+    while (1) {
+        countStat(COUNT_SYSCALLS, 1);
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EINTR) {
+                perror("accept failed");
+            }
+            return;
+        }
+
+        Client *client = calloc(1, sizeof(Client));
+        countStat(COUNT_ALLOCS, 1);
+        if (client == NULL) {
+            perror("calloc failed");
+            exit(EXIT_FAILURE);
+        }
+        client->fd = fd;
+        if (watchFd(&client->watch, fd, EPOLLIN, on_client, client) == -1) {
+            perror("epoll_ctl failed");
+            close(fd);
+            free(client);
+            continue;
+        }
+
+        client->next = clients;
+        if (clients) {
+            clients->prev = client;
+        }
+        clients = client;
+        client_count++;
+    }
+}
+
+// Removes the socket file when pman exits
+static void remove_socket(void) {
+    unlink(socket_path);
+}
+
+/*  Function to listen for clients on a UNIX socket at path.
+    A socket left behind by a pman that is gone is replaced, one
+    that still answers means a daemon is already running.
+    Returns 0 on success, -1 on failure.
+ */
+int startControlServer(const char *path, request_handler handler) {
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "A pman daemon is already listening on %s\n", path);
+        close(probe);
+        return -1;
+    }
+    if (probe >= 0) {
+        close(probe);
+    }
+    unlink(path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        perror("socket failed");
+        return -1;
+    }
+
+    // Only the owner may control the daemon
+    mode_t old_mask = umask(077);
+    int bound = bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr));
+    umask(old_mask);
+    if (bound == -1 || listen(listen_fd, SOMAXCONN) == -1) {
+        perror(path);
+        close(listen_fd);
+        return -1;
+    }
+    if (watchFd(&listen_watch, listen_fd, EPOLLIN, on_accept, NULL) == -1) {
+        perror("epoll_ctl failed");
+        close(listen_fd);
+        return -1;
+    }
+
+    strcpy(socket_path, path);
+    handle_request = handler;
+    atexit(remove_socket);
+    return 0;
+}
+
+// Function to get how many clients are connected
+size_t controlClientCount(void) {
+    return client_count;
+}
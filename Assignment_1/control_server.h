@@ -0,0 +1,16 @@
+#ifndef _CONTROLSERVER_H_
+#define _CONTROLSERVER_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Runs one request, everything written to response goes back to the client
+typedef void (*request_handler)(char *request, FILE *response);
+
+
+int startControlServer(const char *path, request_handler handler);
+size_t controlClientCount(void);
+
+
+
+#endif
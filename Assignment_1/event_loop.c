@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "event_loop.h"
+#include "stats.h"
+
+// Most events handled per epoll_wait call
+#define MAX_EVENTS 64
+
+static int epoll_fd = -1;
+
+// Events of the batch currently being dispatched
+static struct epoll_event batch[MAX_EVENTS];
+static int batch_size = 0;
+
+// Function to create the epoll instance, returns -1 on failure
+int initEventLoop(void) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+    return 0;
+}
+
+/*  Function to start watching fd for the given epoll events.
+    Returns -1 and leaves errno set if epoll refuses the fd
+    (EPERM for regular files, which are always readable).
+ */
+int watchFd(Watch *watch, int fd, uint32_t events, watch_handler handler, void *data) {
+    struct epoll_event ev;
+
+    watch->fd = fd;
+    watch->handler = handler;
+    watch->data = data;
+
+    ev.events = events;
+    ev.data.ptr = watch;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        watch->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to change the epoll events a watched fd is waited for
+int changeWatch(Watch *watch, uint32_t events) {
+    struct epoll_event ev;
+
+    ev.events = events;
+    ev.data.ptr = watch;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, watch->fd, &ev);
+}
+
+/*  Function to stop watching a fd. The fd itself is not closed.
+    Events for this watch that are still waiting in the current
+    batch are dropped so the owner can be freed right away.
+ */
+void unwatchFd(Watch *watch) {
+    if (watch->fd < 0) {
+        return;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+    watch->fd = -1;
+
+    for (int i = 0; i < batch_size; i++) {
+        if (batch[i].data.ptr == watch) {
+            batch[i].data.ptr = NULL;
+        }
+    }
+}
+
+/*  Function to wait up to timeout_ms (-1 for ever) and run the
+    handler of every watch that fired.
+    Returns the number of events handled.
+ */
+int runEventLoopOnce(int timeout_ms) {
+    int n = epoll_wait(epoll_fd, batch, MAX_EVENTS, timeout_ms);
+    countStat(COUNT_SYSCALLS, 1);
+
+    if (n == -1) {
+        if (errno != EINTR) {
+            perror("epoll_wait failed");
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    batch_size = n;
+    for (int i = 0; i < n; i++) {
+        Watch *watch = batch[i].data.ptr;
+
+        // Unwatched by an earlier handler of this batch
+        if (watch == NULL) {
+            continue;
+        }
+        watch->handler(watch, batch[i].events);
+    }
+    batch_size = 0;
+
+    return n;
+}
+
+/*  Function to create a timerfd and watch it.
+    The timer starts disarmed, see armTimer().
+ */
+int createTimer(Watch *watch, watch_handler handler, void *data) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (fd == -1) {
+        perror("timerfd_create failed");
+        return -1;
+    }
+    if (watchFd(watch, fd, EPOLLIN, handler, data) == -1) {
+        perror("epoll_ctl failed");
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+/*  Function to arm a timer to fire after first_ms and then every
+    interval_ms (0 for a one shot). first_ms of 0 disarms it.
+ */
+int armTimer(Watch *watch, long first_ms, long interval_ms) {
+    struct itimerspec spec;
+
+    spec.it_value.tv_sec = first_ms / 1000;
+    spec.it_value.tv_nsec = (first_ms % 1000) * 1000000L;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    return timerfd_settime(watch->fd, 0, &spec, NULL);
+}
+
+// Function to consume a timer event, returns how many expirations passed
+unsigned long readTimer(Watch *watch) {
+    uint64_t expirations = 0;
+
+    countStat(COUNT_SYSCALLS, 1);
+    if (read(watch->fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+    return (unsigned long)expirations;
+}
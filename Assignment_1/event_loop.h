@@ -0,0 +1,33 @@
+#ifndef _EVENTLOOP_H_
+#define _EVENTLOOP_H_
+
+#include <stdint.h>
+
+typedef struct Watch Watch;
+
+// Called with the epoll events that fired for the watched fd
+typedef void (*watch_handler)(Watch *watch, uint32_t events);
+
+/*  One fd registered with the event loop.
+    The Watch is usually embedded in the object that owns the fd
+    (a Job for its pidfd), data points back to that owner.
+ */
+struct Watch{
+    int fd;
+    watch_handler handler;
+    void * data;
+};
+
+
+int initEventLoop(void);
+int watchFd(Watch *watch, int fd, uint32_t events, watch_handler handler, void *data);
+int changeWatch(Watch *watch, uint32_t events);
+void unwatchFd(Watch *watch);
+int runEventLoopOnce(int timeout_ms);
+int createTimer(Watch *watch, watch_handler handler, void *data);
+int armTimer(Watch *watch, long first_ms, long interval_ms);
+unsigned long readTimer(Watch *watch);
+
+
+
+#endif
@@ -0,0 +1,224 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include "exit_history.h"
+#include "stats.h"
+
+// Starting number of interned paths, must be a power of two
+#define PATHS_MIN_CAPACITY 64
+
+// Allocates one zeroed field array, pages are only touched once used
+static void * field_array(size_t capacity, size_t size) {
+    void *array = calloc(capacity, size);
+    countStat(COUNT_ALLOCS, 1);
+
+    if (array == NULL) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+/*  Function to initialize an empty history of at most capacity jobs.
+    The arrays are reserved up front, the kernel only backs the
+    pages that finished jobs are written to.
+ */
+void initExitHistory(ExitHistory *history, size_t capacity) {
+    history->capacity = capacity;
+    history->count = 0;
+    history->next = 0;
+    history->total = 0;
+
+    history->pid = field_array(capacity, sizeof(pid_t));
+    history->path_id = field_array(capacity, sizeof(uint32_t));
+    history->status = field_array(capacity, sizeof(int32_t));
+    history->maxrss_kb = field_array(capacity, sizeof(uint32_t));
+    history->inblock = field_array(capacity, sizeof(uint32_t));
+    history->oublock = field_array(capacity, sizeof(uint32_t));
+    history->user_us = field_array(capacity, sizeof(uint64_t));
+    history->sys_us = field_array(capacity, sizeof(uint64_t));
+    history->runtime_us = field_array(capacity, sizeof(uint64_t));
+
+    history->path_count = 0;
+    history->path_capacity = PATHS_MIN_CAPACITY;
+    history->paths = field_array(PATHS_MIN_CAPACITY, sizeof(char *));
+    history->path_slots = field_array(PATHS_MIN_CAPACITY * 2, sizeof(uint32_t));
+}
+
+// FNV-1a hash of a path
+static uint32_t hash_path(const char *path) {
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char *p = (const unsigned char *) path; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+// Slot of path in path_slots, or the empty slot where it would go
+static uint32_t find_path_slot(const ExitHistory *history, const char *path) {
+    uint32_t mask = history->path_capacity * 2 - 1;
+    uint32_t i = hash_path(path) & mask;
+
+    while (history->path_slots[i] != 0 && strcmp(history->paths[history->path_slots[i] - 1], path) != 0) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Returns the index of path, adding it the first time it is seen
+static uint32_t intern_path(ExitHistory *history, const char *path) {
+    uint32_t slot = find_path_slot(history, path);
+
+    if (history->path_slots[slot] != 0) {
+        return history->path_slots[slot] - 1;
+    }
+
+    // Doubling keeps the hash at most half full
+    if (history->path_count == history->path_capacity) {
+        uint32_t capacity = history->path_capacity * 2;
+        char **paths = realloc(history->paths, capacity * sizeof(char *));
+        countStat(COUNT_ALLOCS, 1);
+        if (paths == NULL) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        free(history->path_slots);
+        history->paths = paths;
+        history->path_capacity = capacity;
+        history->path_slots = field_array(capacity * 2, sizeof(uint32_t));
+        for (uint32_t i = 0; i < history->path_count; i++) {
+            history->path_slots[find_path_slot(history, paths[i])] = i + 1;
+        }
+        slot = find_path_slot(history, path);
+    }
+
+    history->paths[history->path_count] = strdup(path);
+    countStat(COUNT_ALLOCS, 1);
+    history->path_slots[slot] = ++history->path_count;
+    return history->path_count - 1;
+}
+
+// Microseconds in a timeval
+static uint64_t timeval_us(const struct timeval *tv) {
+    return (uint64_t) tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+/*  Function to add a reaped job, overwriting the oldest one once
+    the history is full. status and usage are what wait4() returned.
+ */
+void recordExit(ExitHistory *history, pid_t pid, const char *path, int status,
+                const struct rusage *usage, uint64_t runtime_us) {
+    size_t i = history->next;
+
+    history->pid[i] = pid;
+    history->path_id[i] = intern_path(history, path);
+    history->status[i] = status;
+    history->maxrss_kb[i] = (uint32_t) usage->ru_maxrss;
+    history->inblock[i] = (uint32_t) usage->ru_inblock;
+    history->oublock[i] = (uint32_t) usage->ru_oublock;
+    history->user_us[i] = timeval_us(&usage->ru_utime);
+    history->sys_us[i] = timeval_us(&usage->ru_stime);
+    history->runtime_us[i] = runtime_us;
+
+    history->next = (i + 1) % history->capacity;
+    if (history->count < history->capacity) {
+        history->count++;
+    }
+    history->total++;
+}
+
+// Prints how a job ended into buf, "exit 0" or "signal 9"
+static void format_status(int status, char *buf, size_t size) {
+    if (WIFSIGNALED(status)) {
+        snprintf(buf, size, "signal %d", WTERMSIG(status));
+    }
+    else {
+        snprintf(buf, size, "exit %d", WEXITSTATUS(status));
+    }
+}
+
+// Function to print the last rows finished jobs, newest last
+void printExitHistory(const ExitHistory *history, size_t rows) {
+    if (rows > history->count) {
+        rows = history->count;
+    }
+
+    printf("%8s %-10s %10s %9s %9s %10s %9s %9s  %s\n", "PID", "ENDED", "RUNTIME(s)",
+           "USER(s)", "SYS(s)", "MAXRSS(KB)", "READ", "WRITE", "PATH");
+    for (size_t k = rows; k > 0; k--) {
+        size_t i = (history->next + history->capacity - k) % history->capacity;
+        char ended[24];
+
+        format_status(history->status[i], ended, sizeof(ended));
+        printf("%8d %-10s %10.3f %9.3f %9.3f %10u %9u %9u  %s\n", history->pid[i], ended,
+               history->runtime_us[i] / 1e6, history->user_us[i] / 1e6, history->sys_us[i] / 1e6,
+               history->maxrss_kb[i], history->inblock[i], history->oublock[i],
+               history->paths[history->path_id[i]]);
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/*  Function to print totals over every job in the history:
+    cpu time, peak rss, failures and runtime percentiles.
+ */
+void printExitSummary(const ExitHistory *history) {
+    uint64_t cpu_us = 0;
+    uint32_t peak_rss = 0;
+    size_t failed = 0;
+    size_t n = history->count;
+
+    if (n == 0) {
+        printf("No finished jobs\n");
+        return;
+    }
+
+    // Each loop reads only the arrays it sums
+    for (size_t i = 0; i < n; i++) {
+        cpu_us += history->user_us[i] + history->sys_us[i];
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (history->maxrss_kb[i] > peak_rss) {
+            peak_rss = history->maxrss_kb[i];
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!WIFEXITED(history->status[i]) || WEXITSTATUS(history->status[i]) != 0) {
+            failed++;
+        }
+    }
+
+    uint64_t *runtimes = malloc(n * sizeof(uint64_t));
+    countStat(COUNT_ALLOCS, 1);
+    if (runtimes == NULL) {
+        perror("malloc failed");
+        return;
+    }
+    memcpy(runtimes, history->runtime_us, n * sizeof(uint64_t));
+    qsort(runtimes, n, sizeof(uint64_t), compare_u64);
+
+    printf("Finished jobs: %zu kept of %llu, %zu failed or killed\n", n, history->total, failed);
+    printf("Total cpu: %.3f s, peak rss: %u KB\n", cpu_us / 1e6, peak_rss);
+    printf("Runtime (s): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+           runtimes[n / 2] / 1e6, runtimes[(n * 9) / 10] / 1e6,
+           runtimes[(n * 99) / 100] / 1e6, runtimes[n - 1] / 1e6);
+    free(runtimes);
+}
+
+// Returns the bytes the history has reserved, paths included
+size_t exitHistoryBytes(const ExitHistory *history) {
+    size_t per_entry = sizeof(pid_t) + 5 * sizeof(uint32_t) + 3 * sizeof(uint64_t);
+    size_t bytes = history->capacity * per_entry;
+
+    bytes += history->path_capacity * (sizeof(char *) + 2 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < history->path_count; i++) {
+        bytes += strlen(history->paths[i]) + 1;
+    }
+    return bytes;
+}
@@ -0,0 +1,49 @@
+#ifndef _EXITHISTORY_H_
+#define _EXITHISTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+// Finished jobs kept by bghistory before the oldest are overwritten
+#define HISTORY_CAPACITY (1 << 20)
+
+/*  Ring of finished jobs, stored as one array per field.
+    Entry i of every array is one job, so a summary over a million jobs
+    walks only the arrays it needs. Paths are interned once and an
+    entry keeps the index, an entry is 48 bytes in all.
+ */
+typedef struct {
+    size_t capacity;
+    size_t count;             // entries in use, at most capacity
+    size_t next;              // where the next finished job goes
+    unsigned long long total; // jobs ever recorded, overwritten ones included
+
+    pid_t * pid;
+    uint32_t * path_id;       // index into paths
+    int32_t * status;         // wait status, see WIFEXITED()
+    uint32_t * maxrss_kb;
+    uint32_t * inblock;       // file system reads, in 512 byte blocks
+    uint32_t * oublock;       // file system writes, in 512 byte blocks
+    uint64_t * user_us;
+    uint64_t * sys_us;
+    uint64_t * runtime_us;    // started to reaped
+
+    char ** paths;            // distinct paths, never freed
+    uint32_t path_count;
+    uint32_t path_capacity;
+    uint32_t * path_slots;    // open addressed hash of path index + 1, 0 is empty
+} ExitHistory;
+
+
+void initExitHistory(ExitHistory *history, size_t capacity);
+void recordExit(ExitHistory *history, pid_t pid, const char *path, int status,
+                const struct rusage *usage, uint64_t runtime_us);
+void printExitHistory(const ExitHistory *history, size_t rows);
+void printExitSummary(const ExitHistory *history);
+size_t exitHistoryBytes(const ExitHistory *history);
+
+
+
+#endif
@@ -0,0 +1,155 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "job_graph.h"
+#include "stats.h"
+
+// Function to initialize an empty graph, at most limit of its jobs run at once
+void initJobGraph(JobGraph *graph, int limit) {
+    memset(graph, 0, sizeof(JobGraph));
+    graph->limit = limit > 0 ? limit : 1;
+    graph->next_id = 1;
+}
+
+/*  Function to add a job that waits for its prerequisites. It is
+    started once addDependent edges to it have all been released.
+ */
+GraphNode * newGraphNode(JobGraph *graph, Supervisor *launch) {
+    GraphNode *node = calloc(1, sizeof(GraphNode));
+    countStat(COUNT_ALLOCS, 1);
+
+    if (node == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    node->id = graph->next_id++;
+    node->launch = launch;
+
+    node->prev = graph->last;
+    if (graph->last != NULL) {
+        graph->last->next = node;
+    }
+    else {
+        graph->first = node;
+    }
+    graph->last = node;
+    graph->waiting++;
+    return node;
+}
+
+/*  Function to make node wait for whatever owns *deps to end, only for
+    an exit with 0 if ok. *deps is created on the first dependent.
+ */
+void addDependent(Dependents **deps, GraphNode *node, int ok) {
+    Dependents *list = *deps;
+
+    if (list == NULL) {
+        list = *deps = calloc(1, sizeof(Dependents));
+        countStat(COUNT_ALLOCS, 1);
+    }
+    if (list != NULL && list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 4;
+        GraphNode **nodes = realloc(list->nodes, capacity * sizeof(GraphNode *));
+        char *oks = realloc(list->ok, capacity);
+        countStat(COUNT_ALLOCS, 2);
+        if (nodes != NULL) {
+            list->nodes = nodes;
+        }
+        if (oks != NULL) {
+            list->ok = oks;
+        }
+        if (nodes == NULL || oks == NULL) {
+            list = NULL;
+        }
+        else {
+            list->capacity = capacity;
+        }
+    }
+    if (list == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    list->nodes[list->count] = node;
+    list->ok[list->count] = (char) ok;
+    list->count++;
+    node->waiting++;
+}
+
+// Moves a node whose last prerequisite ended from the waiting list to the end of the ready list
+static void make_ready(JobGraph *graph, GraphNode *node) {
+    if (node->prev != NULL) {
+        node->prev->next = node->next;
+    }
+    else {
+        graph->first = node->next;
+    }
+    if (node->next != NULL) {
+        node->next->prev = node->prev;
+    }
+    else {
+        graph->last = node->prev;
+    }
+    graph->waiting--;
+
+    node->next = NULL;
+    node->prev = graph->ready_last;
+    if (graph->ready_last != NULL) {
+        graph->ready_last->next = node;
+    }
+    else {
+        graph->ready_first = node;
+    }
+    graph->ready_last = node;
+    graph->ready++;
+}
+
+/*  Function to tell the dependents of a job or node that it ended,
+    succeeded if it exited with 0. Each one's count goes down by one,
+    no other node is looked at. deps is freed, NULL does nothing.
+ */
+void releaseDependents(JobGraph *graph, Dependents *deps, int succeeded) {
+    if (deps == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < deps->count; i++) {
+        GraphNode *node = deps->nodes[i];
+
+        if (deps->ok[i] && !succeeded) {
+            node->failed = 1;
+        }
+        if (--node->waiting == 0) {
+            make_ready(graph, node);
+        }
+    }
+    free(deps->nodes);
+    free(deps->ok);
+    free(deps);
+}
+
+/*  Function to take the next ready node off the graph.
+    Returns NULL while all slots are in use, a node that is to be
+    cancelled (failed) does not need one.
+ */
+GraphNode * nextReady(JobGraph *graph) {
+    GraphNode *node = graph->ready_first;
+
+    if (node == NULL || (!node->failed && graph->running >= (size_t) graph->limit)) {
+        return NULL;
+    }
+    graph->ready_first = node->next;
+    if (graph->ready_first != NULL) {
+        graph->ready_first->prev = NULL;
+    }
+    else {
+        graph->ready_last = NULL;
+    }
+    graph->ready--;
+    node->next = NULL;
+    return node;
+}
+
+// Function to free a node taken with nextReady, its launch and dependents are the caller's
+void freeGraphNode(GraphNode *node) {
+    free(node);
+}
@@ -0,0 +1,63 @@
+#ifndef _JOBGRAPH_H_
+#define _JOBGRAPH_H_
+
+#include <stddef.h>
+
+typedef struct GraphNode GraphNode;
+typedef struct Dependents Dependents;
+typedef struct Supervisor Supervisor;
+
+/*  The jobs waiting for one job or node to end (bg --after).
+    ok[i] is 1 when nodes[i] only runs if it exits with 0.
+ */
+struct Dependents{
+    GraphNode ** nodes;
+    char * ok;
+    size_t count;
+    size_t capacity;
+};
+
+/*  A bg --after job that has not been started yet.
+    waiting counts the prerequisites that have not ended, the node
+    becomes ready when it drops to 0. Prerequisites always exist
+    before the node does, so the graph can never have a cycle.
+ */
+struct GraphNode{
+    int id;                   // #id in bgdeps
+    int waiting;              // in-degree: prerequisites still running or waiting
+    char failed;              // an --after-ok prerequisite did not exit with 0
+    Supervisor * launch;      // path, argv and options to start it with
+    Dependents * dependents;  // nodes waiting on this one, NULL if none
+    GraphNode * prev;         // in the waiting list, or the ready list once waiting is 0
+    GraphNode * next;
+};
+
+/*  Every node not started yet. Waiting nodes are only reached through
+    the Dependents of their prerequisites, the list is for bgdeps and
+    tag lookups. Ready nodes start in order, at most limit at a time.
+ */
+typedef struct {
+    GraphNode * first;        // waiting for prerequisites
+    GraphNode * last;
+    GraphNode * ready_first;  // waiting for a free slot
+    GraphNode * ready_last;
+    size_t waiting;
+    size_t ready;
+    size_t running;           // jobs started from the graph still alive
+    int limit;
+    int next_id;
+    unsigned long started;
+    unsigned long cancelled;
+} JobGraph;
+
+
+void initJobGraph(JobGraph *graph, int limit);
+GraphNode * newGraphNode(JobGraph *graph, Supervisor *launch);
+void addDependent(Dependents **deps, GraphNode *node, int ok);
+void releaseDependents(JobGraph *graph, Dependents *deps, int succeeded);
+GraphNode * nextReady(JobGraph *graph);
+void freeGraphNode(GraphNode *node);
+
+
+
+#endif
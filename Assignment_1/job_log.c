@@ -0,0 +1,505 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include "job_log.h"
+#include "stats.h"
+
+// Kernel buffer per job pipe, lets a chatty job run ahead while pman is busy
+#define LOG_PIPE_SIZE (256 * 1024)
+
+// Most bytes one splice() call may move
+#define LOG_SPLICE_CHUNK (1 << 20)
+
+// splice() calls per wakeup, so one job cannot starve the rest of the loop
+#define LOG_SPLICES_PER_EVENT 16
+
+// What drain_log() found
+#define DRAIN_EMPTY 0   // pipe is empty for now
+#define DRAIN_MORE  1   // gave up after LOG_SPLICES_PER_EVENT, data left
+#define DRAIN_EOF   2   // every writer has closed the pipe
+
+static int log_dir_fd = -1;
+
+/*  Jobs that have ended and still have a log file, oldest first from
+    kept_next. Once LOG_KEEP_FINISHED more have ended, the oldest file
+    is deleted. A pid in use again is taken out, its file is the new
+    job's now. 0 is an empty entry.
+ */
+static pid_t kept[LOG_KEEP_FINISHED];
+static size_t kept_next = 0;
+
+// Cleared if the log directory's filesystem cannot splice, then read/write is used
+static int splice_works = 1;
+
+// The log bglog -f is showing, NULL if none
+static JobLog *followed = NULL;
+
+// Logs of reaped jobs whose pipe is still open in a child they left running
+static JobLog *lingering = NULL;
+
+// Counts the log of pid as finished, deleting the oldest one kept
+static void keep_finished(pid_t pid) {
+    if (kept[kept_next] != 0) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "%d.log", kept[kept_next]);
+        countStat(COUNT_SYSCALLS, 1);
+        unlinkat(log_dir_fd, name, 0);
+    }
+    kept[kept_next] = pid;
+    kept_next = (kept_next + 1) % LOG_KEEP_FINISHED;
+}
+
+// A log file left by an earlier pman, for sorting by age
+typedef struct {
+    pid_t pid;
+    time_t mtime;
+} OldLog;
+
+// Orders old logs from the least recently written
+static int by_mtime(const void *a, const void *b) {
+    const OldLog *x = a;
+    const OldLog *y = b;
+
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+// Counts the logs an earlier pman left behind as finished, so the oldest go first
+static void keep_old_logs(void) {
+    int fd = dup(log_dir_fd);
+    DIR *dir = (fd == -1) ? NULL : fdopendir(fd);
+    OldLog *logs = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+
+    if (dir == NULL) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        struct stat info;
+        char *end;
+        long pid = strtol(entry->d_name, &end, 10);
+
+        if (end == entry->d_name || strcmp(end, ".log") != 0 || pid <= 0
+            || fstatat(log_dir_fd, entry->d_name, &info, 0) == -1) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            OldLog *bigger = realloc(logs, capacity * sizeof(OldLog));
+            countStat(COUNT_ALLOCS, 1);
+            if (bigger == NULL) {
+                break;
+            }
+            logs = bigger;
+        }
+        logs[count].pid = (pid_t) pid;
+        logs[count].mtime = info.st_mtime;
+        count++;
+    }
+    closedir(dir);
+
+    qsort(logs, count, sizeof(OldLog), by_mtime);
+    for (size_t i = 0; i < count; i++) {
+        keep_finished(logs[i].pid);
+    }
+    free(logs);
+}
+
+/*  Function to open the directory the logs go to, created if missing.
+    Logs left there by an earlier pman count as finished jobs.
+    Returns 0 on success, -1 if output cannot be captured.
+ */
+int initJobLogs(const char *dir) {
+    if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+        perror(dir);
+        return -1;
+    }
+    log_dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (log_dir_fd == -1) {
+        perror(dir);
+        return -1;
+    }
+    keep_old_logs();
+    return 0;
+}
+
+/*  Function to create the pipe a new job writes its output into.
+    *child_fd is set to the write end, to become the child's stdout
+    and stderr; the caller closes it once the child is started.
+    Returns the log, or NULL if output is not captured.
+ */
+JobLog * createJobLog(int *child_fd) {
+    int fds[2];
+
+    if (log_dir_fd == -1) {
+        return NULL;
+    }
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("pipe failed");
+        return NULL;
+    }
+    // Only pman's end is non blocking, the child writes as usual
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[0], F_SETPIPE_SZ, LOG_PIPE_SIZE);
+
+    JobLog *log = malloc(sizeof(JobLog));
+    countStat(COUNT_ALLOCS, 1);
+    if (log == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    log->pid = 0;
+    log->pipe_fd = fds[0];
+    log->file_fd = -1;
+    log->size = 0;
+    log->followed_to = 0;
+    log->reaped = 0;
+    log->next_lingering = NULL;
+    log->watch.fd = -1;
+
+    *child_fd = fds[1];
+    return log;
+}
+
+// Copies the newest log bytes written since from into the ring
+static void copy_to_ring(JobLog *log, long long from) {
+    long long offset = log->size - LOG_RING_SIZE;
+
+    if (offset < from) {
+        offset = from;
+    }
+    // At most LOG_RING_SIZE bytes, in up to two pieces around the wrap
+    while (offset < log->size) {
+        size_t slot = offset % LOG_RING_SIZE;
+        size_t chunk = LOG_RING_SIZE - slot;
+
+        if ((long long) chunk > log->size - offset) {
+            chunk = log->size - offset;
+        }
+        countStat(COUNT_SYSCALLS, 1);
+        if (pread(log->file_fd, log->ring + slot, chunk, offset) <= 0) {
+            break;
+        }
+        offset += chunk;
+    }
+}
+
+// Prints log bytes [from, to) from the file
+static void print_file_range(int fd, long long from, long long to) {
+    char buf[65536];
+
+    while (from < to) {
+        size_t want = (to - from < (long long) sizeof(buf)) ? (size_t) (to - from) : sizeof(buf);
+        ssize_t n = pread(fd, buf, want, from);
+
+        if (n <= 0) {
+            break;
+        }
+        fwrite(buf, 1, n, stdout);
+        from += n;
+    }
+}
+
+// Shows what bglog -f has not printed yet
+static void show_followed(JobLog *log) {
+    if (followed != log || log->followed_to >= log->size) {
+        return;
+    }
+    print_file_range(log->file_fd, log->followed_to, log->size);
+    log->followed_to = log->size;
+    fflush(stdout);
+}
+
+// Moves up to one chunk from the pipe to the file through a buffer
+static ssize_t copy_chunk(JobLog *log) {
+    char buf[65536];
+    countStat(COUNT_SYSCALLS, 2);
+    ssize_t n = read(log->pipe_fd, buf, sizeof(buf));
+
+    if (n > 0 && write(log->file_fd, buf, n) != n) {
+        return -1;
+    }
+    return n;
+}
+
+/*  Moves what is in the pipe into the log file.
+    splice() hands the pipe's pages to the file without a copy through
+    pman, only the tail that ends up in the ring is read back.
+    Returns DRAIN_EMPTY, DRAIN_MORE or DRAIN_EOF.
+ */
+static int drain_log(JobLog *log) {
+    long long before = log->size;
+    int result = DRAIN_MORE;
+
+    for (int i = 0; i < LOG_SPLICES_PER_EVENT; i++) {
+        ssize_t n;
+
+        if (splice_works) {
+            countStat(COUNT_SYSCALLS, 1);
+            n = splice(log->pipe_fd, NULL, log->file_fd, NULL, LOG_SPLICE_CHUNK,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n == -1 && errno == EINVAL) {
+                splice_works = 0;
+                n = copy_chunk(log);
+            }
+        }
+        else {
+            n = copy_chunk(log);
+        }
+
+        if (n > 0) {
+            log->size += n;
+            continue;
+        }
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EAGAIN) {
+            result = DRAIN_EMPTY;
+        }
+        else {
+            // End of output, or the log cannot be written any more
+            if (n == -1) {
+                perror("writing job log failed");
+            }
+            result = DRAIN_EOF;
+        }
+        break;
+    }
+
+    if (log->size > before) {
+        copy_to_ring(log, before);
+        show_followed(log);
+    }
+    return result;
+}
+
+// Stops watching the pipe and closes it
+static void close_pipe(JobLog *log) {
+    unwatchFd(&log->watch);
+    if (log->pipe_fd >= 0) {
+        close(log->pipe_fd);
+        log->pipe_fd = -1;
+    }
+}
+
+// Closes the pipe and the file of a log that is done with and frees it
+static void finish_log(JobLog *log) {
+    close_pipe(log);
+    if (followed == log) {
+        followed = NULL;
+    }
+    if (log->file_fd >= 0) {
+        close(log->file_fd);
+        keep_finished(log->pid);
+    }
+    free(log);
+}
+
+// Takes a reaped log out of the lingering list
+static void unlink_lingering(JobLog *log) {
+    JobLog **link = &lingering;
+
+    while (*link != log) {
+        link = &(*link)->next_lingering;
+    }
+    *link = log->next_lingering;
+}
+
+// Runs when the job's pipe has output or all writers closed it
+static void on_log_ready(Watch *watch, uint32_t events) {
+    JobLog *log = watch->data;
+
+    if (drain_log(log) != DRAIN_EOF) {
+        return;
+    }
+    // The last child of a reaped job has let go of the pipe, the log is complete
+    if (log->reaped) {
+        unlink_lingering(log);
+        finish_log(log);
+        return;
+    }
+    close_pipe(log);
+}
+
+/*  Function to open <dir>/<pid>.log once the job is started and
+    to start draining its pipe.
+    Returns 0 on success, -1 on failure.
+ */
+int attachJobLog(JobLog *log, pid_t pid) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "%d.log", pid);
+    log->pid = pid;
+    // A reaped job's child may still write to the file about to be truncated, that output is dropped
+    for (JobLog *old = lingering; old != NULL; old = old->next_lingering) {
+        if (old->pid == pid) {
+            unlink_lingering(old);
+            finish_log(old);
+            break;
+        }
+    }
+    // The pid was used before, its old log is overwritten and must not be deleted later
+    for (size_t i = 0; i < LOG_KEEP_FINISHED; i++) {
+        if (kept[i] == pid) {
+            kept[i] = 0;
+        }
+    }
+    // Read back for the ring and bglog, so not write only
+    log->file_fd = openat(log_dir_fd, name, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (log->file_fd == -1) {
+        perror(name);
+        return -1;
+    }
+    if (watchFd(&log->watch, log->pipe_fd, EPOLLIN, on_log_ready, log) == -1) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+    return 0;
+}
+
+/*  Function to drain whatever the job left in the pipe and let go of
+    the log once the job is reaped. Children the job left running may
+    still hold the pipe, then it is watched until they close it too,
+    so their output is kept and their writes never fail. The log file
+    stays behind for bglog and later reading, until LOG_KEEP_FINISHED
+    more jobs have ended.
+ */
+void closeJobLog(JobLog *log) {
+    if (log == NULL) {
+        return;
+    }
+    if (log->pipe_fd >= 0 && log->file_fd >= 0 && drain_log(log) != DRAIN_EOF) {
+        if (followed == log) {
+            followed = NULL;
+        }
+        log->reaped = 1;
+        log->next_lingering = lingering;
+        lingering = log;
+        return;
+    }
+    finish_log(log);
+}
+
+/*  Prints the lines after the last `lines` newlines before size.
+    A newline that ends the output does not count as a line.
+ */
+static void print_file_tail(int fd, long long size, long lines) {
+    char buf[65536];
+    long long start = 0;
+    long long end = size;
+    long found = 0;
+
+    // Scan backwards a chunk at a time
+    while (end > 0 && start == 0) {
+        long long from = (end > (long long) sizeof(buf)) ? end - sizeof(buf) : 0;
+        ssize_t n = pread(fd, buf, end - from, from);
+
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = n - 1; i >= 0; i--) {
+            if (buf[i] == '\n' && from + i != size - 1 && ++found == lines) {
+                start = from + i + 1;
+                break;
+            }
+        }
+        end = from;
+    }
+    print_file_range(fd, start, size);
+
+    char last;
+    if (size > 0 && pread(fd, &last, 1, size - 1) == 1 && last != '\n') {
+        printf("\n");
+    }
+}
+
+/*  Function to print the last lines of a job's output.
+    Served from the in-memory ring when it holds enough lines,
+    from the log file otherwise.
+ */
+void printJobLogTail(JobLog *log, long lines) {
+    long long kept = (log->size < LOG_RING_SIZE) ? log->size : LOG_RING_SIZE;
+    long long start = -1;
+    long found = 0;
+
+    for (long long offset = log->size - 1; offset >= log->size - kept; offset--) {
+        if (log->ring[offset % LOG_RING_SIZE] == '\n' && offset != log->size - 1 && ++found == lines) {
+            start = offset + 1;
+            break;
+        }
+    }
+    // The ring reaches back to the start of the log, so that is enough too
+    if (start == -1 && kept == log->size) {
+        start = 0;
+    }
+
+    if (start == -1) {
+        print_file_tail(log->file_fd, log->size, lines);
+    }
+    else {
+        for (long long offset = start; offset < log->size; ) {
+            size_t slot = offset % LOG_RING_SIZE;
+            size_t chunk = LOG_RING_SIZE - slot;
+
+            if ((long long) chunk > log->size - offset) {
+                chunk = log->size - offset;
+            }
+            fwrite(log->ring + slot, 1, chunk, stdout);
+            offset += chunk;
+        }
+        if (log->size > 0 && log->ring[(log->size - 1) % LOG_RING_SIZE] != '\n') {
+            printf("\n");
+        }
+    }
+}
+
+/*  Function to print the last lines of <dir>/<pid>.log of a job
+    that is no longer tracked.
+    Returns 0 on success, -1 if there is no such log.
+ */
+int printLogFileTail(pid_t pid, long lines) {
+    char name[32];
+    struct stat info;
+
+    if (log_dir_fd == -1) {
+        return -1;
+    }
+    snprintf(name, sizeof(name), "%d.log", pid);
+    int fd = openat(log_dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    if (fstat(fd, &info) == 0) {
+        print_file_tail(fd, info.st_size, lines);
+    }
+    close(fd);
+    return 0;
+}
+
+// Function to keep printing a job's new output as it arrives
+void followJobLog(JobLog *log) {
+    followed = log;
+    log->followed_to = log->size;
+}
+
+// Function to stop bglog -f
+void stopFollow(void) {
+    followed = NULL;
+}
+
+// Returns 1 while bglog -f is showing a job's output
+int isFollowActive(void) {
+    return followed != NULL;
+}
@@ -0,0 +1,45 @@
+#ifndef _JOBLOG_H_
+#define _JOBLOG_H_
+
+#include <sys/types.h>
+#include "event_loop.h"
+
+// Bytes of the newest output kept in memory per job for bglog
+#define LOG_RING_SIZE 4096
+
+// Log files of ended jobs kept for bglog, the oldest is deleted when one more ends
+#define LOG_KEEP_FINISHED 1000
+
+typedef struct JobLog JobLog;
+
+/*  Captured output of one job.
+    The job's stdout and stderr share one pipe, pman splices it into
+    <dir>/<pid>.log without copying it through user space, and
+    only the newest LOG_RING_SIZE bytes are copied into ring.
+ */
+struct JobLog{
+    pid_t pid;
+    int pipe_fd;              // read end, -1 once the writers are gone
+    int file_fd;              // <dir>/<pid>.log
+    long long size;           // bytes written to the log so far
+    long long followed_to;    // bytes already shown by bglog -f
+    int reaped;               // 1 once the job is reaped while its children still hold the pipe
+    JobLog * next_lingering;  // in the list of reaped logs, while reaped
+    Watch watch;
+    char ring[LOG_RING_SIZE]; // log bytes [size - LOG_RING_SIZE, size) at their offset % LOG_RING_SIZE
+};
+
+
+int initJobLogs(const char *dir);
+JobLog * createJobLog(int *child_fd);
+int attachJobLog(JobLog *log, pid_t pid);
+void closeJobLog(JobLog *log);
+void printJobLogTail(JobLog *log, long lines);
+int printLogFileTail(pid_t pid, long lines);
+void followJobLog(JobLog *log);
+void stopFollow(void);
+int isFollowActive(void);
+
+
+
+#endif
@@ -0,0 +1,73 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "job_queue.h"
+#include "stats.h"
+
+// Function to initialize an empty queue running limit commands at once
+void initJobQueue(JobQueue *queue, int limit) {
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->queued = 0;
+    queue->running = 0;
+    queue->finished = 0;
+    queue->failed = 0;
+    queue->limit = limit;
+    queue->capture = 1;
+    queue->start.tv_sec = 0;
+    queue->start.tv_nsec = 0;
+}
+
+/*  Function to append a copy of line to the queue.
+    Header and text share one allocation, 10k commands are 10k mallocs.
+ */
+void pushCommand(JobQueue *queue, const char *line) {
+    size_t len = strlen(line);
+    QueuedCommand *command = malloc(sizeof(QueuedCommand) + len + 1);
+    countStat(COUNT_ALLOCS, 1);
+
+    if (command == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(command->line, line, len + 1);
+    command->next = NULL;
+
+    // Going from idle to busy starts a new throughput measurement
+    if (queueIdle(queue)) {
+        clock_gettime(CLOCK_MONOTONIC, &queue->start);
+        queue->finished = 0;
+        queue->failed = 0;
+    }
+
+    if (queue->tail) {
+        queue->tail->next = command;
+    }
+    else {
+        queue->head = command;
+    }
+    queue->tail = command;
+    queue->queued++;
+}
+
+/*  Function to take the oldest command off the queue.
+    Returns NULL if it is empty, the caller frees the command.
+ */
+QueuedCommand * popCommand(JobQueue *queue) {
+    QueuedCommand *command = queue->head;
+
+    if (command == NULL) {
+        return NULL;
+    }
+    queue->head = command->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    queue->queued--;
+    return command;
+}
+
+// Returns 1 if nothing is waiting and nothing from the queue is running
+int queueIdle(const JobQueue *queue) {
+    return queue->queued == 0 && queue->running == 0;
+}
@@ -0,0 +1,39 @@
+#ifndef _JOBQUEUE_H_
+#define _JOBQUEUE_H_
+
+#include <stddef.h>
+#include <time.h>
+
+typedef struct QueuedCommand QueuedCommand;
+
+// One pending command line, the text is stored right after the header
+struct QueuedCommand{
+    QueuedCommand * next;
+    char line[];
+};
+
+/*  FIFO of commands waiting for a free slot (bgqueue).
+    At most limit queued jobs run at once, the next command is
+    started as soon as one of them is reaped.
+ */
+typedef struct {
+    QueuedCommand * head;
+    QueuedCommand * tail;
+    size_t queued;            // commands waiting
+    size_t running;           // jobs started from the queue still alive
+    unsigned long finished;   // commands done, failed ones included
+    unsigned long failed;     // commands that could not be started
+    int limit;
+    int capture;              // bgqueue --log=on|off, output of the jobs it starts
+    struct timespec start;    // when the queue last went from idle to busy
+} JobQueue;
+
+
+void initJobQueue(JobQueue *queue, int limit);
+void pushCommand(JobQueue *queue, const char *line);
+QueuedCommand * popCommand(JobQueue *queue);
+int queueIdle(const JobQueue *queue);
+
+
+
+#endif
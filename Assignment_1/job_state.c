@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "job_state.h"
+#include "stats.h"
+
+#define STATE_MAGIC "PMANJOBS"
+#define STATE_VERSION 1
+
+// Records in a new file, doubled whenever it is full
+#define STATE_MIN_CAPACITY 1024
+
+/*  The state file is mapped shared, so every store lands in the page
+    cache at once and survives pman being killed. Nothing is written
+    with write() and nothing needs msync, only a crash of the whole
+    machine loses it, and that takes the jobs with it.
+ */
+static int state_fd = -1;
+static StateHeader *header = NULL;    // the mapping starts with it
+static StateRecord *records = NULL;
+static size_t map_size = 0;
+
+// Free records, taken from the end. Lowest first after opening, so the file stays dense
+static uint32_t *free_slots = NULL;
+static size_t free_count = 0;
+
+// Bytes of a file with capacity records
+static size_t file_size(uint64_t capacity) {
+    return sizeof(StateHeader) + capacity * sizeof(StateRecord);
+}
+
+// Reads the id of this boot, empty if it is not available
+static void read_boot_id(char *boot_id, size_t size) {
+    memset(boot_id, 0, size);
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    ssize_t n = read(fd, boot_id, size - 1);
+    close(fd);
+    if (n > 0 && boot_id[n - 1] == '\n') {
+        boot_id[n - 1] = '\0';
+    }
+}
+
+// Returns 1 if the file starts with a header pman can use on this boot
+static int usable_header(const StateHeader *found, off_t size, const char *boot_id) {
+    // A file grown before a crash can be longer than capacity says, never shorter
+    return memcmp(found->magic, STATE_MAGIC, sizeof(found->magic)) == 0
+           && found->version == STATE_VERSION
+           && found->record_size == sizeof(StateRecord)
+           && found->capacity > 0
+           && (off_t) file_size(found->capacity) <= size
+           && strncmp(found->boot_id, boot_id, sizeof(found->boot_id)) == 0;
+}
+
+// Makes room in the free list for capacity records
+static int grow_free_slots(size_t capacity) {
+    uint32_t *bigger = realloc(free_slots, capacity * sizeof(uint32_t));
+    countStat(COUNT_ALLOCS, 1);
+    if (bigger == NULL) {
+        return -1;
+    }
+    free_slots = bigger;
+    return 0;
+}
+
+// Pushes the records from first up to capacity as free, the lowest ends up on top
+static void push_free_range(size_t first, size_t capacity) {
+    for (size_t slot = capacity; slot > first; slot--) {
+        free_slots[free_count++] = (uint32_t) (slot - 1);
+    }
+}
+
+/*  Doubles the file and its mapping. The file grows before the header
+    says so, a crash in between only leaves unused space at the end.
+    Returns 0, -1 if the file cannot grow.
+ */
+static int grow_state(void) {
+    uint64_t old_capacity = header->capacity;
+    uint64_t capacity = old_capacity * 2;
+
+    countStat(COUNT_SYSCALLS, 2);
+    if (ftruncate(state_fd, file_size(capacity)) == -1) {
+        return -1;
+    }
+    void *map = mremap(header, map_size, file_size(capacity), MREMAP_MAYMOVE);
+    if (map == MAP_FAILED || grow_free_slots(capacity) == -1) {
+        return -1;
+    }
+    header = map;
+    records = (StateRecord *) (header + 1);
+    map_size = file_size(capacity);
+    header->capacity = capacity;
+
+    // Only called once every record is in use
+    push_free_range(old_capacity, capacity);
+    return 0;
+}
+
+// Orders live records by start time, which is the order the jobs were started in
+static int by_starttime(const void *a, const void *b) {
+    const StateRecord *x = &records[*(const uint32_t *) a];
+    const StateRecord *y = &records[*(const uint32_t *) b];
+
+    if (x->starttime != y->starttime) {
+        return x->starttime < y->starttime ? -1 : 1;
+    }
+    return x->pid - y->pid;
+}
+
+/*  Function to open the state file at path, or create it. Every live
+    record is passed to reattach oldest job first, the ones it refuses
+    are freed. The file is locked, a second pman runs without one.
+    Returns 0, -1 after printing why jobs will not be kept.
+ */
+int openJobState(const char *path, reattach_handler reattach) {
+    StateHeader found;
+    struct stat st;
+    char boot_id[40];
+
+    read_boot_id(boot_id, sizeof(boot_id));
+    countStat(COUNT_SYSCALLS, 4);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        printf("Could not open %s (%s), jobs are not kept across restarts\n", path, strerror(errno));
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        printf("%s is used by another pman, jobs are not kept across restarts\n", path);
+        close(fd);
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        st.st_size = 0;
+    }
+
+    int usable = st.st_size >= (off_t) sizeof(found) && pread(fd, &found, sizeof(found), 0) == sizeof(found)
+                 && usable_header(&found, st.st_size, boot_id);
+    uint64_t capacity = usable ? found.capacity : STATE_MIN_CAPACITY;
+
+    // Anything else is started over, the old contents are dropped
+    if (!usable && (ftruncate(fd, 0) == -1 || ftruncate(fd, file_size(capacity)) == -1)) {
+        printf("Could not size %s (%s), jobs are not kept across restarts\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, file_size(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED || grow_free_slots(capacity) == -1) {
+        printf("Could not map %s (%s), jobs are not kept across restarts\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    state_fd = fd;
+    header = map;
+    records = (StateRecord *) (header + 1);
+    map_size = file_size(capacity);
+    if (!usable) {
+        memcpy(header->magic, STATE_MAGIC, sizeof(header->magic));
+        header->version = STATE_VERSION;
+        header->record_size = sizeof(StateRecord);
+        memcpy(header->boot_id, boot_id, sizeof(header->boot_id));
+        header->capacity = capacity;
+        return 0;
+    }
+
+    // Live records are collected in free_slots for now, it is rebuilt after
+    size_t live = 0;
+    for (size_t slot = 0; slot < capacity; slot++) {
+        if (__atomic_load_n(&records[slot].state, __ATOMIC_ACQUIRE) == STATE_LIVE) {
+            free_slots[live++] = (uint32_t) slot;
+        }
+    }
+    qsort(free_slots, live, sizeof(uint32_t), by_starttime);
+    for (size_t i = 0; i < live; i++) {
+        StateRecord *record = &records[free_slots[i]];
+
+        // Make sure the strings end inside the record, whatever the file holds
+        record->path[STATE_PATH_SIZE - 1] = '\0';
+        record->pgroup[STATE_PGROUP_SIZE - 1] = '\0';
+        record->tags[STATE_TAGS_SIZE - 1] = '\0';
+        if (reattach(record, (int) free_slots[i]) == -1) {
+            __atomic_store_n(&record->state, STATE_FREE, __ATOMIC_RELEASE);
+        }
+    }
+
+    free_count = 0;
+    for (size_t slot = capacity; slot > 0; slot--) {
+        if (records[slot - 1].state != STATE_LIVE) {
+            // Only garbage is written, free records are left untouched
+            if (records[slot - 1].state != STATE_FREE) {
+                records[slot - 1].state = STATE_FREE;
+            }
+            free_slots[free_count++] = (uint32_t) (slot - 1);
+        }
+    }
+    return 0;
+}
+
+/*  Function to record a job that was just started.
+    Returns its slot for clearJobState, -1 if there is no state file
+    or it cannot grow.
+ */
+int saveJobState(pid_t pid, uint64_t starttime, pid_t pgid, const char *path, const char *pgroup, const char *tags) {
+    if (header == NULL) {
+        return -1;
+    }
+    if (free_count == 0 && grow_state() == -1) {
+        printf("State file is full, job %d is not kept across restarts\n", pid);
+        return -1;
+    }
+
+    uint32_t slot = free_slots[--free_count];
+    StateRecord *record = &records[slot];
+
+    record->pid = pid;
+    record->starttime = starttime;
+    record->pgid = pgid;
+    record->reserved = 0;
+    snprintf(record->path, sizeof(record->path), "%s", path);
+    snprintf(record->pgroup, sizeof(record->pgroup), "%s", pgroup ? pgroup : "");
+    snprintf(record->tags, sizeof(record->tags), "%s", tags ? tags : "");
+
+    // Only now does the record count, the fields above are already in place
+    __atomic_store_n(&record->state, STATE_LIVE, __ATOMIC_RELEASE);
+    return (int) slot;
+}
+
+// Function to free the record of a job that is gone, slot -1 is ignored
+void clearJobState(int slot) {
+    if (header == NULL || slot < 0) {
+        return;
+    }
+    __atomic_store_n(&records[slot].state, STATE_FREE, __ATOMIC_RELEASE);
+    free_slots[free_count++] = (uint32_t) slot;
+}
@@ -0,0 +1,54 @@
+#ifndef _JOBSTATE_H_
+#define _JOBSTATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define STATE_PATH_SIZE 136   // longer paths are cut short
+#define STATE_PGROUP_SIZE 32
+#define STATE_TAGS_SIZE 64
+
+// What a record holds, state is always stored last
+#define STATE_FREE 0
+#define STATE_LIVE 1
+
+/*  One job in the state file, 256 bytes.
+    A record is filled in while its state is STATE_FREE and only then
+    marked live, so a pman that dies half way leaves a free record
+    behind, never a live one with a torn path.
+ */
+typedef struct {
+    uint32_t state;                 // STATE_FREE or STATE_LIVE
+    pid_t pid;
+    uint64_t starttime;             // clock ticks after boot, /proc/<pid>/stat field 22
+    pid_t pgid;
+    uint32_t reserved;
+    char path[STATE_PATH_SIZE];
+    char pgroup[STATE_PGROUP_SIZE]; // named process group, empty for none
+    char tags[STATE_TAGS_SIZE];     // comma separated, empty for none
+} StateRecord;
+
+/*  Start of the state file, the records follow it.
+    A file from another boot is started over, its pids and start
+    times mean nothing any more.
+ */
+typedef struct {
+    char magic[8];                  // "PMANJOBS"
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;              // records in the file
+    char boot_id[40];               // /proc/sys/kernel/random/boot_id
+} StateHeader;
+
+// Called for every live record when the file is opened, returns 0 to keep it, -1 to free it
+typedef int (*reattach_handler)(const StateRecord *record, int slot);
+
+
+int openJobState(const char *path, reattach_handler reattach);
+int saveJobState(pid_t pid, uint64_t starttime, pid_t pgid, const char *path, const char *pgroup, const char *tags);
+void clearJobState(int slot);
+
+
+
+#endif
@@ -0,0 +1,212 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "job_table.h"
+#include "stats.h"
+
+// Starting number of hash slots, must be a power of two
+#define JOBTABLE_MIN_CAPACITY 16
+
+// Home slot of a pid (Fibonacci hashing so sequential pids spread out)
+static size_t home_slot(const JobTable *table, pid_t pid) {
+    return (size_t)(((uint32_t)pid * 2654435769u) & (table->capacity - 1));
+}
+
+/*  Returns the index of the slot holding pid, or the empty slot
+    where it would be inserted if it is not in the table.
+ */
+static size_t probe_slot(const JobTable *table, pid_t pid) {
+    size_t mask = table->capacity - 1;
+    size_t i = home_slot(table, pid);
+
+    while (table->slots[i] != NULL && table->slots[i]->pid != pid) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Allocates a new slot array of new_capacity and re-inserts every job
+static void resize_slots(JobTable *table, size_t new_capacity) {
+    Job **new_slots = calloc(new_capacity, sizeof(Job *));
+    countStat(COUNT_ALLOCS, 1);
+    if (!new_slots) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    free(table->slots);
+    table->slots = new_slots;
+    table->capacity = new_capacity;
+
+    // Walking the insertion order list is enough to rebuild the hash
+    for (Job *job = table->first; job != NULL; job = job->next) {
+        table->slots[probe_slot(table, job->pid)] = job;
+    }
+}
+
+// Function to initialize an empty job table
+void initJobTable(JobTable *table) {
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->first = NULL;
+    table->last = NULL;
+    resize_slots(table, JOBTABLE_MIN_CAPACITY);
+}
+
+// Function to add a job, appended at the tail of the insertion order
+Job * add_newJob(JobTable *table, pid_t new_pid, const char * new_path) {
+    // Keep the table at most half full so probe sequences stay short
+    if ((table->count + 1) * 2 > table->capacity) {
+        resize_slots(table, table->capacity * 2);
+    }
+
+    size_t slot = probe_slot(table, new_pid);
+    if (table->slots[slot] != NULL) {
+        // pid already tracked, nothing to add
+        return table->slots[slot];
+    }
+
+    Job *new_job = (Job *)malloc(sizeof(Job));
+    countStat(COUNT_ALLOCS, 1);
+    if (!new_job) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    new_job->pid = new_pid;
+    new_job->path = strdup(new_path);
+    countStat(COUNT_ALLOCS, 1);
+    new_job->pidfd = -1;
+    new_job->requested_state = ' ';
+    new_job->watch.fd = -1;
+    initProcSampler(&new_job->sampler, new_pid);
+    new_job->history = NULL;
+    new_job->group = NULL;
+    new_job->from_queue = 0;
+    new_job->log = NULL;
+    new_job->started_ns = statClock();
+    new_job->tree = NULL;
+    new_job->supervisor = NULL;
+    new_job->pgid = new_pid;
+    new_job->pgroup = NULL;
+    new_job->tags = NULL;
+    new_job->batch = NULL;
+    new_job->perf = NULL;
+    new_job->last_io_ns = 0;
+    new_job->state_slot = -1;
+    new_job->adopted = 0;
+    new_job->from_graph = 0;
+    new_job->dependents = NULL;
+    // Only started by bg --timeout, which sets the handler
+    initTimer(&new_job->timeout, NULL, new_job);
+    new_job->kill_after_ms = 0;
+    new_job->timed_out = 0;
+    new_job->next = NULL;
+    new_job->prev = table->last;
+
+    // Linking at the tail, no traversal needed
+    if (table->last) {
+        table->last->next = new_job;
+    }
+    else {
+        table->first = new_job;
+    }
+    table->last = new_job;
+
+    table->slots[slot] = new_job;
+    table->count++;
+
+    return new_job;
+}
+
+// Function to find the job with given pid, NULL if not tracked
+Job * findJob(JobTable *table, pid_t pid) {
+    return table->slots[probe_slot(table, pid)];
+}
+
+// Frees a job and the strings it owns, the rest is released by drop_job first
+static void free_job(Job *job) {
+    free(job->path);
+    free(job->tags);
+    free(job);
+}
+
+/*  Function to remove a job that is known to be in the table.
+    Uses backward shift deletion so no tombstones are left behind.
+ */
+void removeJob(JobTable *table, Job *job) {
+    size_t mask = table->capacity - 1;
+    size_t i = probe_slot(table, job->pid);
+    size_t j = i;
+
+    // Shift later entries of the same probe run back into the hole
+    table->slots[i] = NULL;
+    while (1) {
+        j = (j + 1) & mask;
+        if (table->slots[j] == NULL) {
+            break;
+        }
+        size_t k = home_slot(table, table->slots[j]->pid);
+
+        // Entry at j may stay if its home slot lies cyclically in (i, j]
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+        table->slots[i] = table->slots[j];
+        table->slots[j] = NULL;
+        i = j;
+    }
+
+    // Unlink from the insertion order list
+    if (job->prev) {
+        job->prev->next = job->next;
+    }
+    else {
+        table->first = job->next;
+    }
+    if (job->next) {
+        job->next->prev = job->prev;
+    }
+    else {
+        table->last = job->prev;
+    }
+    table->count--;
+
+    // Deallocate the memory
+    free_job(job);
+}
+
+/*  Function to delete the job with given pid
+    Returns 1 if it was removed otherwise 0
+ */
+int deleteJob(JobTable *table, pid_t pid) {
+    Job *job = findJob(table, pid);
+
+    if (job == NULL) {
+        // PID not found
+        fprintf(stderr, "Process with the PID %d is not found\n", pid);
+        return 0;
+    }
+    removeJob(table, job);
+    return 1;
+}
+
+// Function to free every job and the slot array
+void freeJobTable(JobTable *table) {
+    Job *current = table->first;
+
+    while (current != NULL) {
+        Job *next = current->next;
+        free_job(current);
+        current = next;
+    }
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->first = NULL;
+    table->last = NULL;
+}
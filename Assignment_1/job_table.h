@@ -0,0 +1,80 @@
+#ifndef _JOBTABLE_H_
+#define _JOBTABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "event_loop.h"
+#include "proc_sampler.h"
+#include "timer_wheel.h"
+
+typedef struct Job Job;
+typedef struct JobHistory JobHistory;
+typedef struct JobGroup JobGroup;
+typedef struct JobLog JobLog;
+typedef struct ProcTree ProcTree;
+typedef struct Supervisor Supervisor;
+typedef struct ProcessGroup ProcessGroup;
+typedef struct KillBatch KillBatch;
+typedef struct PerfCounters PerfCounters;
+typedef struct Dependents Dependents;
+
+/*  A tracked background job.
+    prev/next keep the jobs in the order they were started so
+    bglist prints them the same way the old linked list did.
+ */
+struct Job{
+    pid_t pid;
+    char * path;
+    int pidfd;            // pidfd_open() handle, -1 until opened
+    char requested_state; // 'T' after bgstop, 'R' after bgstart, ' ' otherwise
+    Watch watch;          // event loop registration of pidfd
+    ProcSampler sampler;  // cached /proc fds for pstat
+    JobHistory * history; // ptop sample ring, NULL until first sampled
+    JobGroup * group;     // cgroup the job runs in, NULL for none
+    char from_queue;      // 1 if started by bgqueue, counts against its limit
+    JobLog * log;         // captured stdout/stderr, NULL if it goes to the terminal
+    uint64_t started_ns;  // statClock() when it was added, for its runtime
+    ProcTree * tree;      // the job and its descendants, NULL until pstat --tree
+    Supervisor * supervisor; // how to start it again (bg --restart), NULL if it is not
+    pid_t pgid;           // process group, its own pid unless it joined a named one
+    ProcessGroup * pgroup; // named process group (bg --pgroup), NULL for its own
+    char * tags;          // comma separated (bg --tag), NULL for none
+    KillBatch * batch;    // bulk bgkill waiting for it to be reaped, NULL if none
+    PerfCounters * perf;  // perf_event_open counters (bgperf), NULL until attached
+    IoCounters last_io;   // previous /proc/<pid>/io reading, for rates
+    uint64_t last_io_ns;  // statClock() of that reading, 0 before the first
+    int state_slot;       // record in the state file, -1 if it is not kept there
+    char adopted;         // 1 if reattached from the state file, not pman's child
+    char from_graph;      // 1 if started by bg --after, counts against its limit
+    Dependents * dependents; // bg --after jobs waiting for it to end, NULL if none
+    Timer timeout;        // bg --timeout, SIGTERM and then SIGKILL once it fires
+    long kill_after_ms;   // bg --kill-after, from SIGTERM to SIGKILL
+    char timed_out;       // 0, or the signal the timeout last sent
+    Job * prev;
+    Job * next;
+};
+
+/*  Job table keyed by pid.
+    slots is an open-addressed (linear probing) hash of Job pointers,
+    its capacity is always a power of two and kept at most half full.
+ */
+typedef struct {
+    Job ** slots;
+    size_t capacity;
+    size_t count;
+    Job * first;
+    Job * last;
+} JobTable;
+
+
+void initJobTable(JobTable *table);
+Job * add_newJob(JobTable *table, pid_t new_pid, const char * new_path);
+Job * findJob(JobTable *table, pid_t pid);
+void removeJob(JobTable *table, Job *job);
+int deleteJob(JobTable *table, pid_t pid);
+void freeJobTable(JobTable *table);
+
+
+
+#endif
@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+#include <spawn.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include "launcher.h"
+#include "stats.h"
+
+extern char **environ;
+
+// Spawn attributes shared by every launch, set up once
+static posix_spawnattr_t spawn_attr;
+
+// Stack the cgroup launch child runs on until exec, one is enough since the parent waits
+#define CHILD_STACK_SIZE (64 * 1024)
+static char child_stack[CHILD_STACK_SIZE] __attribute__((aligned(16)));
+
+// What the cgroup launch child needs, err is filled in by the child if it fails
+typedef struct {
+    const char *path;
+    char *const *argv;
+    const LaunchOptions *opts;
+    int procs_fd;
+    int err;
+} ChildLaunch;
+
+/*  Function to prepare the spawn attributes.
+    pman keeps SIGCHLD blocked for its signalfd, children start
+    with an empty signal mask instead of inheriting that.
+    Returns 0 on success, -1 on failure.
+ */
+int initLauncher(void) {
+    sigset_t empty;
+
+    sigemptyset(&empty);
+    if (posix_spawnattr_init(&spawn_attr) != 0
+        || posix_spawnattr_setsigmask(&spawn_attr, &empty) != 0
+        || posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK) != 0) {
+        fprintf(stderr, "posix_spawnattr setup failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Function to set every launch option to "not given"
+void initLaunchOptions(LaunchOptions *opts) {
+    opts->cgroup_fd = -1;
+    opts->cpus = NULL;
+    opts->output_fd = -1;
+    opts->pgid = -1;
+}
+
+/*  Runs in the child on child_stack, sharing pman's memory until exec.
+    Only async-signal-safe calls, the parent is suspended meanwhile.
+ */
+static int child_main(void *data) {
+    ChildLaunch *launch = data;
+    const LaunchOptions *opts = launch->opts;
+    sigset_t empty;
+
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, NULL);
+    // "0" moves the writer, so the job is in its cgroup before its program runs
+    if (write(launch->procs_fd, "0", 1) != 1
+        || (opts->pgid != -1 && setpgid(0, opts->pgid) == -1)
+        || (opts->cpus != NULL && sched_setaffinity(0, sizeof(cpu_set_t), opts->cpus) == -1)
+        || (opts->output_fd >= 0 && (dup2(opts->output_fd, STDOUT_FILENO) == -1
+                                     || dup2(opts->output_fd, STDERR_FILENO) == -1))) {
+        launch->err = errno;
+        _exit(127);
+    }
+    execve(launch->path, launch->argv, environ);
+    launch->err = errno;
+    _exit(127);
+}
+
+/*  Starts the child with clone(CLONE_VM | CLONE_VFORK) on a stack of its
+    own, like posix_spawn, so pman's address space is not copied. The
+    child joins the cgroup and sets up its cpu affinity, process group
+    and output before exec. clone3(CLONE_INTO_CGROUP) would create it
+    inside the cgroup, but cannot share memory without a stack switch in
+    assembly. An error in the child comes back through launch.err.
+    Returns 0 and sets *pid, or the errno value of the failure.
+ */
+static int clone_into_cgroup(const char *path, char *const argv[], const LaunchOptions *opts, pid_t *pid) {
+    ChildLaunch launch = {path, argv, opts, -1, 0};
+
+    countStat(COUNT_SYSCALLS, 3);
+    launch.procs_fd = openat(opts->cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    if (launch.procs_fd == -1) {
+        return errno;
+    }
+    pid_t child = clone(child_main, child_stack + CHILD_STACK_SIZE, CLONE_VM | CLONE_VFORK | SIGCHLD, &launch);
+    int err = (child == -1) ? errno : launch.err;
+    close(launch.procs_fd);
+
+    // CLONE_VFORK returned after exec or exit, so launch.err is settled
+    if (child != -1 && err != 0) {
+        waitpid(child, NULL, 0);
+    }
+    if (err == 0) {
+        *pid = child;
+    }
+    return err;
+}
+
+/*  Function to start path with argv as a child process.
+    glibc's posix_spawn uses clone(CLONE_VM | CLONE_VFORK), so the cost
+    does not grow with pman's page tables the way fork() does, and a
+    failed exec is reported here instead of in the child.
+    posix_spawn cannot put the child in a cgroup, with a cgroup in opts
+    it is started the same way by clone_into_cgroup instead. glibc's
+    posix_spawn cannot set affinity, so on that path the cpus are
+    applied to the child right after it is started. The process group
+    is set in the child on both paths, after exec it is too late.
+    Returns 0 and sets *pid, or the errno value of the failure.
+ */
+int launchProcess(const char *path, char *const argv[], const LaunchOptions *opts, pid_t *pid) {
+    if (opts == NULL) {
+        countStat(COUNT_SYSCALLS, 1);
+        return posix_spawn(pid, path, NULL, &spawn_attr, argv, environ);
+    }
+
+    if (opts->cgroup_fd >= 0) {
+        return clone_into_cgroup(path, argv, opts, pid);
+    }
+
+    // Output redirection is a file action, built only when needed
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_t *use_actions = NULL;
+    if (opts->output_fd >= 0) {
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, opts->output_fd, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, opts->output_fd, STDERR_FILENO);
+        use_actions = &actions;
+    }
+
+    // pman is single threaded, so the shared attributes can change per launch
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    if (opts->pgid != -1) {
+        posix_spawnattr_setpgroup(&spawn_attr, opts->pgid);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    posix_spawnattr_setflags(&spawn_attr, flags);
+
+    countStat(COUNT_SYSCALLS, 1);
+    int err = posix_spawn(pid, path, use_actions, &spawn_attr, argv, environ);
+    if (use_actions != NULL) {
+        posix_spawn_file_actions_destroy(use_actions);
+    }
+    if (err != 0) {
+        return err;
+    }
+    if (opts->cpus != NULL && sched_setaffinity(*pid, sizeof(cpu_set_t), opts->cpus) == -1) {
+        perror("setting the cpu affinity failed");
+    }
+    return 0;
+}
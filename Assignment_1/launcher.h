@@ -0,0 +1,23 @@
+#ifndef _LAUNCHER_H_
+#define _LAUNCHER_H_
+
+#include <sys/types.h>
+// Needs _GNU_SOURCE before the first include for cpu_set_t
+#include <sched.h>
+
+// How a job is started, anything left at its init value is not used
+typedef struct {
+    int cgroup_fd;      // cgroup v2 directory to start the job in, -1 for none
+    const cpu_set_t * cpus; // cpus the job may run on, NULL to inherit pman's
+    int output_fd;      // becomes the job's stdout and stderr, -1 to inherit pman's
+    pid_t pgid;         // process group to join, 0 to lead a new one, -1 to stay in pman's
+} LaunchOptions;
+
+
+int initLauncher(void);
+void initLaunchOptions(LaunchOptions *opts);
+int launchProcess(const char *path, char *const argv[], const LaunchOptions *opts, pid_t *pid);
+
+
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -8,29 +9,113 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <errno.h>
-#include "linked_list.h"
+#include "job_table.h"
 #include <ctype.h>
 #include <limits.h> 
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include "event_loop.h"
+#include "ptop.h"
+#include "launcher.h"
+#include "cmd_parser.h"
+#include "bg_options.h"
+#include "cgroup.h"
+#include "placement.h"
+#include "job_queue.h"
+#include "job_log.h"
+#include "control_server.h"
+#include "protocol.h"
+#include "stats.h"
+#include "exit_history.h"
+#include "proc_tree.h"
+#include "supervisor.h"
+#include "pgroup.h"
+#include "perf_counters.h"
+#include "priority.h"
+#include "job_state.h"
+#include "job_graph.h"
+#include "timer_wheel.h"
+#include <fcntl.h>
 
-Node* head = NULL;
+// Every tracked background job, keyed by pid
+JobTable jobs;
+
+// signalfd that becomes readable whenever a child stops or continues
+int sigchld_fd = -1;
+Watch sigchld_watch;
+
+// Command input (stdin or the -f file), regular files cannot be watched and are always ready
+int input_fd = STDIN_FILENO;
+Watch input_watch;
+bool input_always_ready = false;
+LineReader input_reader;
+ArgVector input_args;
+
+// Script/batch mode: no prompt, buffered output and a throughput report
+bool batch_mode = false;
+unsigned long commands_run = 0;
+struct timespec batch_start;
+
+// True while "Pman: > " is printed and waiting for the user
+bool prompt_active = false;
+
+// cpu placement for jobs started without --place, set with bgplace
+int default_placement = PLACE_NONE;
+
+// Commands waiting for bgqueue, started as queued jobs are reaped
+JobQueue job_queue;
+ArgVector queue_args;
+bool queue_busy = false;
+
+// bg --after jobs waiting for their prerequisites, started as those are reaped
+JobGraph job_graph;
+
+// Set at end of input while jobs are still queued, waiting or due to restart, pman quits once they have run
+bool quit_when_idle = false;
+
+// Jobs reaped so far with their exit status and resource usage, for bghistory
+ExitHistory finished_jobs;
+
+// Jobs are kept in this file so a restarted pman finds them again, only with --state path
+const char *state_path = NULL;
+
+// Job output is captured into <pid>.log files here, only with --logs dir
+const char *logs_dir = NULL;
+
+// pman --daemon: commands come from pmanctl over a UNIX socket instead of stdin
+bool daemon_mode = false;
+bool serving_client = false;
+bool quit_requested = false;
+
+void pump_queue();
+void pump_graph();
+void quit_when_done();
+void quit_pman();
 
 /************ Helper Functions *************/
 
-// Function to convert a relative path to an absolute path
+/*  Function to convert a relative path to an absolute path
+    pman never changes directory, so the cwd is looked up only once.
+ */
 char *makeFullPath(const char *cmd) {
     char *full_path = NULL;
-    char cwd[1024];
+    static char cwd[1024];
 
     // Already absolute path
     if (cmd[0] == '/') {
+        countStat(COUNT_ALLOCS, 1);
         return strdup(cmd);
     } 
     else {
-        if (getcwd(cwd, sizeof(cwd)) != NULL) {
+        if (cwd[0] != '\0' || getcwd(cwd, sizeof(cwd)) != NULL) {
             // Concatenate current working directory with the command
             // Adding 2 for the '/' and null terminator
             int len = strlen(cwd) + strlen(cmd) + 2;
             full_path = malloc(len);
+            countStat(COUNT_ALLOCS, 1);
 
             if (full_path == NULL) {
                 perror("malloc failed");
@@ -103,455 +188,2495 @@ int is_valid_pid(const char *str_pid) {
     return 1;
 }
 
+// Function to print the prompt unless it is already showing
+void show_prompt() {
+    // ptop and bglog -f own the screen until stopped, scripts and the daemon get no prompt
+    if (isPtopActive() || isFollowActive() || batch_mode || daemon_mode) {
+        fflush(stdout);
+        return;
+    }
+    if (!prompt_active) {
+        printf("Pman: > ");
+        prompt_active = true;
+    }
+    fflush(stdout);
+}
+
+// Move off the prompt line before reporting something asynchronously
+void leave_prompt() {
+    if (prompt_active) {
+        printf("\n");
+        prompt_active = false;
+    }
+}
+
+/*  Raises the soft open file limit to the hard limit.
+    Every job holds a pidfd, so thousands of jobs need thousands of fds.
+ */
+void raise_fd_limit() {
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Function to get a pidfd for pid, -1 on failure
+int open_pidfd(pid_t pid) {
+    countStat(COUNT_SYSCALLS, 1);
+    return (int) syscall(SYS_pidfd_open, pid, 0);
+}
+
+/*  Sends sig to a job through its pidfd.
+    Unlike kill() this can never hit an unrelated process that
+    was handed a recycled pid after the job exited.
+ */
+int signal_job(Job *job, int sig) {
+    countStat(COUNT_SYSCALLS, 1);
+    return (int) syscall(SYS_pidfd_send_signal, job->pidfd, sig, NULL, 0);
+}
+
+/*  Counts a reaped job of a bulk bgkill, the last one reports
+    how long it took until all of them were gone.
+ */
+void batch_reaped(KillBatch *batch) {
+    if (--batch->remaining > 0) {
+        return;
+    }
+    leave_prompt();
+    printf("All %d processes of %s were killed in %.1f ms\n", batch->total, batch->label,
+           (statClock() - batch->started_ns) / 1e6);
+    free(batch);
+}
+
+/*  Function to stop watching a job, close its pidfd and forget it
+    A job from bgqueue frees its slot, so the next command starts.
+ */
+void drop_job(Job *job) {
+    char from_queue = job->from_queue;
+    char from_graph = job->from_graph;
+
+    unwatchFd(&job->watch);
+    stopTimer(&job->timeout);
+    closeProcSampler(&job->sampler);
+    freeJobHistory(job);
+    freeProcTree(job->tree);
+    freeSupervisor(job->supervisor);
+    releaseJobGroup(job->group);
+    releaseProcessGroup(job->pgroup);
+    closePerfCounters(job->perf);
+    clearJobState(job->state_slot);
+    if (job->batch != NULL) {
+        batch_reaped(job->batch);
+    }
+    closeJobLog(job->log);
+    if (job->pidfd >= 0) {
+        close(job->pidfd);
+    }
+    // Dependents not released by reap_job (a reattached job) cannot know it succeeded
+    releaseDependents(&job_graph, job->dependents, 0);
+    removeJob(&jobs, job);
+
+    if (from_queue) {
+        job_queue.running--;
+        job_queue.finished++;
+        pump_queue();
+    }
+    if (from_graph) {
+        job_graph.running--;
+    }
+    if (job_graph.ready > 0) {
+        pump_graph();
+    }
+    quit_when_done();
+}
+
+// Function to keep how a reaped job ended and what it used for bghistory
+void record_exit(Job *job, int p_status, const struct rusage *usage) {
+    uint64_t runtime_ns = statClock() - job->started_ns;
+
+    recordExit(&finished_jobs, job->pid, job->path, p_status, usage, runtime_ns / 1000);
+}
+
+/*  Schedules a supervised job that just exited to be started again.
+    The supervisor moves from the job to the restart timer.
+ */
+void restart_later(Job *job, int p_status) {
+    Supervisor *sup = job->supervisor;
+
+    if (sup == NULL || !wantsRestart(sup, p_status)) {
+        return;
+    }
+    job->supervisor = NULL;
+    sup->last_pid = job->pid;
+
+    long delay = nextBackoff(sup, statClock() - job->started_ns);
+    if (delay == -1) {
+        printf("Process %d was restarted %d times in a row, giving up\n", job->pid, sup->restarts);
+        freeSupervisor(sup);
+        return;
+    }
+    printf("Process %d restarts in %.1f s (restart %d of %d)\n", job->pid, delay / 1000.0,
+           sup->restarts, sup->opts->max_restarts);
+    // Jobs waiting for it wait for the run that is not restarted
+    sup->dependents = job->dependents;
+    job->dependents = NULL;
+    scheduleRestart(sup, delay);
+}
+
 /* Function to monitor any changes made to the
    background processes.
    Example: Any process killed outside the pman
+   Runs when the pidfd of a job becomes readable, which the
+   kernel does exactly once, when that job exits.
  */
-void check_background_jobs() {
-    Node *current = head;
-    Node *prev = NULL;
-
-    // Traversing the linked list while checking every PID
-    while (current != NULL) {
-        int p_status;
-        pid_t result = waitpid(current->pid, &p_status, WNOHANG);
-        
-        // Child process is still running
-        if (result == 0) {
-            prev = current;
-            current = current->next;
-        }
-        // If an error occurs
-        else if (result == -1) {
-            perror("waitpid: An error is occured");
-            prev = current;
-            current = current->next;
+void reap_job(Watch *watch, uint32_t events) {
+    Job *job = watch->data;
+    uint64_t start = statClock();
+    struct rusage usage;
+    int p_status;
+
+    // A reattached job is not our child, only that it ended can be known
+    if (job->adopted) {
+        leave_prompt();
+        if (job->batch == NULL) {
+            printf("Process %d has ended\n", job->pid);
         }
-        else {
-            // Child process has terminated or exits
-            if (WIFSIGNALED(p_status)) {
-                printf("Process %d was killed\n", current->pid);
-            }
-            if (WIFEXITED(p_status)) {
-                printf("Process %d exits\n", current->pid);
-            }
-            
-            // Remove the node from the PID list
-            if (prev == NULL) {
-                head = current->next;
-                free(current->path);
-                free(current);
-                current = head;
-            }
-            else {
-                prev->next = current->next;
-                free(current->path);
-                free(current);
-                current = prev->next;
-            }
+        drop_job(job);
+        recordLatency(STAT_REAP, start);
+        return;
+    }
+
+    // The job is still our unreaped child so its pid cannot be reused yet
+    pid_t result = wait4(job->pid, &p_status, WNOHANG, &usage);
+    countStat(COUNT_SYSCALLS, 1);
+    if (result == 0) {
+        return;
+    }
+    if (result == -1) {
+        perror("waitpid: An error is occured");
+    }
+    else {
+        // Last output first, then the exit
+        closeJobLog(job->log);
+        job->log = NULL;
+        leave_prompt();
+
+        // Child process has terminated or exits, a bulk bgkill reports once for all
+        const char *why = job->timed_out ? " after its timeout" : "";
+        if (job->batch == NULL && WIFSIGNALED(p_status)) {
+            printf("Process %d was killed%s\n", job->pid, why);
+        }
+        if (job->batch == NULL && WIFEXITED(p_status)) {
+            printf("Process %d exits%s\n", job->pid, why);
         }
+        record_exit(job, p_status, &usage);
+        restart_later(job, p_status);
+
+        // Each waiting job's count drops by one, some may start now
+        releaseDependents(&job_graph, job->dependents, WIFEXITED(p_status) && WEXITSTATUS(p_status) == 0);
+        job->dependents = NULL;
     }
+
+    // Remove the job from the table
+    drop_job(job);
+    recordLatency(STAT_REAP, start);
 }
 
-// Function to get the state of the background processes
-char get_p_state(char * str_pid) {
-    char proc_stat_path[PATH_MAX];
-    char file_buffer[256];
-    FILE *file;
-    char state = ' ';
+/*  Handles SIGCHLD for stops and continues, exits come through
+    the pidfds. Changes that pman asked for itself (bgstop/bgstart)
+    are already reported by those commands.
+ */
+void check_background_jobs(Watch *watch, uint32_t events) {
+    struct signalfd_siginfo info;
+    uint64_t start = statClock();
+
+    // Drain the pending notifications, several changes may share one
+    do {
+        countStat(COUNT_SYSCALLS, 1);
+    } while (read(sigchld_fd, &info, sizeof(info)) == sizeof(info));
 
-    pid_t pid = atoi(str_pid);
+    while (true) {
+        siginfo_t child;
 
-    // Construct path for process information
-    snprintf(proc_stat_path, sizeof(proc_stat_path), "/proc/%d/stat", pid);
+        child.si_pid = 0;
+        countStat(COUNT_SYSCALLS, 1);
+        if (waitid(P_ALL, 0, &child, WSTOPPED | WCONTINUED | WNOHANG) == -1 || child.si_pid == 0) {
+            break;
+        }
 
-    // Read the stat file for state
-    file = fopen(proc_stat_path, "r");
-    if (file == NULL) {
-        perror("fopen failed");
-        return '0';
-    }
+        Job *job = findJob(&jobs, child.si_pid);
+        if (job == NULL) {
+            continue;
+        }
 
-    // Read contents of stat file
-    if (fgets(file_buffer, sizeof(file_buffer), file) == NULL) {
-        perror("fgets failed");
-        fclose(file);
-        return '0';
+        char state = (child.si_code == CLD_CONTINUED) ? 'R' : 'T';
+        if (job->requested_state != state) {
+            leave_prompt();
+            printf("Process %d %s\n", job->pid, state == 'T' ? "was stopped" : "was continued");
+        }
+        job->requested_state = ' ';
     }
-    fclose(file);
+    recordLatency(STAT_SIGCHLD, start);
+}
 
-    char *tokens[52];
-    int tokenIndex = 0;
+/*  Blocks SIGCHLD and watches a signalfd for it, so stops and
+    continues are delivered as events instead of being polled for.
+ */
+void setup_sigchld_fd() {
+    sigset_t mask;
 
-    char *token = strtok(file_buffer, " ");
-    while (token != NULL && tokenIndex < 52) {
-        tokens[tokenIndex++] = token;
-        token = strtok(NULL, " ");
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1) {
+        perror("sigprocmask failed");
+        exit(EXIT_FAILURE);
     }
 
-    if (tokenIndex > 2) {
-        state = tokens[2][0];
+    sigchld_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigchld_fd == -1) {
+        perror("signalfd failed");
+        exit(EXIT_FAILURE);
     }
+    if (watchFd(&sigchld_watch, sigchld_fd, EPOLLIN, check_background_jobs, NULL) == -1) {
+        perror("epoll_ctl failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*  Function to get the state of a background process
+    Returns '0' if it could not be read.
+ */
+char get_p_state(Job *job) {
+    ProcSample sample;
 
-    return state;
+    // Only stat is needed, read through the job's cached fd
+    if (sampleProc(&job->sampler, &sample, SAMPLE_STAT) == -1) {
+        perror("reading /proc stat failed");
+        return '0';
+    }
+    return sample.state;
 }
 
 /*****************************************/
 
-/*
-    Function to start a background process
-    Example as per main() func: bg foo
-    `foo` is just an placeholder for
-    any executable file.
+/*  Function to turn the executable of a bg command into an absolute path
+    Returns a malloc'd path, or NULL after printing an error.
  */
-void func_BG(char **cmd) {
-  	// Checks if nothing is passed as command or executable
-    if (cmd[1] == NULL) {
-        printf("Invalid input -> %s for executable\n",cmd[1]);
-        return;
-    }
+char *resolve_executable(const char *cmd) {
     char *full_path = NULL;
 
     // Check if the command is already an absolute path
-    if (cmd[1][0] == '/') {
-        full_path = strdup(cmd[1]);
+    if (cmd[0] == '/') {
+        full_path = strdup(cmd);
+        countStat(COUNT_ALLOCS, 1);
     } 
     else {
         // Check if the command starts with "./" which indicates a relative path from the current directory
-        if (strncmp(cmd[1], "./", 2) == 0) {
-            full_path = makeFullPath(cmd[1] + 2);
+        if (strncmp(cmd, "./", 2) == 0) {
+            full_path = makeFullPath(cmd + 2);
         }
         else {
             // If just the name from the same directory is passed or by traversing a dir
-            full_path = makeFullPath(cmd[1]);
+            full_path = makeFullPath(cmd);
         }
     }
 
     if (full_path == NULL) {
-        fprintf(stderr, "Error making full path for %s\n", cmd[1]);
+        fprintf(stderr, "Error making full path for %s\n", cmd);
+    }
+    return full_path;
+}
+
+// Function to get the placement policy a launch with opts uses
+int effective_placement(const BgOptions *opts) {
+    return (opts->place != -1) ? opts->place : default_placement;
+}
+
+/*  Runs when a job's bg --timeout passes, and again after --kill-after.
+    The first time sends SIGTERM (and SIGCONT, in case it was stopped),
+    the second SIGKILL. A job leading its own process group gets them
+    for the whole group, so a hung shell does not leave its children.
+ */
+void timeout_job(Timer *timer) {
+    Job *job = timer->data;
+    int sig = (job->timed_out == 0 && job->kill_after_ms > 0) ? SIGTERM : SIGKILL;
+
+    leave_prompt();
+    if (sig == SIGTERM) {
+        printf("Process %d timed out, sending SIGTERM, SIGKILL follows in %.1f s\n", job->pid,
+               job->kill_after_ms / 1000.0);
+        startTimer(&job->timeout, job->kill_after_ms);
+    }
+    else {
+        printf("Process %d timed out, sending SIGKILL\n", job->pid);
+    }
+    job->timed_out = (char) sig;
+
+    countStat(COUNT_SYSCALLS, 1);
+    if (job->pgroup == NULL && kill(-job->pgid, sig) == 0) {
+        if (sig == SIGTERM) {
+            kill(-job->pgid, SIGCONT);
+        }
         return;
     }
+    if (signal_job(job, sig) == 0 && sig == SIGTERM) {
+        signal_job(job, SIGCONT);
+    }
+}
+
+/*  Function to launch full_path with argv and track it as a job
+    opts puts it in a cgroup and picks its cpus. Without cgroup
+    support the job still runs, just unconfined.
+    Returns the new job, or NULL if it could not be started.
+ */
+Job *start_job(const char *full_path, char **argv, const BgOptions *opts) {
+    LaunchOptions launch;
+    JobGroup *group = NULL;
+    cpu_set_t placed;
+    pid_t pid;
+
+    initLaunchOptions(&launch);
+    if (wantsCgroup(opts)) {
+        group = getJobGroup(opts->group, opts->cpu_max_us, opts->mem_max);
+    }
+    if (group != NULL) {
+        launch.cgroup_fd = group->dir_fd;
+    }
+
+    // A placed job is pinned to one cpu, picked from --cpus if given
+    int cpu = pickCpu(effective_placement(opts), opts->has_cpus ? &opts->cpus : NULL);
+    if (cpu != -1) {
+        CPU_ZERO(&placed);
+        CPU_SET(cpu, &placed);
+        launch.cpus = &placed;
+    }
+    else if (opts->has_cpus) {
+        launch.cpus = &opts->cpus;
+    }
+
+    // Every job leads a process group of its own unless it joins a named one
+    ProcessGroup *pgroup = NULL;
+    launch.pgid = 0;
+    if (opts->pgroup != NULL) {
+        pgroup = getProcessGroup(opts->pgroup);
+        launch.pgid = processGroupToJoin(pgroup);
+    }
+
+    // Output goes to a pipe pman drains into <logs dir>/<pid>.log
+    JobLog *log = NULL;
+    if (opts->capture) {
+        log = createJobLog(&launch.output_fd);
+    }
 
-    // Check if the file exists and is executable
-    if (access(full_path, X_OK) != 0) {
-        if (errno == ENOENT) {
+    // The launcher reports a missing or non executable file itself
+    int err = launchProcess(full_path, argv, &launch, &pid);
+    if (log != NULL) {
+        close(launch.output_fd);
+        if (err == 0 && attachJobLog(log, pid) == -1) {
+            // The job keeps running, its output is lost
+            closeJobLog(log);
+            log = NULL;
+        }
+    }
+    if (err != 0) {
+        closeJobLog(log);
+        releaseJobGroup(group);
+        releaseProcessGroup(pgroup);
+        if (err == ENOENT) {
             fprintf(stderr, "Executable file %s not found\n", full_path);
-        
-        } 
-        else {
+        }
+        else if (err == EACCES || err == ENOEXEC) {
             fprintf(stderr, "Executable file %s is not executable\n", full_path);
         }
-        free(full_path);
-        return;
+        else {
+            fprintf(stderr, "posix_spawn failed: %s\n", strerror(err));
+        }
+        return NULL;
     }
 
-    // After validation, creating a child process
-    pid_t pid = fork();
-
-    // Fork operation failed
-    if (pid < 0) {
-        perror("fork failed");
-        free(full_path);
-        return;
-    } 
-    // Current process is child
-    else if (pid == 0) {
-        // Adding current directory to PATH just to be safe
-        char *path = ".";
-        setenv("PATH", path, 1);
-
-        execvp(full_path, cmd + 1);
-        // If execvp fails
-        perror("execvp failed");
-        exit(EXIT_FAILURE);
+    // Adding the process to the job table
+    Job *job = add_newJob(&jobs, pid, full_path);
+    job->group = group;
+    job->log = log;
+    if (pgroup != NULL) {
+        joinProcessGroup(pgroup, pid);
+        job->pgroup = pgroup;
+        job->pgid = pgroup->pgid;
     }
-    // Current process is parent
-    else {
-        // Adding the process to the list of PID
-        head = add_newNode(head, pid, full_path);
-        printf("Process with PID %d started in background\n", pid);
+    if (opts->tags != NULL) {
+        job->tags = strdup(opts->tags);
+        countStat(COUNT_ALLOCS, 1);
+    }
+    // The start time tells this job apart from a later process with the same pid
+    ProcSample sample;
+    if (sampleProc(&job->sampler, &sample, SAMPLE_STAT) == 0) {
+        job->state_slot = saveJobState(pid, sample.starttime, job->pgid, full_path, opts->pgroup, opts->tags);
+    }
+    // posix_spawn cannot set nice or io priority, so all three are set right after exec
+    if (hasPriority(&opts->priority)) {
+        applyPriority(pid, &opts->priority);
+    }
+    // Every run of a supervised job gets the whole timeout again
+    if (opts->timeout_ms > 0) {
+        initTimer(&job->timeout, timeout_job, job);
+        job->kill_after_ms = opts->kill_after_ms;
+        startTimer(&job->timeout, opts->timeout_ms);
+    }
+    // Counting starts after exec, children it starts are included
+    if (opts->perf && (job->perf = attachPerfCounters(pid)) == NULL) {
+        perror("perf_event_open failed");
     }
 
-    free(full_path);
+    // The pidfd becomes readable when the job exits
+    job->pidfd = open_pidfd(pid);
+    if (job->pidfd == -1 || watchFd(&job->watch, job->pidfd, EPOLLIN, reap_job, job) == -1) {
+        perror("pidfd_open failed");
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        drop_job(job);
+        return NULL;
+    }
+    return job;
 }
 
-/*
-    Function to list all the background processes
-    Example as per main() func: bglist
+/*  Runs when pman starts for every job the state file remembers.
+    The pidfd is opened before the start time is compared, so the
+    process checked is the one watched even if the pid is reused
+    in between. Returns 0 if the job was reattached, -1 if it is gone.
  */
-void func_BGlist(char **cmd) {
-	// Check the background process first in case killed outside terminal
-    check_background_jobs();
+int reattach_job(const StateRecord *record, int slot) {
+    ProcSampler sampler;
+    ProcSample sample;
 
-    Node *current = head;
-    
-    // Check if the user input is right
-    if (cmd[1] != NULL) {
-        printf("bglist takes no arguments\n");
-        return;
+    int pidfd = open_pidfd(record->pid);
+    if (pidfd == -1) {
+        return -1;
     }
-
-    int count = 0;
-
-    // In case no background jobs
-    if (current == NULL) {
-        printf("No background jobs\n");
-        return;
+    initProcSampler(&sampler, record->pid);
+    if (sampleProc(&sampler, &sample, SAMPLE_STAT) == -1 || sample.starttime != record->starttime) {
+        closeProcSampler(&sampler);
+        close(pidfd);
+        return -1;
     }
 
-    // Printing the jobs as well tracking the count
-    while (current != NULL) {
-        printf("%d: %s\n", current->pid, current->path);
-        count++;
-        current = current->next;
+    Job *job = add_newJob(&jobs, record->pid, record->path);
+    job->sampler = sampler;
+    job->pidfd = pidfd;
+    job->adopted = 1;
+    job->state_slot = slot;
+    job->pgid = record->pgid;
+    if (record->pgroup[0] != '\0') {
+        job->pgroup = getProcessGroup(record->pgroup);
+        joinProcessGroup(job->pgroup, record->pid);
+        // The leader may be gone, its pgid lives on while a member does
+        job->pgroup->pgid = record->pgid;
     }
-    printf("Total background jobs: %d\n", count);
+    // starttime is on the boot clock, which counts suspend and statClock() does not
+    struct timespec boot;
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    uint64_t boot_ns = (uint64_t) boot.tv_sec * 1000000000ull + boot.tv_nsec;
+    uint64_t start_ns = sample.starttime * (1000000000ull / sysconf(_SC_CLK_TCK));
+    uint64_t age_ns = (boot_ns > start_ns) ? boot_ns - start_ns : 0;
+    uint64_t now_ns = statClock();
+    job->started_ns = (age_ns < now_ns) ? now_ns - age_ns : 0;
+    if (record->tags[0] != '\0') {
+        job->tags = strdup(record->tags);
+        countStat(COUNT_ALLOCS, 1);
+    }
+    if (watchFd(&job->watch, pidfd, EPOLLIN, reap_job, job) == -1) {
+        perror("epoll_ctl failed");
+        job->state_slot = -1;
+        drop_job(job);
+        return -1;
+    }
+    return 0;
 }
 
-/*
-    Function to kill a background process
-    Example as per main() func: bgkill {pid}
-    where `pid` is the process ID for process
-    to be killed.
+/*  Function to open the state file and reattach to the jobs in it
+    that are still running, then say how many were found.
  */
-void func_BGkill(char * str_pid) {
-	// Check first if the PID is valid
-    if (is_valid_pid(str_pid)) {
-        // Converting the PID to pid_t
-        pid_t pid_for_p_kill = (pid_t) strtol(str_pid, NULL, 10);
+void reattach_jobs(const char *path) {
+    uint64_t start = statClock();
 
-        // Kill the process
-        if (kill(pid_for_p_kill, SIGKILL) != 0) {
-            perror("kill the process is failed");
+    if (openJobState(path, reattach_job) == -1 || jobs.count == 0) {
+        return;
+    }
+    printf("Reattached %zu jobs from %s in %.1f ms\n", jobs.count, path, (statClock() - start) / 1e6);
+}
+
+/*  Runs when a restart is due. A job that cannot even be started
+    counts as another failed run and waits for the next restart.
+ */
+void restart_job(Supervisor *sup) {
+    leave_prompt();
+    Job *job = start_job(sup->path, sup->argv, sup->opts);
+    if (job == NULL) {
+        long delay = nextBackoff(sup, 0);
+        if (delay == -1) {
+            printf("Giving up on %s after %d restarts\n", sup->path, sup->restarts);
+            releaseDependents(&job_graph, sup->dependents, 0);
+            freeSupervisor(sup);
+            pump_graph();
             return;
         }
+        scheduleRestart(sup, delay);
+        return;
+    }
+    job->supervisor = sup;
+    job->dependents = sup->dependents;
+    sup->dependents = NULL;
+    printf("Process %d restarted as %d (restart %d of %d)\n", sup->last_pid, job->pid,
+           sup->restarts, sup->opts->max_restarts);
+}
 
-        // Wait for the process to terminate
-        int p_status;
-        pid_t result = waitpid(pid_for_p_kill, &p_status, 0);
+/*  Returns true once no command is queued, no bg --after job is
+    waiting or running and no restart is due, so a script's jobs have
+    all had their turn.
+ */
+bool nothing_pending() {
+    return queueIdle(&job_queue) && job_graph.waiting + job_graph.ready + job_graph.running == 0
+           && pendingRestarts() == 0;
+}
 
-        if (result == -1) {
-            perror("waitpid: An error is occured");
-        } else {
-            printf("Process with PID %d has been killed\n", pid_for_p_kill);
-            head = deleteNode(head, pid_for_p_kill);
-        }
-    } else {
-        printf("PID %s is not valid\n", str_pid);
+// Function to quit after end of input once nothing is pending any more
+void quit_when_done() {
+    if (quit_when_idle && nothing_pending()) {
+        quit_pman();
     }
-
 }
 
-/*
-    Function to stop a background process
-    Example as per main() func: bgstop {pid}
-    where `pid` is the process ID for process
-    to be stopped.
+/*  Function to start queued commands while the queue has free slots
+    Runs after bgqueue and whenever a queued job is reaped. Prints a
+    summary once the queue has drained.
  */
-void func_BGstop(char * str_pid) {
-	// Check first if the PID is valid
-    if (is_valid_pid(str_pid)) {
-        pid_t pid_for_p_stop = (pid_t) strtol(str_pid, NULL, 10);
+void pump_queue() {
+    QueuedCommand *command;
+    BgOptions opts;
 
-        // Check if the process exists and in the list
-        if(get_p_state(str_pid) != 'T') {
-            if(PifExist(head, pid_for_p_stop)) {
-                kill(pid_for_p_stop, SIGSTOP);
-                printf("PID %s has been stopped \n", str_pid);
+    initBgOptions(&opts);
+    opts.capture = job_queue.capture;
+    while (job_queue.running < (size_t) job_queue.limit && (command = popCommand(&job_queue)) != NULL) {
+        Job *job = NULL;
+
+        // Split into its own vector, this can run in the middle of another command
+        if (splitArgs(command->line, &queue_args) > 0) {
+            char *full_path = resolve_executable(queue_args.argv[0]);
+            if (full_path != NULL) {
+                job = start_job(full_path, queue_args.argv, &opts);
+                free(full_path);
             }
         }
+
+        if (job != NULL) {
+            job->from_queue = 1;
+            job_queue.running++;
+        }
         else {
-            printf("PID %s is already in stopped state \n", str_pid);
+            job_queue.failed++;
+            job_queue.finished++;
         }
+        free(command);
     }
-    else {
-        printf("PID %s is not valid\n", str_pid);
+
+    if (queue_busy && queueIdle(&job_queue)) {
+        struct timespec end;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - job_queue.start.tv_sec) + (end.tv_nsec - job_queue.start.tv_nsec) / 1e9;
+        leave_prompt();
+        printf("Queue done: %lu commands (%lu failed) in %.3f s (%.0f commands/s)\n",
+               job_queue.finished, job_queue.failed, elapsed,
+               elapsed > 0 ? job_queue.finished / elapsed : 0.0);
+        queue_busy = false;
+        quit_when_done();
     }
 }
 
-/*
-    Function to start a background process
-    Example as per main() func: bgstart {pid}
-    where `pid` is the process ID for process
-    to be started.
+/*  Function to start bg --after jobs whose prerequisites have all ended
+    while the graph has free slots. A job whose --after-ok prerequisite
+    failed is cancelled instead, and counts as failed for the jobs
+    waiting on it in turn.
  */
-void func_BGstart(char * str_pid) {
-	// Check first if the PID is valid
-    if (is_valid_pid(str_pid)) {
-        pid_t pid_for_p_start = (pid_t) strtol(str_pid, NULL, 10);
+void pump_graph() {
+    GraphNode *node;
 
-        // Check if the process exists and in the list
-        if(get_p_state(str_pid) == 'T') {
-            if(PifExist(head, pid_for_p_start)) {
-                kill(pid_for_p_start, SIGCONT);
-                printf("PID %s has been started from stopped state \n", str_pid);
-            }
+    while ((node = nextReady(&job_graph)) != NULL) {
+        Supervisor *launch = node->launch;
+        Job *job = NULL;
+
+        leave_prompt();
+        if (node->failed) {
+            printf("Job #%d (%s) cancelled, a prerequisite did not exit with 0\n", node->id, launch->path);
+            job_graph.cancelled++;
         }
-        else {
-            printf("PID %s was not in stopped state \n", str_pid);
+        else if ((job = start_job(launch->path, launch->argv, launch->opts)) != NULL) {
+            printf("Process with PID %d started in background as job #%d\n", job->pid, node->id);
+            job->from_graph = 1;
+            job_graph.running++;
+            job_graph.started++;
+            job->dependents = node->dependents;
+            node->dependents = NULL;
+            if (launch->opts->restart != RESTART_NO) {
+                job->supervisor = launch;
+                launch = NULL;
+            }
         }
+
+        // Only left when the node never ran
+        releaseDependents(&job_graph, node->dependents, 0);
+        freeSupervisor(launch);
+        freeGraphNode(node);
     }
-    else {
-        printf("PID %s is not valid\n", str_pid);
-    }
+    quit_when_done();
 }
 
-/*
-    Function to print stats for a background process
-    Example as per main() func: pstat {pid}
-    where `pid` is the process ID for process.
+/*  Function to add the prerequisites in list (pids and tags, comma
+    separated) to node, only checking that they exist if node is NULL.
+    A tag names every running job and every waiting job that has it.
+    Returns the number found, -1 after printing a name nothing has.
  */
-void func_pstat(char * str_pid) {
-	// Check first if the PID is valid
-    if (is_valid_pid(str_pid)) {
-        FILE *file;
-        char proc_stat_path[4096];
-        char proc_status_path[4096];
-        char file_buffer[512];
-        char comm[512];
-        char state;
-        long rss;
-        unsigned long utime_clock_ticks, stime_clock_ticks;
-        unsigned long voluntary_ctxt_switches, nonvoluntary_ctxt_switches;
+int add_prerequisites(const char *list, GraphNode *node, int ok) {
+    char names[256];
+    char *save = NULL;
+    int found = 0;
 
-        long clock_ticks_per_second = sysconf(_SC_CLK_TCK);
-        pid_t pid = atoi(str_pid);
+    if (list == NULL) {
+        return 0;
+    }
+    snprintf(names, sizeof(names), "%s", list);
+    for (char *name = strtok_r(names, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        int matches = 0;
 
-        if(PifExist(head, pid) == 0) {
-            printf("Process is not in the list\n");
-            return;
+        if (strspn(name, "0123456789") == strlen(name)) {
+            Job *job = findJob(&jobs, (pid_t) strtol(name, NULL, 10));
+            if (job == NULL) {
+                printf("Process %s is not in the list\n", name);
+                return -1;
+            }
+            if (node != NULL) {
+                addDependent(&job->dependents, node, ok);
+            }
+            found++;
+            continue;
         }
 
-        // Construct paths for extract process stats
-        snprintf(proc_stat_path, sizeof(proc_stat_path), "/proc/%d/stat", pid);
-        snprintf(proc_status_path, sizeof(proc_status_path), "/proc/%d/status", pid);
-
-        // Read the stat file for comm, state, utime, stime and rss
-        file = fopen(proc_stat_path, "r");
-        if (file == NULL) {
-            perror("fopen failed");
-            return;
+        for (Job *job = jobs.first; job != NULL; job = job->next) {
+            if (hasTag(job->tags, name)) {
+                if (node != NULL) {
+                    addDependent(&job->dependents, node, ok);
+                }
+                matches++;
+            }
+        }
+        GraphNode *lists[] = {job_graph.first, job_graph.ready_first};
+        for (int l = 0; l < 2; l++) {
+            for (GraphNode *other = lists[l]; other != NULL; other = other->next) {
+                // The new node is already listed, it must not wait for itself
+                if (other != node && hasTag(other->launch->opts->tags, name)) {
+                    if (node != NULL) {
+                        addDependent(&other->dependents, node, ok);
+                    }
+                    matches++;
+                }
+            }
+        }
+        if (matches == 0) {
+            printf("No background jobs with tag %s\n", name);
+            return -1;
+        }
+        found += matches;
+    }
+    return found;
+}
+
+/*  Function to add full_path with argv as a job that is started once
+    everything in opts->after and opts->after_ok has ended. The names
+    are all checked before anything is added.
+    Returns the new node, NULL after printing what was wrong.
+ */
+GraphNode * submit_after(const char *full_path, char **argv, const BgOptions *opts) {
+    if (add_prerequisites(opts->after, NULL, 0) == -1 || add_prerequisites(opts->after_ok, NULL, 1) == -1) {
+        return NULL;
+    }
+    GraphNode *node = newGraphNode(&job_graph, newSupervisor(full_path, argv, opts));
+    add_prerequisites(opts->after, node, 0);
+    add_prerequisites(opts->after_ok, node, 1);
+    return node;
+}
+
+/*
+    Function to start a background process
+    Example as per main() func: bg foo
+    `foo` is just an placeholder for
+    any executable file.
+    Options before it put the job in a cgroup or pick its cpus:
+    bg --group=build --cpu-max=1.5 --mem-max=512M foo
+    bg --cpus=0-3 --place=least foo
+ */
+void func_BG(char **cmd) {
+    BgOptions opts;
+
+    initBgOptions(&opts);
+    int exe = parseBgOptions(cmd, &opts);
+    if (exe == -1) {
+        return;
+    }
+
+  	// Checks if nothing is passed as command or executable
+    if (cmd[exe] == NULL) {
+        printf("Invalid input -> %s for executable\n",cmd[exe]);
+        return;
+    }
+
+    char *full_path = resolve_executable(cmd[exe]);
+    if (full_path == NULL) {
+        return;
+    }
+
+    // Started later by pump_graph, once its prerequisites are reaped
+    if (opts.after != NULL || opts.after_ok != NULL) {
+        GraphNode *node = submit_after(full_path, cmd + exe, &opts);
+        if (node != NULL) {
+            printf("Job #%d waits for %d processes\n", node->id, node->waiting);
+        }
+        free(full_path);
+        return;
+    }
+
+    if (effective_placement(&opts) == PLACE_LEAST) {
+        refreshCpuLoad(&jobs);
+    }
+    Job *job = start_job(full_path, cmd + exe, &opts);
+    if (job != NULL && opts.restart != RESTART_NO) {
+        job->supervisor = newSupervisor(full_path, cmd + exe, &opts);
+    }
+    if (job != NULL && job->group != NULL) {
+        printf("Process with PID %d started in background in cgroup %s\n", job->pid, job->group->name);
+    }
+    else if (job != NULL) {
+        printf("Process with PID %d started in background\n", job->pid);
+    }
+    free(full_path);
+}
+
+/*
+    Function to start many copies of a background process
+    Example as per main() func: bgmany 100 foo
+    The path is resolved once and the copies are spawned
+    back to back, then the launch rate is reported.
+    Takes the same options as bg after the count.
+ */
+void func_BGmany(char **cmd) {
+    BgOptions opts;
+
+    if (cmd[1] == NULL || cmd[2] == NULL) {
+        printf("Usage: bgmany {count} [options] {executable} [args]\n");
+        return;
+    }
+
+    // The count takes the place of "bg" for the option parser
+    initBgOptions(&opts);
+    int exe = parseBgOptions(cmd + 1, &opts);
+    if (exe == -1) {
+        return;
+    }
+    exe++;
+    if (cmd[exe] == NULL) {
+        printf("Usage: bgmany {count} [options] {executable} [args]\n");
+        return;
+    }
+
+    char *endptr;
+    long count = strtol(cmd[1], &endptr, 10);
+    if (*endptr != '\0' || count <= 0 || count > INT_MAX) {
+        printf("Count %s is not valid\n", cmd[1]);
+        return;
+    }
+
+    char *full_path = resolve_executable(cmd[exe]);
+    if (full_path == NULL) {
+        return;
+    }
+
+    // Every copy waits on its own, they run side by side up to the graph's limit
+    if (opts.after != NULL || opts.after_ok != NULL) {
+        GraphNode *first = NULL;
+        GraphNode *node = NULL;
+
+        for (long i = 0; i < count && (node = submit_after(full_path, cmd + exe, &opts)) != NULL; i++) {
+            first = first ? first : node;
+        }
+        if (first != NULL) {
+            printf("Jobs #%d to #%d wait for %d processes each\n", first->id, first->id + (int) count - 1,
+                   first->waiting);
+        }
+        free(full_path);
+        return;
+    }
+
+    struct timespec start, end;
+    long started = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // Load is read once, every placed copy then counts towards its cpu
+    if (effective_placement(&opts) == PLACE_LEAST) {
+        refreshCpuLoad(&jobs);
+    }
+    Job *job;
+    while (started < count && (job = start_job(full_path, cmd + exe, &opts)) != NULL) {
+        if (opts.restart != RESTART_NO) {
+            job->supervisor = newSupervisor(full_path, cmd + exe, &opts);
+        }
+        started++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Started %ld of %ld processes in background in %.3f s (%.0f spawns/s)\n",
+           started, count, elapsed, elapsed > 0 ? started / elapsed : 0.0);
+    free(full_path);
+}
+
+/*
+    Function to queue commands that run at most P at a time
+    Example as per main() func: bgqueue -j 4 foo arg
+                                bgqueue -j 4 -f commands.txt
+    -j alone changes the limit, no arguments prints the queue.
+ */
+void func_BGqueue(char **cmd) {
+    const char *file = NULL;
+    size_t added = 0;
+    int i = 1;
+
+    // Options come first, everything after them is the command
+    for (; cmd[i] != NULL && cmd[i][0] == '-'; i++) {
+        if (strcmp(cmd[i], "-j") == 0 && cmd[i + 1] != NULL) {
+            int limit = atoi(cmd[++i]);
+            if (limit <= 0) {
+                printf("bgqueue: -j needs a positive number\n");
+                return;
+            }
+            job_queue.limit = limit;
+        }
+        else if (strcmp(cmd[i], "-f") == 0 && cmd[i + 1] != NULL) {
+            file = cmd[++i];
+        }
+        else if (strcmp(cmd[i], "--log=on") == 0 || strcmp(cmd[i], "--log=off") == 0) {
+            job_queue.capture = (strcmp(cmd[i], "--log=on") == 0);
+        }
+        else {
+            printf("Usage: bgqueue [-j jobs] [--log=on|off] {executable} [args] | bgqueue [-j jobs] [--log=on|off] -f {file}\n");
+            return;
+        }
+    }
+
+    if (file != NULL) {
+        int fd = open(file, O_RDONLY | O_CLOEXEC);
+        LineReader reader;
+        char *line;
+
+        if (fd == -1) {
+            perror(file);
+            return;
+        }
+        // One command per line, blank lines are skipped
+        initLineReader(&reader);
+        while (!reader.eof && fillLineReader(&reader, fd) != -1) {
+            while ((line = nextLine(&reader)) != NULL) {
+                if (line[strspn(line, " \t\r")] != '\0') {
+                    pushCommand(&job_queue, line);
+                    added++;
+                }
+            }
+        }
+        free(reader.buf);
+        close(fd);
+    }
+    else if (cmd[i] != NULL) {
+        // The arguments still lie in the input line, join them back up
+        for (int j = i; cmd[j + 1] != NULL; j++) {
+            cmd[j][strlen(cmd[j])] = ' ';
+        }
+        pushCommand(&job_queue, cmd[i]);
+        added++;
+    }
+    else if (i == 1) {
+        printf("Queue: %zu queued, %zu running, %lu finished, limit %d\n",
+               job_queue.queued, job_queue.running, job_queue.finished, job_queue.limit);
+        return;
+    }
+
+    if (added > 0) {
+        queue_busy = true;
+        printf("Queued %zu commands (limit %d)\n", added, job_queue.limit);
+    }
+    pump_queue();
+}
+
+/*  Walks a job's process tree, reusing what the last walk found.
+    Returns the number of processes, -1 if the job is gone.
+ */
+int walk_job_tree(Job *job) {
+    if (job->tree == NULL) {
+        job->tree = newProcTree();
+    }
+    return walkProcTree(job->tree, job->pid, job->group ? job->group->dir_fd : -1);
+}
+
+// Function to print the totals and one row per process of a job's tree
+void print_job_tree(Job *job) {
+    long clock_ticks_per_second = sysconf(_SC_CLK_TCK);
+    ProcTree *tree = job->tree;
+
+    printf("     %-30s: %zu processes, cpu %.2f s (user %.2f s, system %.2f s), rss %ld pages\n",
+           "tree", tree->count, (double) (tree->utime + tree->stime) / clock_ticks_per_second,
+           (double) tree->utime / clock_ticks_per_second, (double) tree->stime / clock_ticks_per_second,
+           tree->rss);
+    printf("     %-30s: %s, %.2f ms\n", "tree walk", treeSourceName(tree->source), tree->walk_us / 1e3);
+
+    printf("     %8s %8s %5s %10s %10s %10s  %s\n", "PID", "PPID", "STATE", "UTIME(s)", "STIME(s)", "RSS(pg)", "COMM");
+    for (size_t i = 0; i < tree->count; i++) {
+        ProcSample *sample = &tree->nodes[i].sample;
+
+        printf("     %8d %8d %5c %10.2f %10.2f %10ld  %s\n", tree->nodes[i].pid, sample->ppid,
+               sample->state, (double) sample->utime / clock_ticks_per_second,
+               (double) sample->stime / clock_ticks_per_second, sample->rss, sample->comm);
+    }
+}
+
+/*  Function to read the io counters of a job and its rates since the
+    job's previous reading, which this one then replaces.
+    Returns 1 with *rates set, 0 for the first reading of the job,
+    -1 if /proc/<pid>/io could not be read.
+ */
+int sample_job_io(Job *job, IoCounters *io, IoRates *rates) {
+    ProcSample sample;
+
+    if (sampleProc(&job->sampler, &sample, SAMPLE_IO) == -1) {
+        return -1;
+    }
+    uint64_t now = statClock();
+    int has_rates = job->last_io_ns != 0;
+    if (has_rates) {
+        ioRates(&job->last_io, &sample.io, (now - job->last_io_ns) / 1e9, rates);
+    }
+    job->last_io = sample.io;
+    job->last_io_ns = now;
+    *io = sample.io;
+    return has_rates;
+}
+
+/*  Function to print the perf counters of a job and its children.
+    The first call only attaches them, counting starts from there.
+ */
+void print_job_perf(Job *job) {
+    PerfReading reading;
+
+    if (job->perf == NULL) {
+        job->perf = attachPerfCounters(job->pid);
+        if (job->perf == NULL) {
+            perror("perf_event_open failed");
+            return;
+        }
+        printf("Counting process %d and the children it starts from now on, ask again for the numbers\n", job->pid);
+        return;
+    }
+    if (readPerfCounters(job->perf, &reading) == -1) {
+        perror("reading the perf counters failed");
+        return;
+    }
+
+    double seconds = (statClock() - job->perf->attached_ns) / 1e9;
+    printf("     %-30s: %.2f s%s\n", "counted for", seconds,
+           perfKernelExcluded() ? ", user space only (perf_event_paranoid)" : "");
+    printf("     %-30s: %.2f ms (%.1f%% of a cpu)\n", perfEventName(PERF_TASK_CLOCK),
+           reading.values[PERF_TASK_CLOCK] / 1e6, reading.values[PERF_TASK_CLOCK] / 1e7 / seconds);
+    for (int event = PERF_PAGE_FAULTS; event < PERF_EVENT_COUNT; event++) {
+        if (!hasPerfEvent(job->perf, event)) {
+            printf("     %-30s: not available\n", perfEventName(event));
+            continue;
+        }
+        printf("     %-30s: %llu (%.1f/s)\n", perfEventName(event),
+               (unsigned long long) reading.values[event], reading.values[event] / seconds);
+    }
+    if (hasPerfEvent(job->perf, PERF_CYCLES) && hasPerfEvent(job->perf, PERF_INSTRUCTIONS)
+        && reading.values[PERF_CYCLES] > 0) {
+        printf("     %-30s: %.2f\n", "instructions per cycle",
+               (double) reading.values[PERF_INSTRUCTIONS] / reading.values[PERF_CYCLES]);
+    }
+    if (reading.running_ns < reading.enabled_ns) {
+        printf("     %-30s: %.1f%% of the time, scaled up\n", "counters were running",
+               reading.enabled_ns ? 100.0 * reading.running_ns / reading.enabled_ns : 0.0);
+    }
+}
+
+// Function to print the bglist row of a job: pid, path and whatever else applies to it
+void print_job_row(Job *job) {
+    printf("%d: %s", job->pid, job->path);
+    if (job->group != NULL) {
+        printf(" [%s]", job->group->name);
+    }
+    if (job->pgroup != NULL) {
+        printf(" pgroup=%s", job->pgroup->name);
+    }
+    if (job->tags != NULL) {
+        printf(" tags=%s", job->tags);
+    }
+    if (job->supervisor != NULL) {
+        printf(" (restarted %lu times)", job->supervisor->total);
+    }
+    if (job->adopted) {
+        printf(" (reattached)");
+    }
+    if (timerPending(&job->timeout)) {
+        printf(" (%s in %.1f s)", job->timed_out ? "SIGKILL" : "timeout",
+               timerRemaining(&job->timeout) / 1000.0);
+    }
+    printf("\n");
+}
+
+/*
+    Function to list all the background processes
+    Example as per main() func: bglist
+ */
+void func_BGlist(char **cmd) {
+    long clock_ticks_per_second = sysconf(_SC_CLK_TCK);
+
+    // Check if the user input is right
+    bool tree = cmd[1] != NULL && strcmp(cmd[1], "--tree") == 0;
+    bool io = cmd[1] != NULL && strcmp(cmd[1], "--io") == 0;
+    if (cmd[1] != NULL && ((!tree && !io) || cmd[2] != NULL)) {
+        printf("Usage: bglist [--tree | --io]\n");
+        return;
+    }
+
+    // In case no background jobs
+    if (jobs.count == 0 && pendingRestarts() == 0) {
+        printf("No background jobs\n");
+    }
+    else if (jobs.count == 0) {
+        printf("No background jobs running\n");
+    }
+    else if (tree) {
+        // Each job with the totals of its whole process tree
+        for (Job *job = jobs.first; job != NULL; job = job->next) {
+            printf("%d: %s", job->pid, job->path);
+            if (job->group != NULL) {
+                printf(" [%s]", job->group->name);
+            }
+            if (walk_job_tree(job) > 0) {
+                printf(" - %zu processes, cpu %.2f s, rss %ld pages", job->tree->count,
+                       (double) (job->tree->utime + job->tree->stime) / clock_ticks_per_second,
+                       job->tree->rss);
+            }
+            printf("\n");
+        }
+        printf("Total background jobs: %zu\n", jobs.count);
+    }
+    else if (io) {
+        // Each job with its storage io, as rates once it was read before
+        for (Job *job = jobs.first; job != NULL; job = job->next) {
+            IoCounters counters;
+            IoRates rates;
+
+            printf("%d: %s", job->pid, job->path);
+            int has_rates = sample_job_io(job, &counters, &rates);
+            if (has_rates == 1) {
+                printf(" - read %.1f kB/s, write %.1f kB/s, %.1f syscalls/s", rates.read_bytes / 1024,
+                       rates.write_bytes / 1024, rates.syscalls);
+            }
+            else if (has_rates == 0) {
+                printf(" - read %llu kB, write %llu kB, %llu syscalls", counters.read_bytes / 1024,
+                       counters.write_bytes / 1024, counters.syscr + counters.syscw);
+            }
+            printf("\n");
+        }
+        printf("Total background jobs: %zu\n", jobs.count);
+    }
+    else {
+        // Printing the jobs in the order they were started, the table already tracks the count
+        for (Job *job = jobs.first; job != NULL; job = job->next) {
+            print_job_row(job);
+        }
+        printf("Total background jobs: %zu\n", jobs.count);
+    }
+
+    // Supervised jobs that exited and wait for their restart
+    if (pendingRestarts() > 0) {
+        printPendingRestarts();
+        printf("Waiting to restart: %zu\n", pendingRestarts());
+    }
+
+    if (job_graph.waiting + job_graph.ready > 0) {
+        printf("Waiting for prerequisites: %zu (bgdeps lists them)\n", job_graph.waiting + job_graph.ready);
+    }
+
+    if (queue_busy || job_queue.finished > 0) {
+        printf("Queue: %zu queued, %zu running, %lu finished (%lu failed), limit %d\n",
+               job_queue.queued, job_queue.running, job_queue.finished, job_queue.failed, job_queue.limit);
+    }
+
+    // Totals of every cgroup, covering the jobs' own children too
+    for (JobGroup *group = firstJobGroup(); group != NULL; group = group->next) {
+        GroupStats stats;
+
+        if (readGroupStats(group, &stats) == -1) {
+            continue;
+        }
+        printf("Group %s (%d jobs): cpu %.2f s (user %.2f s, system %.2f s)",
+               group->name, group->members, stats.usage_usec / 1e6,
+               stats.user_usec / 1e6, stats.system_usec / 1e6);
+        if (stats.memory_current != -1) {
+            printf(", mem %lld kB", stats.memory_current / 1024);
+        }
+        if (stats.io_rbytes != -1) {
+            printf(", io read %lld kB write %lld kB", stats.io_rbytes / 1024, stats.io_wbytes / 1024);
+        }
+        printf("\n");
+    }
+}
+
+// Returns true if a bgkill, bgstop or bgstart names jobs by -g or --tag
+bool is_selection(char **cmd) {
+    return cmd[1] != NULL && (strcmp(cmd[1], "-g") == 0 || strcmp(cmd[1], "--tag") == 0);
+}
+
+// Returns true if job belongs to process group pgid, or has tag when pgid is 0
+bool job_selected(Job *job, pid_t pgid, const char *tag) {
+    return (pgid != 0) ? job->pgid == pgid : hasTag(job->tags, tag);
+}
+
+/*  Function to work out which jobs -g {pgroup|pgid} or --tag {tag} names.
+    Sets *pgid to the process group to signal as a whole, or to 0 with
+    *tag set when the jobs are matched by tag. label describes them.
+    Returns the number of jobs, 0 after printing that there are none.
+ */
+int select_jobs(char **cmd, pid_t *pgid, const char **tag, char *label, size_t size) {
+    int count = 0;
+
+    *pgid = 0;
+    *tag = NULL;
+    if (cmd[2] == NULL) {
+        printf("Usage: %s {pid} | -g {pgroup|pgid} | --tag {tag}\n", cmd[0]);
+        return 0;
+    }
+
+    if (strcmp(cmd[1], "--tag") == 0) {
+        *tag = cmd[2];
+        snprintf(label, size, "tag %s", cmd[2]);
+    }
+    else if (strspn(cmd[2], "0123456789") == strlen(cmd[2])) {
+        *pgid = (pid_t) strtol(cmd[2], NULL, 10);
+        snprintf(label, size, "process group %d", *pgid);
+    }
+    else {
+        ProcessGroup *group = findProcessGroup(cmd[2]);
+        if (group == NULL) {
+            printf("No process group called %s\n", cmd[2]);
+            return 0;
+        }
+        *pgid = group->pgid;
+        snprintf(label, size, "pgroup %s", cmd[2]);
+    }
+
+    // Only groups with a job of pman in them may be signalled
+    for (Job *job = jobs.first; job != NULL; job = job->next) {
+        count += job_selected(job, *pgid, *tag);
+    }
+    if (count == 0) {
+        printf("No background jobs in %s\n", label);
+    }
+    return count;
+}
+
+/*
+    Function to kill, stop or start many background processes at once
+    Example as per main() func: bgkill -g web
+                                bgstop --tag batch
+    A process group gets one kill(-pgid), which also reaches the
+    children of its jobs. Tags can span groups, so tagged jobs are
+    signalled one by one. Nothing waits: stops and continues come
+    back through SIGCHLD, and the exits of a bgkill through the
+    pidfds, with one line once the last of them is reaped.
+ */
+void signal_selection(char **cmd, int sig) {
+    const char *tag;
+    char label[64];
+    pid_t pgid;
+
+    if (cmd[2] != NULL && cmd[3] != NULL) {
+        printf("Usage: %s {pid} | -g {pgroup|pgid} | --tag {tag}\n", cmd[0]);
+        return;
+    }
+    int count = select_jobs(cmd, &pgid, &tag, label, sizeof(label));
+    if (count == 0) {
+        return;
+    }
+
+    KillBatch *batch = NULL;
+    if (sig == SIGKILL) {
+        batch = calloc(1, sizeof(KillBatch));
+        countStat(COUNT_ALLOCS, 1);
+        if (batch == NULL) {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(batch->label, sizeof(batch->label), "%s", label);
+        batch->started_ns = statClock();
+    }
+
+    for (Job *job = jobs.first; job != NULL; job = job->next) {
+        if (!job_selected(job, pgid, tag)) {
+            continue;
+        }
+        if (sig == SIGKILL) {
+            // Killed on purpose, so it is not restarted
+            freeSupervisor(job->supervisor);
+            job->supervisor = NULL;
+            if (job->batch == NULL) {
+                job->batch = batch;
+                batch->total++;
+                batch->remaining++;
+            }
+        }
+        else {
+            job->requested_state = (sig == SIGSTOP) ? 'T' : 'R';
+        }
+        if (pgid == 0) {
+            signal_job(job, sig);
+        }
+    }
+
+    // Unreaped members keep the group alive, so pgid cannot have been reused
+    if (pgid != 0) {
+        countStat(COUNT_SYSCALLS, 1);
+        if (kill(-pgid, sig) == -1) {
+            perror("kill the process group is failed");
+        }
+    }
+
+    if (sig == SIGKILL) {
+        printf("Killing %d processes of %s\n", count, label);
+        // Every one of them was already in an earlier batch
+        if (batch->total == 0) {
+            free(batch);
+        }
+    }
+    else {
+        printf("%d processes of %s have been %s\n", count, label, sig == SIGSTOP ? "stopped" : "started");
+    }
+}
+
+/*
+    Function to kill a background process
+    Example as per main() func: bgkill {pid}
+    where `pid` is the process ID for process
+    to be killed.
+ */
+void func_BGkill(char * str_pid) {
+	// Check first if the PID is valid
+    if (is_valid_pid(str_pid)) {
+        // Converting the PID to pid_t
+        pid_t pid_for_p_kill = (pid_t) strtol(str_pid, NULL, 10);
+
+        Job *job = findJob(&jobs, pid_for_p_kill);
+        if (job == NULL) {
+            // A supervised job between runs only has its restart to cancel
+            Supervisor *sup = cancelRestart(pid_for_p_kill);
+            if (sup != NULL) {
+                printf("Pending restart of %d cancelled\n", pid_for_p_kill);
+                releaseDependents(&job_graph, sup->dependents, 0);
+                freeSupervisor(sup);
+                pump_graph();
+            }
+            else {
+                printf("Process is not in the list\n");
+            }
+            return;
+        }
+
+        // Killed on purpose, so it is not restarted
+        freeSupervisor(job->supervisor);
+        job->supervisor = NULL;
+
+        // Kill the process
+        if (signal_job(job, SIGKILL) != 0) {
+            perror("kill the process is failed");
+            return;
+        }
+
+        // Not waited for, reap_job reports the exit once the pidfd fires
+        printf("Process with PID %d is being killed\n", pid_for_p_kill);
+    } else {
+        printf("PID %s is not valid\n", str_pid);
+    }
+
+}
+
+/*
+    Function to stop a background process
+    Example as per main() func: bgstop {pid}
+    where `pid` is the process ID for process
+    to be stopped.
+ */
+void func_BGstop(char * str_pid) {
+	// Check first if the PID is valid
+    if (is_valid_pid(str_pid)) {
+        pid_t pid_for_p_stop = (pid_t) strtol(str_pid, NULL, 10);
+
+        // Check if the process exists and in the list
+        Job *job = findJob(&jobs, pid_for_p_stop);
+        if (job == NULL) {
+            printf("Process is not in the list\n");
+            return;
+        }
+        if(get_p_state(job) != 'T') {
+            job->requested_state = 'T';
+            signal_job(job, SIGSTOP);
+            printf("PID %s has been stopped \n", str_pid);
+        }
+        else {
+            printf("PID %s is already in stopped state \n", str_pid);
+        }
+    }
+    else {
+        printf("PID %s is not valid\n", str_pid);
+    }
+}
+
+/*
+    Function to start a background process
+    Example as per main() func: bgstart {pid}
+    where `pid` is the process ID for process
+    to be started.
+ */
+void func_BGstart(char * str_pid) {
+	// Check first if the PID is valid
+    if (is_valid_pid(str_pid)) {
+        pid_t pid_for_p_start = (pid_t) strtol(str_pid, NULL, 10);
+
+        // Check if the process exists and in the list
+        Job *job = findJob(&jobs, pid_for_p_start);
+        if (job == NULL) {
+            printf("Process is not in the list\n");
+            return;
+        }
+        if(get_p_state(job) == 'T') {
+            job->requested_state = 'R';
+            signal_job(job, SIGCONT);
+            printf("PID %s has been started from stopped state \n", str_pid);
+        }
+        else {
+            printf("PID %s was not in stopped state \n", str_pid);
+        }
+    }
+    else {
+        printf("PID %s is not valid\n", str_pid);
+    }
+}
+
+/*  Function to apply prio to a job, every process it started and
+    its restarts. Returns the number of processes changed, -1 if one failed.
+ */
+int renice_job(Job *job, const JobPriority *prio) {
+    int changed = 0;
+
+    if (job->supervisor != NULL) {
+        mergePriority(&job->supervisor->opts->priority, prio);
+    }
+    // Children keep what the job had when they were forked
+    if (walk_job_tree(job) <= 0) {
+        return applyPriority(job->pid, prio) == 0 ? 1 : -1;
+    }
+    for (size_t i = 0; i < job->tree->count; i++) {
+        if (applyPriority(job->tree->nodes[i].pid, prio) == -1) {
+            return -1;
+        }
+        changed++;
+    }
+    return changed;
+}
+
+/*
+    Function to change the priority of running background processes
+    Example as per main() func: bgrenice {pid} --nice=10
+                                bgrenice --tag batch --sched=idle --ioprio=idle
+    Takes the same --nice, --sched and --ioprio as bg. The jobs' threads
+    and the processes they started are changed, and so are their restarts.
+ */
+void func_BGrenice(char **cmd) {
+    JobPriority prio;
+    const char *tag = NULL;
+    char label[64];
+    pid_t pgid = 0;
+    Job *job = NULL;
+    int count = 0;
+    int first;
+
+    initJobPriority(&prio);
+    if (is_selection(cmd)) {
+        count = select_jobs(cmd, &pgid, &tag, label, sizeof(label));
+        if (count == 0) {
+            return;
+        }
+        first = 3;
+    }
+    else if (cmd[1] != NULL && is_valid_pid(cmd[1])) {
+        job = findJob(&jobs, (pid_t) strtol(cmd[1], NULL, 10));
+        if (job == NULL) {
+            printf("Process is not in the list\n");
+            return;
+        }
+        first = 2;
+    }
+    else {
+        printf("Usage: bgrenice {pid} | -g {pgroup|pgid} | --tag {tag} [--nice=N] [--sched=policy] [--ioprio=class,level]\n");
+        return;
+    }
+
+    for (int i = first; cmd[i] != NULL; i++) {
+        char option[OPTION_NAME_SIZE];
+        char *value = splitOption(cmd, &i, option, sizeof(option));
+        if (value == NULL && strncmp(option, "--", 2) == 0) {
+            printf("Option %.*s needs a value\n", OPTION_NAME(option));
+            return;
+        }
+        int known = (value != NULL) ? parsePriorityOption(option, value, &prio) : 0;
+        if (known == 0) {
+            printf("Unknown option %.*s (bgrenice takes --nice, --sched and --ioprio)\n", OPTION_NAME(option));
+        }
+        if (known != 1) {
+            return;
+        }
+    }
+    if (!hasPriority(&prio)) {
+        printf("Nothing to change, give --nice, --sched or --ioprio\n");
+        return;
+    }
+
+    if (job != NULL) {
+        char policy[64];
+        char ioprio[64];
+
+        int changed = renice_job(job, &prio);
+        if (changed == -1) {
+            return;
+        }
+        formatSchedPolicy(job->pid, policy, sizeof(policy));
+        formatIoPriority(job->pid, ioprio, sizeof(ioprio));
+        printf("PID %d is now %s, io %s (%d processes changed)\n", job->pid, policy, ioprio, changed);
+        return;
+    }
+
+    int processes = 0;
+    for (job = jobs.first; job != NULL; job = job->next) {
+        if (!job_selected(job, pgid, tag)) {
+            continue;
+        }
+        int changed = renice_job(job, &prio);
+        if (changed == -1) {
+            return;
+        }
+        processes += changed;
+    }
+    printf("%d jobs of %s have been reniced (%d processes changed)\n", count, label, processes);
+}
+
+/*
+    Function to list the jobs waiting for their prerequisites
+    Example as per main() func: bgdeps [-j jobs]
+    -j sets how many jobs started by bg --after may run at once.
+ */
+void func_BGdeps(char **cmd) {
+    if (cmd[1] != NULL) {
+        int limit = (strcmp(cmd[1], "-j") == 0 && cmd[2] != NULL && cmd[3] == NULL) ? atoi(cmd[2]) : 0;
+        if (limit <= 0) {
+            printf("Usage: bgdeps [-j jobs]\n");
+            return;
+        }
+        job_graph.limit = limit;
+        pump_graph();
+    }
+
+    for (GraphNode *node = job_graph.ready_first; node != NULL; node = node->next) {
+        printf("#%d: %s ready, waiting for a free slot\n", node->id, node->launch->path);
+    }
+    for (GraphNode *node = job_graph.first; node != NULL; node = node->next) {
+        printf("#%d: %s waiting for %d processes%s\n", node->id, node->launch->path, node->waiting,
+               node->failed ? " (will be cancelled)" : "");
+    }
+    printf("Dependent jobs: %zu waiting, %zu ready, %zu running, %lu started, %lu cancelled, limit %d\n",
+           job_graph.waiting, job_graph.ready, job_graph.running, job_graph.started,
+           job_graph.cancelled, job_graph.limit);
+}
+
+/*
+    Function to print the captured output of a background process
+    Example as per main() func: bglog {pid} [-n lines] [-f]
+    -f keeps printing new output until enter is pressed or the
+    process exits. Logs of finished processes are read from
+    <logs dir>/<pid>.log.
+ */
+void func_BGlog(char **cmd) {
+    long lines = 10;
+    bool follow = false;
+
+    if (cmd[1] == NULL || !is_valid_pid(cmd[1])) {
+        printf("Usage: bglog {pid} [-n lines] [-f]\n");
+        return;
+    }
+    for (int i = 2; cmd[i] != NULL; i++) {
+        if (strcmp(cmd[i], "-n") == 0 && cmd[i + 1] != NULL) {
+            lines = atol(cmd[++i]);
+        }
+        else if (strcmp(cmd[i], "-f") == 0) {
+            follow = true;
+        }
+        else {
+            printf("Usage: bglog {pid} [-n lines] [-f]\n");
+            return;
+        }
+    }
+    if (lines <= 0) {
+        printf("bglog: lines must be positive\n");
+        return;
+    }
+
+    // A pmanctl request gets one response, there is nothing to follow into
+    if (follow && serving_client) {
+        printf("bglog -f is not available through pmanctl\n");
+        return;
+    }
+
+    pid_t pid = (pid_t) strtol(cmd[1], NULL, 10);
+    Job *job = findJob(&jobs, pid);
+    if (job == NULL) {
+        if (follow || printLogFileTail(pid, lines) == -1) {
+            printf("Process is not in the list\n");
+        }
+        return;
+    }
+    if (job->log == NULL) {
+        printf("Output of %d is not captured%s\n", pid, logs_dir == NULL ? " (start pman with --logs dir)" : "");
+        return;
+    }
+
+    printJobLogTail(job->log, lines);
+    if (follow && job->log->pipe_fd >= 0) {
+        followJobLog(job->log);
+    }
+}
+
+/*
+    Function to set how jobs started without --place pick a cpu
+    Example as per main() func: bgplace {none|rr|least}
+    Without an argument the current policy is printed.
+ */
+void func_BGplace(char **cmd) {
+    static const char *names[] = {"none", "rr", "least"};
+
+    if (cmd[1] == NULL) {
+        printf("Placement: %s\n", names[default_placement]);
+        return;
+    }
+    int policy = parsePlacement(cmd[1]);
+    if (policy == -1 || cmd[2] != NULL) {
+        printf("Usage: bgplace {none|rr|least}\n");
+        return;
+    }
+    default_placement = policy;
+    printf("Placement: %s\n", names[default_placement]);
+}
+
+/*
+    Function to print the background processes that have finished
+    Example as per main() func: bghistory [-n rows] [-s]
+    Prints the last rows (default 10) finished processes and totals
+    over all of them, -s prints only the totals.
+ */
+void func_BGhistory(char **cmd) {
+    long rows = 10;
+    bool summary_only = false;
+
+    for (int i = 1; cmd[i] != NULL; i++) {
+        if (strcmp(cmd[i], "-s") == 0) {
+            summary_only = true;
+        }
+        else if (strcmp(cmd[i], "-n") == 0 && cmd[i + 1] != NULL) {
+            char *endptr;
+            rows = strtol(cmd[++i], &endptr, 10);
+            if (*endptr != '\0' || rows < 0) {
+                printf("Row count %s is not valid\n", cmd[i]);
+                return;
+            }
+        }
+        else {
+            printf("Usage: bghistory [-n rows] [-s]\n");
+            return;
+        }
+    }
+
+    if (!summary_only && finished_jobs.count > 0) {
+        printExitHistory(&finished_jobs, rows);
+    }
+    printExitSummary(&finished_jobs);
+}
+
+/*
+    Function to print pman's own latency histograms and counters
+    Example as per main() func: stats [-r] [-o file [-i seconds]]
+    -r clears them, -o writes them to file every interval
+    (default 10 seconds) and -o off stops that.
+ */
+void func_stats(char **cmd) {
+    const char *path = NULL;
+    long interval_ms = 10000;
+
+    for (int i = 1; cmd[i] != NULL; i++) {
+        if (strcmp(cmd[i], "-r") == 0) {
+            resetStats();
+            printf("Stats cleared\n");
+            return;
+        }
+        else if (strcmp(cmd[i], "-o") == 0 && cmd[i + 1] != NULL) {
+            path = cmd[++i];
+        }
+        else if (strcmp(cmd[i], "-i") == 0 && cmd[i + 1] != NULL) {
+            char *endptr;
+            double seconds = strtod(cmd[++i], &endptr);
+            if (*endptr != '\0' || seconds < 0.1) {
+                printf("Interval %s is not valid\n", cmd[i]);
+                return;
+            }
+            interval_ms = (long) (seconds * 1000);
+        }
+        else {
+            printf("Usage: stats [-r] [-o file [-i seconds]]\n");
+            return;
+        }
+    }
+
+    if (path == NULL) {
+        printStats(stdout);
+        if (statsDumpPath() != NULL) {
+            printf("written to   %s\n", statsDumpPath());
+        }
+    }
+    else if (strcmp(path, "off") == 0) {
+        stopStatsDump();
+        printf("Stats are no longer written to a file\n");
+    }
+    else if (startStatsDump(path, interval_ms) == 0) {
+        printf("Stats are written to %s every %.1f s\n", path, interval_ms / 1000.0);
+    }
+}
+
+/*
+    Function to print stats for a background process
+    Example as per main() func: pstat {pid} [--tree]
+    where `pid` is the process ID for process.
+    --tree adds every descendant of the process and their totals.
+ */
+void func_pstat(char **cmd) {
+    char *str_pid = cmd[1];
+    bool tree = false;
+    bool mem = false;
+    bool perf = false;
+
+    for (int i = 2; cmd[1] != NULL && cmd[i] != NULL; i++) {
+        if (strcmp(cmd[i], "--tree") == 0) {
+            tree = true;
+        }
+        else if (strcmp(cmd[i], "--mem") == 0) {
+            mem = true;
+        }
+        else if (strcmp(cmd[i], "--perf") == 0) {
+            perf = true;
+        }
+        else {
+            printf("Usage: pstat {pid} [--tree] [--mem] [--perf] | pstat --all | pstat --mem | pstat --perf | pstat --io [-n rows]\n");
+            return;
+        }
+    }
+
+	// Check first if the PID is valid
+    if (is_valid_pid(str_pid)) {
+        ProcSample sample;
+
+        long clock_ticks_per_second = sysconf(_SC_CLK_TCK);
+        pid_t pid = atoi(str_pid);
+
+        Job *job = findJob(&jobs, pid);
+        if(job == NULL) {
+            printf("Process is not in the list\n");
+            return;
         }
 
-        // Read contents of stat file
-        if (fgets(file_buffer, sizeof(file_buffer), file) == NULL) {
-            perror("fgets failed");
-            fclose(file);
+        // stat gives comm, state, utime, stime and rss,
+        // status gives voluntary and nonvoluntary ctxt switches,
+        // smaps_rollup what the rss is made of
+        if (sampleProc(&job->sampler, &sample, SAMPLE_ALL | (mem ? SAMPLE_SMAPS : 0)) == -1) {
+            perror("reading /proc failed");
             return;
         }
-        fclose(file);
 
-        // As we have this a single line file with space separated value, so we tokenize
-        char *tokens[52];
-        int tokenIndex = 0;
+        // Clock ticks to seconds
+        double utime_seconds = (double) sample.utime / clock_ticks_per_second;
+        double stime_seconds = (double) sample.stime / clock_ticks_per_second;
+
+        printf("<<--- Process %d (PID: %d) Stats--->>\n", pid, pid);
+        printf("     %-30s: {%s}\n", "comm", sample.comm);
+        printf("     %-30s: %c\n", "state", sample.state);
+        printf("     %-30s: %.2f s\n", "utime", utime_seconds);
+        printf("     %-30s: %.2f s\n", "stime", stime_seconds);
+        printf("     %-30s: %ld pages\n", "rss", sample.rss);
+        if (mem) {
+            printf("     %-30s: %lu kB\n", "pss", sample.pss_kb);
+            printf("     %-30s: %lu kB\n", "uss", sample.uss_kb);
+            printf("     %-30s: %lu kB\n", "anonymous", sample.anon_kb);
+            printf("     %-30s: %lu kB\n", "file backed", sample.file_kb);
+            printf("     %-30s: %lu kB (pss %lu kB)\n", "swap", sample.swap_kb, sample.swap_pss_kb);
+        }
+        printf("     %-30s: %lu\n", "voluntary context switches", sample.voluntary_ctxt_switches);
+        printf("     %-30s: %lu\n", "nonvoluntary context switches", sample.nonvoluntary_ctxt_switches);
+        printf("     %-30s: %d\n", "current cpu", sample.processor);
+
+        char policy[64];
+        formatSchedPolicy(pid, policy, sizeof(policy));
+        printf("     %-30s: %s\n", "scheduling", policy);
+        formatIoPriority(pid, policy, sizeof(policy));
+        printf("     %-30s: %s\n", "io priority", policy);
+
+        // Rates are since the previous io reading of this job (pstat, bglist --io, pstat --io)
+        IoCounters io;
+        IoRates rates;
+        int has_rates = sample_job_io(job, &io, &rates);
+        if (has_rates == 1) {
+            printf("     %-30s: %llu kB (%.1f kB/s)\n", "io read from storage", io.read_bytes / 1024, rates.read_bytes / 1024);
+            printf("     %-30s: %llu kB (%.1f kB/s)\n", "io written to storage", io.write_bytes / 1024, rates.write_bytes / 1024);
+            printf("     %-30s: %llu kB (%.1f kB/s)\n", "io cancelled writes", io.cancelled_write_bytes / 1024,
+                   rates.cancelled_write_bytes / 1024);
+            printf("     %-30s: %llu kB read, %llu kB written (%.1f / %.1f kB/s)\n", "io through syscalls",
+                   io.rchar / 1024, io.wchar / 1024, rates.rchar / 1024, rates.wchar / 1024);
+            printf("     %-30s: %llu reads, %llu writes (%.1f/s)\n", "io syscalls", io.syscr, io.syscw, rates.syscalls);
+        }
+        else if (has_rates == 0) {
+            printf("     %-30s: %llu kB\n", "io read from storage", io.read_bytes / 1024);
+            printf("     %-30s: %llu kB\n", "io written to storage", io.write_bytes / 1024);
+            printf("     %-30s: %llu kB\n", "io cancelled writes", io.cancelled_write_bytes / 1024);
+            printf("     %-30s: %llu kB read, %llu kB written\n", "io through syscalls", io.rchar / 1024, io.wchar / 1024);
+            printf("     %-30s: %llu reads, %llu writes\n", "io syscalls", io.syscr, io.syscw);
+        }
+
+        cpu_set_t allowed_cpus;
+        char cpu_list[256];
+        if (sched_getaffinity(pid, sizeof(allowed_cpus), &allowed_cpus) == 0) {
+            formatCpuList(&allowed_cpus, cpu_list, sizeof(cpu_list));
+            printf("     %-30s: %s\n", "allowed cpus", cpu_list);
+        }
+
+        // The cgroup covers the job and everything it started
+        GroupStats stats;
+        if (job->group != NULL && readGroupStats(job->group, &stats) == 0) {
+            printf("     %-30s: %s\n", "cgroup", job->group->name);
+            printf("     %-30s: %.2f s (user %.2f s, system %.2f s)\n", "cgroup cpu",
+                   stats.usage_usec / 1e6, stats.user_usec / 1e6, stats.system_usec / 1e6);
+            if (stats.memory_current != -1) {
+                printf("     %-30s: %lld kB", "cgroup memory", stats.memory_current / 1024);
+                if (stats.memory_peak != -1) {
+                    printf(" (peak %lld kB)", stats.memory_peak / 1024);
+                }
+                printf("\n");
+            }
+            if (stats.io_rbytes != -1) {
+                printf("     %-30s: read %lld kB, write %lld kB\n", "cgroup io",
+                       stats.io_rbytes / 1024, stats.io_wbytes / 1024);
+            }
+        }
+
+        if (perf) {
+            print_job_perf(job);
+        }
+        if (tree && walk_job_tree(job) > 0) {
+            print_job_tree(job);
+        }
+    }
+    else {
+        printf("PID %s is not valid\n", str_pid);
+    }
+}
+
+/*
+    Function to print stats for every background process
+    Example as per main() func: pstat --all
+    All jobs are sampled in one sweep first, then printed,
+    so the sweep time shown is the cost of sampling alone.
+ */
+void func_pstat_all() {
+    long clock_ticks_per_second = sysconf(_SC_CLK_TCK);
+    struct timespec start, end;
+
+    if (jobs.count == 0) {
+        printf("No background jobs\n");
+        return;
+    }
+
+    ProcSample *samples = malloc(jobs.count * sizeof(ProcSample));
+    countStat(COUNT_ALLOCS, 1);
+    char *sampled = malloc(jobs.count);
+    countStat(COUNT_ALLOCS, 1);
+    if (samples == NULL || sampled == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t i = 0;
+    for (Job *job = jobs.first; job != NULL; job = job->next, i++) {
+        sampled[i] = sampleProc(&job->sampler, &samples[i], SAMPLE_ALL) == 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
-        char *token = strtok(file_buffer, " ");
-        while (token != NULL && tokenIndex < 52) {
-            tokens[tokenIndex++] = token;
-            token = strtok(NULL, " ");
+    printf("%8s %5s %10s %10s %10s %10s %10s  %s\n",
+           "PID", "STATE", "UTIME(s)", "STIME(s)", "RSS(pg)", "VCSW", "NVCSW", "COMM");
+    i = 0;
+    for (Job *job = jobs.first; job != NULL; job = job->next, i++) {
+        if (!sampled[i]) {
+            printf("%8d %5s\n", job->pid, "?");
+            continue;
         }
-        strcpy(comm, tokens[1]);
-        state = tokens[2][0];
-        utime_clock_ticks = strtoul(tokens[13], NULL, 10);
-        stime_clock_ticks = strtoul(tokens[14], NULL, 10);
-        rss = strtol(tokens[23], NULL, 10);
+        printf("%8d %5c %10.2f %10.2f %10ld %10lu %10lu  %s\n", job->pid, samples[i].state,
+               (double) samples[i].utime / clock_ticks_per_second,
+               (double) samples[i].stime / clock_ticks_per_second,
+               samples[i].rss, samples[i].voluntary_ctxt_switches,
+               samples[i].nonvoluntary_ctxt_switches, samples[i].comm);
+    }
+
+    double elapsed_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    printf("Sampled %zu jobs in %.1f us (%.2f us per job)\n",
+           jobs.count, elapsed_us, elapsed_us / jobs.count);
 
-        // Read the status file for voluntary ctxt switches and nonvoluntary ctxt switches
-        file = fopen(proc_status_path, "r");
-        if (file == NULL) {
-            perror("fopen failed");
+    free(samples);
+    free(sampled);
+}
+
+/*
+    Function to show or stop the perf counters of a background process
+    Example as per main() func: bgperf {pid} [--stop]
+    The first bgperf attaches the counters to the job, the children
+    it starts afterwards are counted with it.
+ */
+void func_BGperf(char **cmd) {
+    bool stop = cmd[1] != NULL && cmd[2] != NULL && strcmp(cmd[2], "--stop") == 0;
+
+    if (cmd[1] == NULL || (cmd[2] != NULL && (!stop || cmd[3] != NULL))) {
+        printf("Usage: bgperf {pid} [--stop]\n");
+        return;
+    }
+    if (!is_valid_pid(cmd[1])) {
+        printf("PID %s is not valid\n", cmd[1]);
+        return;
+    }
+
+    Job *job = findJob(&jobs, (pid_t) strtol(cmd[1], NULL, 10));
+    if (job == NULL) {
+        printf("Process is not in the list\n");
+        return;
+    }
+    if (stop) {
+        if (job->perf == NULL) {
+            printf("Process %d is not being counted\n", job->pid);
             return;
         }
+        closePerfCounters(job->perf);
+        job->perf = NULL;
+        printf("Stopped counting process %d\n", job->pid);
+        return;
+    }
+
+    if (job->perf != NULL) {
+        printf("<<--- Process %d (PID: %d) perf counters --->>\n", job->pid, job->pid);
+    }
+    print_job_perf(job);
+}
+
+/*
+    Function to compare the perf counters of every background process
+    Example as per main() func: pstat --perf
+    Each job is one read() of its counter group. Jobs not counted yet
+    get their counters attached and show up from the next call on.
+ */
+void func_pstat_perf() {
+    size_t attached = 0;
+    size_t failed = 0;
+    PerfReading reading;
 
-        char key[128], value[300];
+    if (jobs.count == 0) {
+        printf("No background jobs\n");
+        return;
+    }
 
-        // Read the status file
-        // Since this is multi-line with key value pairs
-        while (fgets(file_buffer, sizeof(file_buffer), file)) {
-            if (sscanf(file_buffer, "%127s %299s", key, value) != 2) {
-                continue;
+    uint64_t start = statClock();
+    printf("%8s %12s %6s %10s %10s %8s %6s %10s  %s\n", "PID", "TASK(ms)", "CPU%",
+           "FAULTS/s", "CSW/s", "MIGR", "IPC", "MISS/KI", "PATH");
+    for (Job *job = jobs.first; job != NULL; job = job->next) {
+        if (job->perf == NULL) {
+            // Once one fails (fds, pmu limits) the rest would too
+            if (failed == 0 && (job->perf = attachPerfCounters(job->pid)) != NULL) {
+                attached++;
+            }
+            else {
+                failed++;
             }
-            if (strcmp(key, "voluntary_ctxt_switches:") == 0) {
-                sscanf(value, "%ld", &voluntary_ctxt_switches);
-                continue;
+            continue;
+        }
+        if (readPerfCounters(job->perf, &reading) == -1) {
+            printf("%8d %12s\n", job->pid, "?");
+            continue;
+        }
+
+        double seconds = (statClock() - job->perf->attached_ns) / 1e9;
+        printf("%8d %12.2f %6.1f %10.1f %10.1f %8llu", job->pid,
+               reading.values[PERF_TASK_CLOCK] / 1e6, reading.values[PERF_TASK_CLOCK] / 1e7 / seconds,
+               reading.values[PERF_PAGE_FAULTS] / seconds, reading.values[PERF_CTX_SWITCHES] / seconds,
+               (unsigned long long) reading.values[PERF_CPU_MIGRATIONS]);
+        if (hasPerfEvent(job->perf, PERF_CYCLES) && hasPerfEvent(job->perf, PERF_INSTRUCTIONS)
+            && reading.values[PERF_CYCLES] > 0 && reading.values[PERF_INSTRUCTIONS] > 0) {
+            printf(" %6.2f", (double) reading.values[PERF_INSTRUCTIONS] / reading.values[PERF_CYCLES]);
+            if (hasPerfEvent(job->perf, PERF_CACHE_MISSES)) {
+                printf(" %10.2f", reading.values[PERF_CACHE_MISSES] * 1000.0 / reading.values[PERF_INSTRUCTIONS]);
             }
-            if (strcmp(key, "nonvoluntary_ctxt_switches:") == 0) {
-                sscanf(value, "%ld", &nonvoluntary_ctxt_switches);
-                continue;
+            else {
+                printf(" %10s", "-");
             }
         }
-        fclose(file);
+        else {
+            printf(" %6s %10s", "-", "-");
+        }
+        printf("  %s\n", job->path);
+    }
 
-        // Clock ticks to seconds
-        double utime_seconds = (double) utime_clock_ticks / clock_ticks_per_second;
-        double stime_seconds = (double) stime_clock_ticks / clock_ticks_per_second;
+    if (attached > 0) {
+        printf("Started counting %zu jobs, they show up from the next pstat --perf\n", attached);
+    }
+    if (failed > 0) {
+        perror("perf_event_open failed");
+        printf("%zu jobs could not be counted\n", failed);
+    }
+    if (perfKernelExcluded()) {
+        printf("Counting user space only (perf_event_paranoid)\n");
+    }
+    printf("Read %zu jobs in %.1f ms\n", jobs.count, (statClock() - start) / 1e6);
+}
 
-        printf("<<--- Process %d (PID: %d) Stats--->>\n", pid, pid);
-        printf("     %-30s: {%s}\n", "comm", comm);
-        printf("     %-30s: %c\n", "state", state);
-        printf("     %-30s: %.2f s\n", "utime", utime_seconds);
-        printf("     %-30s: %.2f s\n", "stime", stime_seconds);
-        printf("     %-30s: %ld pages\n", "rss", rss);
-        printf("     %-30s: %lu\n", "voluntary context switches", voluntary_ctxt_switches);
-        printf("     %-30s: %lu\n", "nonvoluntary context switches", nonvoluntary_ctxt_switches);
+// One row of pstat --io
+typedef struct {
+    Job *job;
+    IoCounters io;
+    IoRates rates;
+    int has_rates;
+} IoRow;
+
+// qsort comparator, most storage bytes per second first, jobs without rates last
+int by_io_rate(const void *a, const void *b) {
+    const IoRow *x = a, *y = b;
+    double x_rate = x->has_rates ? x->rates.read_bytes + x->rates.write_bytes : -1;
+    double y_rate = y->has_rates ? y->rates.read_bytes + y->rates.write_bytes : -1;
+    return (y_rate > x_rate) - (y_rate < x_rate);
+}
+
+/*
+    Function to find the background processes doing the most io
+    Example as per main() func: pstat --io [-n rows]
+    Every job's /proc/<pid>/io is read once, rates are since the
+    previous reading and the busiest rows (default 20) are printed.
+ */
+void func_pstat_io(char **cmd) {
+    double read_rate = 0, write_rate = 0;
+    size_t with_rates = 0;
+    long rows = 20;
+
+    if (cmd[2] != NULL) {
+        char *endptr;
+        rows = (strcmp(cmd[2], "-n") == 0 && cmd[3] != NULL && cmd[4] == NULL) ? strtol(cmd[3], &endptr, 10) : -1;
+        if (rows <= 0 || *endptr != '\0') {
+            printf("Usage: pstat --io [-n rows]\n");
+            return;
+        }
     }
-    else {
-        printf("PID %s is not valid\n", str_pid);
+    if (jobs.count == 0) {
+        printf("No background jobs\n");
+        return;
+    }
+
+    IoRow *table = malloc(jobs.count * sizeof(IoRow));
+    countStat(COUNT_ALLOCS, 1);
+    if (table == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t start = statClock();
+    size_t n = 0;
+    for (Job *job = jobs.first; job != NULL; job = job->next) {
+        IoRow *row = &table[n];
+
+        row->job = job;
+        row->has_rates = sample_job_io(job, &row->io, &row->rates);
+        if (row->has_rates == -1) {
+            continue;
+        }
+        if (row->has_rates) {
+            read_rate += row->rates.read_bytes;
+            write_rate += row->rates.write_bytes;
+            with_rates++;
+        }
+        n++;
+    }
+    double sweep_ms = (statClock() - start) / 1e6;
+    qsort(table, n, sizeof(IoRow), by_io_rate);
+
+    printf("%8s %12s %12s %12s %12s %12s %10s  %s\n", "PID", "READ(kB/s)", "WRITE(kB/s)",
+           "CANCEL(kB/s)", "RCHAR(kB/s)", "WCHAR(kB/s)", "SYSC/s", "PATH");
+    for (size_t i = 0; i < n && (long) i < rows; i++) {
+        IoRow *row = &table[i];
+
+        if (!row->has_rates) {
+            printf("%8d %12s %12s %12s %12s %12s %10s  %s\n", row->job->pid, "-", "-", "-", "-", "-", "-",
+                   row->job->path);
+            continue;
+        }
+        printf("%8d %12.1f %12.1f %12.1f %12.1f %12.1f %10.1f  %s\n", row->job->pid,
+               row->rates.read_bytes / 1024, row->rates.write_bytes / 1024,
+               row->rates.cancelled_write_bytes / 1024, row->rates.rchar / 1024,
+               row->rates.wchar / 1024, row->rates.syscalls, row->job->path);
     }
+
+    if (with_rates < n) {
+        printf("%zu jobs had no earlier reading, their rates show from the next pstat --io\n", n - with_rates);
+    }
+    printf("Storage io of %zu jobs: read %.1f kB/s, write %.1f kB/s\n", with_rates,
+           read_rate / 1024, write_rate / 1024);
+    printf("Read %zu jobs in %.1f ms\n", jobs.count, sweep_ms);
+    free(table);
 }
 
- 
-int main() {
-    char user_input_str[50];
-    char user_input_for_error[50];
-    while (true) {
-        // Check background process every time prompted for input
-        check_background_jobs();
-        printf("Pman: > ");
-        fgets(user_input_str, 50, stdin);
-        strcpy(user_input_for_error, user_input_str);
-        //printf("User input: %s \n", user_input_str);
-        char * ptr = strtok(user_input_str, " \n");
-        if(ptr == NULL) {
+/*
+    Function to print the memory of every background process
+    Example as per main() func: pstat --mem
+    rss counts a shared page once per process that maps it, pss splits
+    it between them, so the pss total is what the jobs really use
+    together. uss is what would be freed if the job exited.
+ */
+void func_pstat_mem() {
+    unsigned long rss = 0, pss = 0, uss = 0, anon = 0, file = 0, swap = 0, swap_pss = 0;
+    size_t sampled = 0;
+    ProcSample sample;
+
+    if (jobs.count == 0) {
+        printf("No background jobs\n");
+        return;
+    }
+
+    // One pass, each row is printed as soon as its job is read
+    uint64_t start = statClock();
+    uint64_t sampling_ns = 0;
+    printf("%8s %10s %10s %10s %10s %10s %10s  %s\n",
+           "PID", "RSS(kB)", "PSS(kB)", "USS(kB)", "ANON(kB)", "FILE(kB)", "SWAP(kB)", "PATH");
+    for (Job *job = jobs.first; job != NULL; job = job->next) {
+        uint64_t before = statClock();
+        int result = sampleProc(&job->sampler, &sample, SAMPLE_SMAPS);
+        sampling_ns += statClock() - before;
+
+        if (result == -1) {
+            printf("%8d %10s\n", job->pid, "?");
             continue;
         }
-        char * lst[50];
-        int index = 0;
-        lst[index] = ptr;
-        index++;
-        while(ptr != NULL) {
-            ptr = strtok(NULL, " \n");
-            lst[index]=ptr;
-            index++;
+        printf("%8d %10lu %10lu %10lu %10lu %10lu %10lu  %s\n", job->pid, sample.rss_kb,
+               sample.pss_kb, sample.uss_kb, sample.anon_kb, sample.file_kb, sample.swap_kb, job->path);
+        rss += sample.rss_kb;
+        pss += sample.pss_kb;
+        uss += sample.uss_kb;
+        anon += sample.anon_kb;
+        file += sample.file_kb;
+        swap += sample.swap_kb;
+        swap_pss += sample.swap_pss_kb;
+        sampled++;
+    }
+    printf("%8s %10lu %10lu %10lu %10lu %10lu %10lu\n", "TOTAL", rss, pss, uss, anon, file, swap);
+    printf("Footprint of %zu jobs: %lu kB in memory (pss), %lu kB in swap (swap pss), rss adds up to %lu kB\n",
+           sampled, pss, swap_pss, rss);
+    printf("Sampled %zu jobs in %.1f us (%.2f us per job), %.1f ms in all\n", jobs.count,
+           sampling_ns / 1e3, sampling_ns / 1e3 / jobs.count, (statClock() - start) / 1e6);
+}
+
+/*
+    Function to show a live view of all background processes
+    Example as per main() func: ptop [-i seconds] [-s cpu|mem|io] [-n rows] [-c count]
+    The view refreshes every interval until enter is pressed
+    or count refreshes were shown.
+ */
+void func_ptop(char **cmd) {
+    long interval_ms = 1000;
+    int sort_by = PTOP_SORT_CPU;
+    int rows = 20;
+    int refreshes = 0;
+
+    if (serving_client) {
+        printf("ptop is not available through pmanctl, use pstat --all\n");
+        return;
+    }
+
+    for (int i = 1; cmd[i] != NULL; i++) {
+        if (strcmp(cmd[i], "-i") == 0 && cmd[i + 1] != NULL) {
+            interval_ms = (long)(atof(cmd[++i]) * 1000);
+        }
+        else if (strcmp(cmd[i], "-s") == 0 && cmd[i + 1] != NULL) {
+            i++;
+            if (strcmp(cmd[i], "cpu") == 0) {
+                sort_by = PTOP_SORT_CPU;
+            }
+            else if (strcmp(cmd[i], "mem") == 0) {
+                sort_by = PTOP_SORT_MEM;
+            }
+            else if (strcmp(cmd[i], "io") == 0) {
+                sort_by = PTOP_SORT_IO;
+            }
+            else {
+                printf("ptop: unknown sort key %s (use cpu, mem or io)\n", cmd[i]);
+                return;
+            }
+        }
+        else if (strcmp(cmd[i], "-n") == 0 && cmd[i + 1] != NULL) {
+            rows = atoi(cmd[++i]);
         }
-        if (strcmp("bg",lst[0]) == 0) {
-            func_BG(lst);
+        else if (strcmp(cmd[i], "-c") == 0 && cmd[i + 1] != NULL) {
+            refreshes = atoi(cmd[++i]);
         }
-        else if (strcmp("bglist",lst[0]) == 0) {
-            func_BGlist(lst);
-        } 
-        else if (strcmp("bgkill",lst[0]) == 0) {
+        else {
+            printf("Usage: ptop [-i seconds] [-s cpu|mem|io] [-n rows] [-c count]\n");
+            return;
+        }
+    }
+
+    if (interval_ms < 10 || rows <= 0 || refreshes < 0) {
+        printf("ptop: interval must be at least 0.01 s and rows positive\n");
+        return;
+    }
+    if (jobs.count == 0) {
+        printf("No background jobs\n");
+        return;
+    }
+    startPtop(&jobs, interval_ms, sort_by, rows, refreshes);
+}
+ 
+/*  Function to leave pman
+    In batch mode the number of commands and their rate go to stderr.
+    A q from pmanctl is answered first, the daemon exits after that.
+ */
+void quit_pman() {
+    printf("Bye Bye \n");
+    if (serving_client) {
+        quit_requested = true;
+        return;
+    }
+    if (batch_mode) {
+        struct timespec end;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - batch_start.tv_sec) + (end.tv_nsec - batch_start.tv_nsec) / 1e9;
+        fflush(stdout);
+        fprintf(stderr, "pman: %lu commands in %.3f s (%.0f commands/s)\n",
+                commands_run, elapsed, elapsed > 0 ? commands_run / elapsed : 0.0);
+    }
+    exit(0);
+}
+
+/*  Function to run one line of user input
+    Example: "bg foo", "bglist", "pstat 1234"
+    The line is split in place, lst points into it.
+ */
+void run_command(char * user_input_str) {
+    if (splitArgs(user_input_str, &input_args) == 0) {
+        return;
+    }
+    char ** lst = input_args.argv;
+    uint64_t start = statClock();
+    int stat = STAT_UNKNOWN;
+
+    commands_run++;
+    if (strcmp("bg",lst[0]) == 0) {
+        stat = STAT_BG;
+        func_BG(lst);
+    }
+    else if (strcmp("bgmany",lst[0]) == 0) {
+        stat = STAT_BGMANY;
+        func_BGmany(lst);
+    }
+    else if (strcmp("bglist",lst[0]) == 0) {
+        stat = STAT_BGLIST;
+        func_BGlist(lst);
+    } 
+    else if (strcmp("bgkill",lst[0]) == 0) {
+        stat = STAT_BGKILL;
+        if (is_selection(lst)) {
+            signal_selection(lst, SIGKILL);
+        }
+        else {
             func_BGkill(lst[1]);
         }
-        else if (strcmp("bgstop",lst[0]) == 0) {
+    }
+    else if (strcmp("bgstop",lst[0]) == 0) {
+        stat = STAT_BGSTOP;
+        if (is_selection(lst)) {
+            signal_selection(lst, SIGSTOP);
+        }
+        else {
             func_BGstop(lst[1]);
         }
-        else if (strcmp("bgstart",lst[0]) == 0) {
+    }
+    else if (strcmp("bgstart",lst[0]) == 0) {
+        stat = STAT_BGSTART;
+        if (is_selection(lst)) {
+            signal_selection(lst, SIGCONT);
+        }
+        else {
             func_BGstart(lst[1]);
         }
-        else if (strcmp("pstat",lst[0]) == 0) {
-            func_pstat(lst[1]);
+    }
+    else if (strcmp("bgrenice",lst[0]) == 0) {
+        stat = STAT_BGRENICE;
+        func_BGrenice(lst);
+    }
+    else if (strcmp("bgdeps",lst[0]) == 0) {
+        stat = STAT_BGDEPS;
+        func_BGdeps(lst);
+    }
+    else if (strcmp("bgqueue",lst[0]) == 0) {
+        stat = STAT_BGQUEUE;
+        func_BGqueue(lst);
+    }
+    else if (strcmp("bglog",lst[0]) == 0) {
+        stat = STAT_BGLOG;
+        func_BGlog(lst);
+    }
+    else if (strcmp("bgplace",lst[0]) == 0) {
+        stat = STAT_BGPLACE;
+        func_BGplace(lst);
+    }
+    else if (strcmp("pstat",lst[0]) == 0) {
+        if (lst[1] != NULL && strcmp("--all", lst[1]) == 0) {
+            stat = STAT_PSTAT_ALL;
+            func_pstat_all();
+        }
+        else if (lst[1] != NULL && strcmp("--mem", lst[1]) == 0) {
+            stat = STAT_PSTAT_MEM;
+            func_pstat_mem();
         }
-        else if (strcmp("q",lst[0]) == 0) {
-            printf("Bye Bye \n");
-            exit(0);
+        else if (lst[1] != NULL && strcmp("--perf", lst[1]) == 0) {
+            stat = STAT_PSTAT_PERF;
+            func_pstat_perf();
+        }
+        else if (lst[1] != NULL && strcmp("--io", lst[1]) == 0) {
+            stat = STAT_PSTAT_IO;
+            func_pstat_io(lst);
         }
-        // Invalid or unknown command
         else {
-            user_input_for_error[strcspn(user_input_for_error, "\n")] = '\0';
-            printf("%s: command not found \n", user_input_for_error);
+            stat = STAT_PSTAT;
+            func_pstat(lst);
         }
     }
-    return 0;
+    else if (strcmp("ptop",lst[0]) == 0) {
+        stat = STAT_PTOP;
+        func_ptop(lst);
+    }
+    else if (strcmp("bgperf",lst[0]) == 0) {
+        stat = STAT_BGPERF;
+        func_BGperf(lst);
+    }
+    else if (strcmp("bghistory",lst[0]) == 0) {
+        stat = STAT_BGHISTORY;
+        func_BGhistory(lst);
+    }
+    else if (strcmp("stats",lst[0]) == 0) {
+        stat = STAT_STATS;
+        func_stats(lst);
+    }
+    else if (strcmp("q",lst[0]) == 0) {
+        quit_pman();
+    }
+    // Invalid or unknown command
+    else {
+        for (size_t i = 0; i < input_args.argc; i++) {
+            printf(i == 0 ? "%s" : " %s", lst[i]);
+        }
+        printf(": command not found \n");
+    }
+    recordLatency(stat, start);
+}
+
+/*  Runs one pmanctl request, everything the command prints
+    (stdout and stderr) becomes the response.
+ */
+void handle_request(char *request, FILE *response) {
+    FILE *saved_stdout = stdout;
+    FILE *saved_stderr = stderr;
+
+    request[strcspn(request, "\r\n")] = '\0';
+
+    // Keep the daemon's own output in order before switching
+    fflush(stdout);
+    stdout = response;
+    stderr = response;
+    serving_client = true;
+    run_command(request);
+    serving_client = false;
+    stdout = saved_stdout;
+    stderr = saved_stderr;
+}
+
+/*  Runs when input is ready. Reads once and runs every complete
+    line that arrived, output is flushed once per batch.
+ */
+void on_input(Watch *watch, uint32_t events) {
+    char *line;
+
+    if (fillLineReader(&input_reader, input_fd) == -1) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return;
+        }
+        perror("read failed");
+        quit_pman();
+    }
+
+    prompt_active = false;
+    while ((line = nextLine(&input_reader)) != NULL) {
+        // Any line ends the live view of ptop or bglog -f
+        if (isPtopActive()) {
+            stopPtop();
+            continue;
+        }
+        if (isFollowActive()) {
+            stopFollow();
+            continue;
+        }
+        run_command(line);
+    }
+    fflush(stdout);
+
+    // End of input behaves like q, once queued, waiting and restarting jobs have run
+    if (input_reader.eof) {
+        if (nothing_pending()) {
+            quit_pman();
+        }
+        if (!input_always_ready) {
+            unwatchFd(&input_watch);
+        }
+        input_always_ready = false;
+        quit_when_idle = true;
+    }
 }
 
+int main(int argc, char **argv) {
+    char socket_path[108];
+
+    defaultSocketPath(socket_path, sizeof(socket_path));
+
+    // pman [--state path|off] [--logs dir|off] [-f commands.txt] | pman --daemon [--socket path] [--state path|off] [--logs dir|off]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            input_fd = open(argv[++i], O_RDONLY | O_CLOEXEC);
+            if (input_fd == -1) {
+                perror(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon_mode = true;
+        }
+        else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            snprintf(socket_path, sizeof(socket_path), "%s", argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--state") == 0 && i + 1 < argc) || strncmp(argv[i], "--state=", 8) == 0) {
+            const char *value = (argv[i][7] == '=') ? argv[i] + 8 : argv[++i];
+            state_path = (strcmp(value, "off") == 0 || value[0] == '\0') ? NULL : value;
+        }
+        else if ((strcmp(argv[i], "--logs") == 0 && i + 1 < argc) || strncmp(argv[i], "--logs=", 7) == 0) {
+            const char *value = (argv[i][6] == '=') ? argv[i] + 7 : argv[++i];
+            logs_dir = (strcmp(value, "off") == 0 || value[0] == '\0') ? NULL : value;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--state path|off] [--logs dir|off] [-f commands.txt]"
+                    " | %s --daemon [--socket path] [--state path|off] [--logs dir|off]\n", argv[0], argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Anything but a terminal is a script, the daemon reads no input at all
+    batch_mode = !daemon_mode && !isatty(input_fd);
+    if (daemon_mode) {
+        setvbuf(stdout, NULL, _IOLBF, 0);
+    }
+    else if (batch_mode) {
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+        clock_gettime(CLOCK_MONOTONIC, &batch_start);
+    }
+
+    initStats();
+    initJobTable(&jobs);
+    initExitHistory(&finished_jobs, HISTORY_CAPACITY);
+    raise_fd_limit();
+    if (initEventLoop() == -1) {
+        exit(EXIT_FAILURE);
+    }
+    setup_sigchld_fd();
+    if (initTimerWheel() == -1) {
+        exit(EXIT_FAILURE);
+    }
+    initSupervisor(restart_job);
+    if (initLauncher() == -1 || initPlacement() == -1) {
+        exit(EXIT_FAILURE);
+    }
+    // Without a log directory jobs keep writing to the terminal
+    if (logs_dir != NULL && initJobLogs(logs_dir) == -1) {
+        fprintf(stderr, "Job output will not be captured\n");
+    }
+
+    initLineReader(&input_reader);
+    initArgVector(&input_args);
+    initArgVector(&queue_args);
+    initJobQueue(&job_queue, (int) sysconf(_SC_NPROCESSORS_ONLN));
+    initJobGraph(&job_graph, (int) sysconf(_SC_NPROCESSORS_ONLN));
+
+    // Jobs a previous pman left running are tracked again
+    if (state_path != NULL) {
+        reattach_jobs(state_path);
+    }
+
+    if (daemon_mode) {
+        if (startControlServer(socket_path, handle_request) == -1) {
+            exit(EXIT_FAILURE);
+        }
+        printf("pman daemon (PID %d) listening on %s\n", getpid(), socket_path);
+    }
+    else if (watchFd(&input_watch, input_fd, EPOLLIN, on_input, NULL) == -1) {
+        if (errno != EPERM) {
+            perror("epoll_ctl failed");
+            exit(EXIT_FAILURE);
+        }
+        input_always_ready = true;
+    }
+
+    // One loop for input or clients, job exits (pidfds) and stops/continues (signalfd)
+    while (!quit_requested) {
+        show_prompt();
+        runEventLoopOnce(input_always_ready ? 0 : -1);
+        if (input_always_ready) {
+            on_input(&input_watch, EPOLLIN);
+        }
+    }
+    exit(0);
+    return 0;
+}
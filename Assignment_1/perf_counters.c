@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_counters.h"
+#include "stats.h"
+
+static const struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} perf_events[PERF_EVENT_COUNT] = {
+    {"task-clock",       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {"cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+
+// Set once the host refused hardware events, later jobs do not try again
+static int hardware_refused = 0;
+
+// Set once kernel side counting was refused (perf_event_paranoid), then only user time is counted
+static int exclude_kernel = 0;
+
+// Opens one event of the group led by group_fd (-1 to lead), returns the fd or -1
+static int open_event(int event, pid_t pid, int group_fd) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_events[event].type;
+    attr.config = perf_events[event].config;
+    attr.inherit = 1;                 // children started from now on count too
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    countStat(COUNT_SYSCALLS, 1);
+    int fd = (int) syscall(SYS_perf_event_open, &attr, pid, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    if (fd == -1 && errno == EACCES && !exclude_kernel) {
+        exclude_kernel = 1;
+        return open_event(event, pid, group_fd);
+    }
+    return fd;
+}
+
+/*  Function to start counting pid and the children it starts from now on.
+    The software events are required, hardware ones are added if the host
+    has a pmu and allows them. Returns the counters, or NULL with errno
+    set if the software events could not be opened.
+ */
+PerfCounters * attachPerfCounters(pid_t pid) {
+    PerfCounters *counters = malloc(sizeof(PerfCounters));
+    countStat(COUNT_ALLOCS, 1);
+    if (counters == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    counters->events = 0;
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        counters->fds[event] = -1;
+        counters->pos[event] = -1;
+    }
+
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        int hardware = perf_events[event].type == PERF_TYPE_HARDWARE;
+
+        if (hardware && hardware_refused) {
+            continue;
+        }
+        int fd = open_event(event, pid, counters->fds[PERF_TASK_CLOCK]);
+        if (fd == -1 && !hardware) {
+            int saved = errno;
+            closePerfCounters(counters);
+            errno = saved;
+            return NULL;
+        }
+        if (fd == -1) {
+            // No pmu (ENOENT), or no access to it, stays that way
+            if (errno == ENOENT || errno == EOPNOTSUPP || errno == EACCES || errno == EPERM) {
+                hardware_refused = 1;
+            }
+            continue;
+        }
+        counters->fds[event] = fd;
+        counters->pos[event] = counters->events++;
+    }
+    counters->attached_ns = statClock();
+    return counters;
+}
+
+/*  Function to read every event of the group with one read() of its leader.
+    Returns 0 on success, -1 with errno set otherwise.
+ */
+int readPerfCounters(PerfCounters *counters, PerfReading *reading) {
+    // nr, time enabled, time running, then one value per event
+    uint64_t buf[3 + PERF_EVENT_COUNT];
+
+    countStat(COUNT_SYSCALLS, 1);
+    ssize_t n = read(counters->fds[PERF_TASK_CLOCK], buf, sizeof(buf));
+    if (n < (ssize_t) (3 * sizeof(uint64_t)) || buf[0] != (uint64_t) counters->events) {
+        if (n >= 0) {
+            errno = EIO;
+        }
+        return -1;
+    }
+
+    reading->enabled_ns = buf[1];
+    reading->running_ns = buf[2];
+    for (int event = 0; event < PERF_EVENT_COUNT; event++) {
+        uint64_t value = (counters->pos[event] != -1) ? buf[3 + counters->pos[event]] : 0;
+
+        // A multiplexed group only ran part of the time, scale to all of it
+        if (reading->running_ns > 0 && reading->running_ns < reading->enabled_ns) {
+            value = (uint64_t) ((double) value * reading->enabled_ns / reading->running_ns);
+        }
+        reading->values[event] = value;
+    }
+    return 0;
+}
+
+// Returns 1 if the counters include event
+int hasPerfEvent(const PerfCounters *counters, int event) {
+    return counters->pos[event] != -1;
+}
+
+// Function to stop counting and free the counters, NULL is ignored
+void closePerfCounters(PerfCounters *counters) {
+    if (counters == NULL) {
+        return;
+    }
+    // Members first, the leader last
+    for (int event = PERF_EVENT_COUNT - 1; event >= 0; event--) {
+        if (counters->fds[event] >= 0) {
+            close(counters->fds[event]);
+        }
+    }
+    free(counters);
+}
+
+// Returns the perf name of event, e.g. "task-clock"
+const char * perfEventName(int event) {
+    return perf_events[event].name;
+}
+
+// Returns 1 if perf_event_paranoid limited the counters to user space
+int perfKernelExcluded(void) {
+    return exclude_kernel;
+}
@@ -0,0 +1,47 @@
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Events counted for a job, in the order they join the group
+#define PERF_TASK_CLOCK     0   // ns on a cpu, software
+#define PERF_PAGE_FAULTS    1   // software
+#define PERF_CTX_SWITCHES   2   // software
+#define PERF_CPU_MIGRATIONS 3   // software
+#define PERF_CYCLES         4   // hardware, only where the host allows it
+#define PERF_INSTRUCTIONS   5   // hardware
+#define PERF_CACHE_MISSES   6   // hardware
+#define PERF_EVENT_COUNT    7
+
+/*  perf_event_open counters of one job and the children it starts.
+    The events form one group led by task-clock, so a single read()
+    of the leader returns all of them. Events the host refuses are
+    left out of the group, their slot in pos is -1.
+ */
+typedef struct PerfCounters PerfCounters;
+struct PerfCounters{
+    int fds[PERF_EVENT_COUNT];  // -1 where the event is not counted, fds[0] leads
+    int pos[PERF_EVENT_COUNT];  // index of the event in the group read, -1 if absent
+    int events;                 // events in the group
+    uint64_t attached_ns;       // statClock() when counting started
+};
+
+// One read of a group, values scaled up if the group was multiplexed
+typedef struct {
+    uint64_t values[PERF_EVENT_COUNT];
+    uint64_t enabled_ns;        // time the group was enabled
+    uint64_t running_ns;        // time it was on the pmu, less than enabled if multiplexed
+} PerfReading;
+
+
+PerfCounters * attachPerfCounters(pid_t pid);
+int readPerfCounters(PerfCounters *counters, PerfReading *reading);
+int hasPerfEvent(const PerfCounters *counters, int event);
+void closePerfCounters(PerfCounters *counters);
+const char * perfEventName(int event);
+int perfKernelExcluded(void);
+
+
+
+#endif
@@ -0,0 +1,103 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "pgroup.h"
+#include "stats.h"
+
+static ProcessGroup *groups = NULL;
+
+// Function to find the process group called name, NULL if there is none
+ProcessGroup * findProcessGroup(const char *name) {
+    for (ProcessGroup *group = groups; group != NULL; group = group->next) {
+        if (strcmp(group->name, name) == 0) {
+            return group;
+        }
+    }
+    return NULL;
+}
+
+/*  Function to get the process group called name, created if needed.
+    The job is only counted once it is started, see joinProcessGroup.
+ */
+ProcessGroup * getProcessGroup(const char *name) {
+    ProcessGroup *group = findProcessGroup(name);
+
+    if (group != NULL) {
+        return group;
+    }
+    group = malloc(sizeof(ProcessGroup));
+    countStat(COUNT_ALLOCS, 1);
+    if (group != NULL) {
+        group->name = strdup(name);
+        countStat(COUNT_ALLOCS, 1);
+    }
+    if (group == NULL || group->name == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    group->pgid = 0;
+    group->members = 0;
+    group->next = groups;
+    groups = group;
+    return group;
+}
+
+/*  Returns the pgid a new job of group passes to setpgid(): the leader's,
+    or 0 to lead a new group when no job of it is left. Unreaped jobs
+    keep their group alive, so a counted member means the pgid exists.
+ */
+pid_t processGroupToJoin(const ProcessGroup *group) {
+    return (group->members > 0) ? group->pgid : 0;
+}
+
+// Function to count a started job of group, the first one leads it
+void joinProcessGroup(ProcessGroup *group, pid_t pid) {
+    if (group->members++ == 0) {
+        group->pgid = pid;
+    }
+}
+
+/*  Function to drop a reaped job from its group, an empty group is forgotten.
+    A group whose first job failed to start has no members to drop.
+ */
+void releaseProcessGroup(ProcessGroup *group) {
+    if (group == NULL || (group->members > 0 && --group->members > 0)) {
+        return;
+    }
+
+    ProcessGroup **link = &groups;
+    while (*link != group) {
+        link = &(*link)->next;
+    }
+    *link = group->next;
+    free(group->name);
+    free(group);
+}
+
+// Returns the first process group, the rest follow through next
+ProcessGroup * firstProcessGroup(void) {
+    return groups;
+}
+
+// Returns 1 if tags is a comma separated list without empty tags
+int validTags(const char *tags) {
+    if (tags[0] == ',' || tags[strlen(tags) - 1] == ',' || strstr(tags, ",,") != NULL) {
+        return 0;
+    }
+    return 1;
+}
+
+// Returns 1 if tag is one of the comma separated tags, tags may be NULL
+int hasTag(const char *tags, const char *tag) {
+    size_t len = strlen(tag);
+
+    for (const char *p = tags; p != NULL; p = strchr(p, ',')) {
+        if (*p == ',') {
+            p++;
+        }
+        if (strncmp(p, tag, len) == 0 && (p[len] == ',' || p[len] == '\0')) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef _PGROUP_H_
+#define _PGROUP_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct ProcessGroup ProcessGroup;
+
+/*  A named process group (bg --pgroup=name).
+    The first job started with the name leads it, later ones join
+    its pgid, so one kill(-pgid) reaches all of them and their
+    children. Forgotten once its last job is reaped.
+ */
+struct ProcessGroup{
+    char * name;
+    pid_t pgid;       // pid of the job that leads it, 0 until one is started
+    int members;      // jobs currently in the group, reaped ones excluded
+    ProcessGroup * next;
+};
+
+/*  Jobs signalled by one bulk bgkill. Each is reaped on its own,
+    the batch reports once when the last of them is gone.
+ */
+typedef struct KillBatch KillBatch;
+struct KillBatch{
+    char label[64];       // what was killed, e.g. "pgroup web"
+    int total;
+    int remaining;        // jobs not reaped yet
+    uint64_t started_ns;  // statClock() when the signal was sent
+};
+
+
+ProcessGroup * getProcessGroup(const char *name);
+ProcessGroup * findProcessGroup(const char *name);
+pid_t processGroupToJoin(const ProcessGroup *group);
+void joinProcessGroup(ProcessGroup *group, pid_t pid);
+void releaseProcessGroup(ProcessGroup *group);
+ProcessGroup * firstProcessGroup(void);
+int validTags(const char *tags);
+int hasTag(const char *tags, const char *tag);
+
+
+
+#endif
@@ -0,0 +1,154 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "placement.h"
+#include "proc_sampler.h"
+
+// cpus pman itself may run on, jobs are only placed on these
+static cpu_set_t allowed;
+
+// Running jobs seen on each cpu, plus the jobs placed there since
+static int cpu_load[CPU_SETSIZE];
+
+// Last cpu handed out, round robin continues after it
+static int last_cpu = -1;
+
+/*  Function to read the cpus pman is allowed to use.
+    Returns 0 on success, -1 on failure.
+ */
+int initPlacement(void) {
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity failed");
+        return -1;
+    }
+    return 0;
+}
+
+/*  Function to parse a cpu list like "0-3,6" into set.
+    Returns 0 on success, -1 if the list is invalid.
+ */
+int parseCpuList(const char *list, cpu_set_t *set) {
+    const char *p = list;
+
+    CPU_ZERO(set);
+    while (*p != '\0') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+
+        if (end == p || first < 0) {
+            return -1;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return -1;
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+
+        if (*end == ',') {
+            end++;
+        }
+        else if (*end != '\0') {
+            return -1;
+        }
+        p = end;
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+// Function to print set as a cpu list like "0-3,6"
+void formatCpuList(const cpu_set_t *set, char *buf, size_t size) {
+    size_t used = 0;
+
+    buf[0] = '\0';
+    for (int cpu = 0; cpu < CPU_SETSIZE && used < size; cpu++) {
+        if (!CPU_ISSET(cpu, set)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set)) {
+            last++;
+        }
+
+        if (last == cpu) {
+            used += snprintf(buf + used, size - used, "%s%d", used ? "," : "", cpu);
+        }
+        else {
+            used += snprintf(buf + used, size - used, "%s%d-%d", used ? "," : "", cpu, last);
+        }
+        cpu = last;
+    }
+}
+
+/*  Function to drop the cpus pman may not use from set.
+    Returns how many cpus are left.
+ */
+int usableCpus(cpu_set_t *set) {
+    CPU_AND(set, set, &allowed);
+    return CPU_COUNT(set);
+}
+
+/*  Function to count the running jobs on every cpu.
+    Uses the same cached /proc/<pid>/stat reads as pstat (state and
+    processor), done once per bg/bgmany instead of once per job placed.
+ */
+void refreshCpuLoad(JobTable *table) {
+    memset(cpu_load, 0, sizeof(cpu_load));
+
+    for (Job *job = table->first; job != NULL; job = job->next) {
+        ProcSample sample;
+
+        if (sampleProc(&job->sampler, &sample, SAMPLE_STAT) == 0 && sample.state == 'R'
+            && sample.processor >= 0 && sample.processor < CPU_SETSIZE) {
+            cpu_load[sample.processor]++;
+        }
+    }
+}
+
+/*  Function to choose the cpu for a new job.
+    within limits the choice (NULL for every cpu pman may use).
+    PLACE_RR takes the next cpu after the last one handed out,
+    PLACE_LEAST the one with the fewest running jobs, ties going
+    round robin. The chosen cpu counts as one more running job.
+    Returns the cpu, or -1 if there is nothing to choose from.
+ */
+int pickCpu(int policy, const cpu_set_t *within) {
+    cpu_set_t candidates = allowed;
+    int best = -1;
+
+    if (within != NULL) {
+        CPU_AND(&candidates, &candidates, within);
+    }
+    if (policy == PLACE_NONE || CPU_COUNT(&candidates) == 0) {
+        return -1;
+    }
+
+    // Walk every cpu once, starting after the last one handed out
+    for (int i = 1; i <= CPU_SETSIZE; i++) {
+        int cpu = (last_cpu + i) % CPU_SETSIZE;
+
+        if (!CPU_ISSET(cpu, &candidates)) {
+            continue;
+        }
+        if (best == -1 || (policy == PLACE_LEAST && cpu_load[cpu] < cpu_load[best])) {
+            best = cpu;
+        }
+        if (policy == PLACE_RR) {
+            break;
+        }
+    }
+
+    cpu_load[best]++;
+    last_cpu = best;
+    return best;
+}
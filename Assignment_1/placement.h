@@ -0,0 +1,24 @@
+#ifndef _PLACEMENT_H_
+#define _PLACEMENT_H_
+
+// Needs _GNU_SOURCE before the first include for cpu_set_t
+#include <sched.h>
+#include <stddef.h>
+#include "job_table.h"
+
+// How a new job picks its cpu
+#define PLACE_NONE  0   // inherit pman's affinity
+#define PLACE_RR    1   // next cpu in turn
+#define PLACE_LEAST 2   // cpu with the fewest running jobs
+
+
+int initPlacement(void);
+int parseCpuList(const char *list, cpu_set_t *set);
+void formatCpuList(const cpu_set_t *set, char *buf, size_t size);
+int usableCpus(cpu_set_t *set);
+void refreshCpuLoad(JobTable *table);
+int pickCpu(int policy, const cpu_set_t *within);
+
+
+
+#endif
@@ -0,0 +1,141 @@
+/*
+    pmanctl - sends commands to a pman running with --daemon
+
+    pmanctl [-s socket] {command} [args]     one command, e.g. pmanctl bglist
+    pmanctl [-s socket] -n {count} {command} send it count times, print the rate
+    pmanctl [-s socket]                      one command per line from stdin
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+
+// Connects to the daemon's socket, exits if it is not running
+static int connect_daemon(const char *path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (fd == -1) {
+        perror("socket failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        perror(path);
+        fprintf(stderr, "Is pman --daemon running?\n");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/*  Sends one request and waits for its response.
+    print chooses if the response goes to stdout.
+    Returns 0 on success, -1 if the daemon went away.
+ */
+static int request(int fd, const char *command, int print) {
+    uint32_t len;
+
+    if (sendFrame(fd, command, strlen(command)) == -1) {
+        perror("send failed");
+        return -1;
+    }
+    char *response = recvFrame(fd, &len);
+    if (response == NULL) {
+        fprintf(stderr, "pman closed the connection\n");
+        return -1;
+    }
+    if (print) {
+        fwrite(response, 1, len, stdout);
+    }
+    free(response);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    char path[108];
+    long count = 1;
+    int i = 1;
+
+    defaultSocketPath(path, sizeof(path));
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            snprintf(path, sizeof(path), "%s", argv[++i]);
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atol(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Usage: %s [-s socket] [-n count] [command [args]]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (count <= 0) {
+        fprintf(stderr, "-n needs a positive count\n");
+        return EXIT_FAILURE;
+    }
+
+    int fd = connect_daemon(path);
+
+    // No command: every line of stdin is one
+    if (i == argc) {
+        char *line = NULL;
+        size_t cap = 0;
+        ssize_t n;
+
+        while ((n = getline(&line, &cap, stdin)) != -1) {
+            if (n > 0 && line[n - 1] == '\n') {
+                line[n - 1] = '\0';
+            }
+            if (line[0] != '\0' && request(fd, line, 1) == -1) {
+                return EXIT_FAILURE;
+            }
+            fflush(stdout);
+        }
+        free(line);
+        close(fd);
+        return 0;
+    }
+
+    // Join the arguments back into one command line
+    size_t len = 0;
+    for (int j = i; j < argc; j++) {
+        len += strlen(argv[j]) + 1;
+    }
+    char *command = malloc(len);
+    if (command == NULL) {
+        perror("malloc failed");
+        return EXIT_FAILURE;
+    }
+    command[0] = '\0';
+    for (int j = i; j < argc; j++) {
+        strcat(command, argv[j]);
+        if (j + 1 < argc) {
+            strcat(command, " ");
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // Only the last response is printed
+    for (long k = 0; k < count; k++) {
+        if (request(fd, command, k == count - 1) == -1) {
+            return EXIT_FAILURE;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (count > 1) {
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "%ld requests in %.3f s (%.0f requests/s, %.1f us each)\n",
+                count, elapsed, count / elapsed, elapsed * 1e6 / count);
+    }
+    free(command);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "priority.h"
+#include "stats.h"
+
+// ioprio_set/ioprio_get have no glibc wrapper
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_VALUE(class, level) (((class) << IOPRIO_CLASS_SHIFT) | (level))
+
+// Function to set every field to "keep what pman has"
+void initJobPriority(JobPriority *prio) {
+    prio->has_nice = 0;
+    prio->nice = 0;
+    prio->policy = -1;
+    prio->rt_priority = 0;
+    prio->ioprio_class = -1;
+    prio->ioprio_level = 0;
+}
+
+// Returns 1 if any of nice, policy or io priority is to be changed
+int hasPriority(const JobPriority *prio) {
+    return prio->has_nice || prio->policy != -1 || prio->ioprio_class != -1;
+}
+
+// Function to copy into into whatever changes gives, the rest stays
+void mergePriority(JobPriority *into, const JobPriority *changes) {
+    if (changes->has_nice) {
+        into->has_nice = 1;
+        into->nice = changes->nice;
+    }
+    if (changes->policy != -1) {
+        into->policy = changes->policy;
+        into->rt_priority = changes->rt_priority;
+    }
+    if (changes->ioprio_class != -1) {
+        into->ioprio_class = changes->ioprio_class;
+        into->ioprio_level = changes->ioprio_level;
+    }
+}
+
+/*  Function to parse a policy: other, batch, idle, fifo[:prio] or rr[:prio].
+    fifo and rr run at real time priority 1 unless one is given.
+    Returns 0, -1 if invalid.
+ */
+int parseSchedPolicy(const char *value, JobPriority *prio) {
+    const char *colon = strchr(value, ':');
+    size_t len = colon ? (size_t) (colon - value) : strlen(value);
+    int rt = 0;
+
+    if (len == 5 && strncmp(value, "other", 5) == 0) {
+        prio->policy = SCHED_OTHER;
+    }
+    else if (len == 5 && strncmp(value, "batch", 5) == 0) {
+        prio->policy = SCHED_BATCH;
+    }
+    else if (len == 4 && strncmp(value, "idle", 4) == 0) {
+        prio->policy = SCHED_IDLE;
+    }
+    else if (len == 4 && strncmp(value, "fifo", 4) == 0) {
+        prio->policy = SCHED_FIFO;
+        rt = 1;
+    }
+    else if (len == 2 && strncmp(value, "rr", 2) == 0) {
+        prio->policy = SCHED_RR;
+        rt = 1;
+    }
+    else {
+        return -1;
+    }
+
+    prio->rt_priority = rt;
+    if (colon != NULL) {
+        char *end;
+        long level = strtol(colon + 1, &end, 10);
+        if (!rt || end == colon + 1 || *end != '\0' || level < 1 || level > 99) {
+            return -1;
+        }
+        prio->rt_priority = (int) level;
+    }
+    return 0;
+}
+
+/*  Function to parse an io priority: rt,N or be,N with N from 0 (highest)
+    to 7, idle, or none to follow the nice value again.
+    Returns 0, -1 if invalid.
+ */
+int parseIoPriority(const char *value, JobPriority *prio) {
+    const char *comma = strchr(value, ',');
+    size_t len = comma ? (size_t) (comma - value) : strlen(value);
+
+    if (len == 4 && strncmp(value, "none", 4) == 0 && comma == NULL) {
+        prio->ioprio_class = IOPRIO_CLASS_NONE;
+        prio->ioprio_level = 0;
+        return 0;
+    }
+    if (len == 4 && strncmp(value, "idle", 4) == 0 && comma == NULL) {
+        prio->ioprio_class = IOPRIO_CLASS_IDLE;
+        prio->ioprio_level = 0;
+        return 0;
+    }
+    if (len == 2 && strncmp(value, "rt", 2) == 0) {
+        prio->ioprio_class = IOPRIO_CLASS_RT;
+    }
+    else if (len == 2 && strncmp(value, "be", 2) == 0) {
+        prio->ioprio_class = IOPRIO_CLASS_BE;
+    }
+    else {
+        return -1;
+    }
+
+    // The level defaults to the middle one, like ionice
+    prio->ioprio_level = 4;
+    if (comma != NULL) {
+        char *end;
+        long level = strtol(comma + 1, &end, 10);
+        if (end == comma + 1 || *end != '\0' || level < 0 || level > 7) {
+            return -1;
+        }
+        prio->ioprio_level = (int) level;
+    }
+    return 0;
+}
+
+// Applies prio to the one thread tid, returns the name of the call that failed or NULL
+static const char * apply_to_thread(pid_t tid, const JobPriority *prio) {
+    // The policy first, moving back to other keeps the nice value
+    if (prio->policy != -1) {
+        struct sched_param param = {.sched_priority = prio->rt_priority};
+        countStat(COUNT_SYSCALLS, 1);
+        if (sched_setscheduler(tid, prio->policy, &param) == -1) {
+            return "policy";
+        }
+    }
+    if (prio->has_nice) {
+        countStat(COUNT_SYSCALLS, 1);
+        if (setpriority(PRIO_PROCESS, tid, prio->nice) == -1) {
+            return "nice value";
+        }
+    }
+    if (prio->ioprio_class != -1) {
+        countStat(COUNT_SYSCALLS, 1);
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid,
+                    IOPRIO_VALUE(prio->ioprio_class, prio->ioprio_level)) == -1) {
+            return "io priority";
+        }
+    }
+    return NULL;
+}
+
+/*  Function to apply prio to every thread of process pid.
+    All three are per thread in Linux, so a process started with
+    threads already running has each of them changed.
+    Returns 0, -1 after printing what failed.
+ */
+int applyPriority(pid_t pid, const JobPriority *prio) {
+    const char *failed = NULL;
+    pid_t tid = pid;
+    int err = 0;
+    char path[64];
+
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    countStat(COUNT_SYSCALLS, 1);
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        failed = apply_to_thread(pid, prio);
+        err = errno;
+    }
+    else {
+        struct dirent *entry;
+        while (failed == NULL && (entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                tid = (pid_t) strtol(entry->d_name, NULL, 10);
+                failed = apply_to_thread(tid, prio);
+            }
+        }
+        err = errno;
+        closedir(dir);
+    }
+
+    // A thread or process that exits meanwhile is not an error
+    if (failed != NULL && err != ESRCH) {
+        printf("Could not set the %s of %d: %s\n", failed, tid, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+/*  Function to describe how pid is scheduled: "batch, nice 10" or
+    "fifo, rt priority 5".
+ */
+void formatSchedPolicy(pid_t pid, char *buf, size_t size) {
+    const char *names[] = {"other", "fifo", "rr", "batch", "iso", "idle", "deadline"};
+
+    countStat(COUNT_SYSCALLS, 1);
+    int policy = sched_getscheduler(pid);
+    if (policy == -1) {
+        snprintf(buf, size, "unknown (%s)", strerror(errno));
+        return;
+    }
+    policy &= ~SCHED_RESET_ON_FORK;
+    const char *name = (policy >= 0 && policy < (int) (sizeof(names) / sizeof(names[0]))) ? names[policy] : "?";
+
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        struct sched_param param;
+        countStat(COUNT_SYSCALLS, 1);
+        if (sched_getparam(pid, &param) == 0) {
+            snprintf(buf, size, "%s, rt priority %d", name, param.sched_priority);
+            return;
+        }
+    }
+
+    // getpriority can return -1 as a nice value
+    errno = 0;
+    countStat(COUNT_SYSCALLS, 1);
+    int nice = getpriority(PRIO_PROCESS, pid);
+    if (errno != 0) {
+        snprintf(buf, size, "%s", name);
+        return;
+    }
+    snprintf(buf, size, "%s, nice %d", name, nice);
+}
+
+/*  Function to describe the io priority of pid: "be/4", "idle", or
+    "none (be/6 from nice)" when it still follows the nice value.
+ */
+void formatIoPriority(pid_t pid, char *buf, size_t size) {
+    const char *names[] = {"none", "rt", "be", "idle"};
+
+    countStat(COUNT_SYSCALLS, 1);
+    long ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, pid);
+    if (ioprio == -1) {
+        snprintf(buf, size, "unknown (%s)", strerror(errno));
+        return;
+    }
+    int class = (int) (ioprio >> IOPRIO_CLASS_SHIFT) & 7;
+    int level = (int) ioprio & 7;
+
+    if (class == IOPRIO_CLASS_IDLE) {
+        snprintf(buf, size, "idle");
+    }
+    else if (class == IOPRIO_CLASS_NONE) {
+        // The kernel takes the class from the policy and maps nice -20..19 onto levels 0..7
+        errno = 0;
+        countStat(COUNT_SYSCALLS, 2);
+        int policy = sched_getscheduler(pid) & ~SCHED_RESET_ON_FORK;
+        int nice = getpriority(PRIO_PROCESS, pid);
+        if (errno != 0) {
+            snprintf(buf, size, "none");
+        }
+        else if (policy == SCHED_IDLE) {
+            snprintf(buf, size, "none (idle from the policy)");
+        }
+        else {
+            snprintf(buf, size, "none (%s/%d from nice)",
+                     (policy == SCHED_FIFO || policy == SCHED_RR) ? "rt" : "be", (nice + 20) / 5);
+        }
+    }
+    else {
+        snprintf(buf, size, "%s/%d", class < 4 ? names[class] : "?", level);
+    }
+}
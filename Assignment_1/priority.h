@@ -0,0 +1,38 @@
+#ifndef _PRIORITY_H_
+#define _PRIORITY_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// ioprio classes, as in linux/ioprio.h
+#define IOPRIO_CLASS_NONE 0   // io priority follows the nice value
+#define IOPRIO_CLASS_RT   1
+#define IOPRIO_CLASS_BE   2
+#define IOPRIO_CLASS_IDLE 3
+
+/*  How the kernel should schedule a job (bg --nice --sched --ioprio).
+    Anything not given is left as the job inherited it from pman.
+ */
+typedef struct JobPriority JobPriority;
+struct JobPriority{
+    int has_nice;
+    int nice;             // --nice, -20 to 19
+    int policy;           // --sched, SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO or SCHED_RR, -1 to keep
+    int rt_priority;      // 1 to 99 for fifo and rr
+    int ioprio_class;     // --ioprio, one of the IOPRIO_CLASS_ values, -1 to keep
+    int ioprio_level;     // 0 (highest) to 7
+};
+
+
+void initJobPriority(JobPriority *prio);
+int hasPriority(const JobPriority *prio);
+void mergePriority(JobPriority *into, const JobPriority *changes);
+int parseSchedPolicy(const char *value, JobPriority *prio);
+int parseIoPriority(const char *value, JobPriority *prio);
+int applyPriority(pid_t pid, const JobPriority *prio);
+void formatSchedPolicy(pid_t pid, char *buf, size_t size);
+void formatIoPriority(pid_t pid, char *buf, size_t size);
+
+
+
+#endif
@@ -0,0 +1,459 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include "proc_sampler.h"
+#include "stats.h"
+
+// Large enough for any stat line. status starts at 4 KB and grows when a read fills it
+#define STAT_BUF_SIZE 1024
+#define STATUS_BUF_SIZE 4096
+#define STATUS_MAX_SIZE (1 << 20)
+// smaps_rollup is one header and about 25 short lines
+#define SMAPS_BUF_SIZE 2048
+
+// Function to prepare a sampler, files are opened on first use
+void initProcSampler(ProcSampler *sampler, pid_t pid) {
+    sampler->pid = pid;
+    sampler->stat_fd = -1;
+    sampler->status_fd = -1;
+    sampler->schedstat_fd = -1;
+    sampler->statm_fd = -1;
+    sampler->smaps_fd = -1;
+    sampler->io_fd = -1;
+}
+
+// Opens /proc/<pid>/<name> once and caches the fd in *fd
+static int open_proc_file(pid_t pid, const char *name, int *fd) {
+    char path[64];
+
+    if (*fd >= 0) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+    countStat(COUNT_SYSCALLS, 1);
+    *fd = open(path, O_RDONLY | O_CLOEXEC);
+    return (*fd < 0) ? -1 : 0;
+}
+
+/*  Re-reads /proc/<pid>/<name> from the start through the cached fd.
+    Returns the length read, or -1 with errno set (ESRCH once the
+    process is gone).
+ */
+static ssize_t reread(ProcSampler *sampler, const char *name, int *fd, char *buf, size_t size) {
+    if (open_proc_file(sampler->pid, name, fd) == -1) {
+        return -1;
+    }
+    countStat(COUNT_PROC_READS, 1);
+    countStat(COUNT_SYSCALLS, 1);
+    ssize_t n = pread(*fd, buf, size - 1, 0);
+    if (n == 0) {
+        errno = ESRCH;
+        return -1;
+    }
+    if (n > 0) {
+        buf[n] = '\0';
+    }
+    return n;
+}
+
+// Parses an unsigned decimal at *p and moves *p past it
+static unsigned long long parse_ull(const char **p, const char *end) {
+    unsigned long long value = 0;
+    const char *s = *p;
+
+    while (s < end && *s >= '0' && *s <= '9') {
+        value = value * 10 + (unsigned long long)(*s - '0');
+        s++;
+    }
+    *p = s;
+    return value;
+}
+
+// Signed version of parse_ull (priority, nice and rss can be negative)
+static long long parse_ll(const char **p, const char *end) {
+    if (*p < end && **p == '-') {
+        (*p)++;
+        return -(long long)parse_ull(p, end);
+    }
+    return (long long)parse_ull(p, end);
+}
+
+/*  Parses one /proc/<pid>/stat line in a single pass.
+    comm is taken from the first '(' to the last ')' so names that
+    contain spaces or parentheses do not shift the other fields.
+    Returns 0 on success, -1 if the line is malformed.
+ */
+int parseProcStat(const char *buf, size_t len, ProcSample *sample) {
+    const char *end = buf + len;
+    const char *open_paren = memchr(buf, '(', len);
+    const char *close_paren = memrchr(buf, ')', len);
+
+    if (open_paren == NULL || close_paren == NULL || close_paren < open_paren) {
+        return -1;
+    }
+
+    size_t comm_len = close_paren - open_paren - 1;
+    if (comm_len >= sizeof(sample->comm)) {
+        comm_len = sizeof(sample->comm) - 1;
+    }
+    memcpy(sample->comm, open_paren + 1, comm_len);
+    sample->comm[comm_len] = '\0';
+
+    // Field 3 (state) follows ") "
+    const char *p = close_paren + 2;
+    if (p >= end) {
+        return -1;
+    }
+    sample->state = *p++;
+
+    // Fields 4..41 are numbers separated by single spaces
+    for (int field = 4; field <= 41 && p < end; field++) {
+        p++;
+        long long value = parse_ll(&p, end);
+
+        switch (field) {
+            case 4:  sample->ppid = (pid_t)value; break;
+            case 10: sample->minflt = (unsigned long)value; break;
+            case 12: sample->majflt = (unsigned long)value; break;
+            case 14: sample->utime = (unsigned long)value; break;
+            case 15: sample->stime = (unsigned long)value; break;
+            case 18: sample->priority = (long)value; break;
+            case 19: sample->nice = (long)value; break;
+            case 20: sample->num_threads = (long)value; break;
+            case 22: sample->starttime = (unsigned long long)value; break;
+            case 23: sample->vsize = (unsigned long)value; break;
+            case 24: sample->rss = (long)value; break;
+            case 39: sample->processor = (int)value; break;
+            case 41: sample->policy = (unsigned int)value; break;
+            default: break;
+        }
+    }
+    return 0;
+}
+
+// Returns the value after "key" if line starts with it, NULL otherwise
+static const char *match_key(const char *line, const char *end, const char *key, size_t key_len) {
+    if ((size_t)(end - line) < key_len || memcmp(line, key, key_len) != 0) {
+        return NULL;
+    }
+    line += key_len;
+    while (line < end && (*line == ' ' || *line == '\t')) {
+        line++;
+    }
+    return line;
+}
+
+/*  Parses the key/value lines of /proc/<pid>/status in one pass,
+    only the keys pman uses are looked at.
+ */
+int parseProcStatus(const char *buf, size_t len, ProcSample *sample) {
+    static const char vol[] = "voluntary_ctxt_switches:";
+    static const char nonvol[] = "nonvoluntary_ctxt_switches:";
+    const char *end = buf + len;
+    const char *line = buf;
+
+    while (line < end) {
+        const char *eol = memchr(line, '\n', end - line);
+        const char *value;
+
+        if (eol == NULL) {
+            eol = end;
+        }
+        if ((value = match_key(line, eol, vol, sizeof(vol) - 1)) != NULL) {
+            sample->voluntary_ctxt_switches = parse_ull(&value, eol);
+        }
+        else if ((value = match_key(line, eol, nonvol, sizeof(nonvol) - 1)) != NULL) {
+            sample->nonvoluntary_ctxt_switches = parse_ull(&value, eol);
+        }
+        line = eol + 1;
+    }
+    return 0;
+}
+
+// True if the key of length len at line is key
+#define KEY_IS(line, len, key) ((len) == sizeof(key) - 1 && memcmp((line), (key), (len)) == 0)
+
+/*  Parses /proc/<pid>/smaps_rollup in one pass.
+    The kernel already summed every mapping, so this is one header
+    line and one "Key: value kB" line per total. Keys are told apart
+    by their first letter and length before any compare, most lines
+    are skipped after looking at two bytes.
+    Returns 0 on success, -1 if there is no Rss line.
+ */
+int parseSmapsRollup(const char *buf, size_t len, ProcSample *sample) {
+    const char *end = buf + len;
+    const char *line = memchr(buf, '\n', len);
+    int found = 0;
+
+    sample->rss_kb = sample->pss_kb = sample->uss_kb = sample->anon_kb = 0;
+    sample->swap_kb = sample->swap_pss_kb = 0;
+
+    // The header names the address range, the totals follow
+    while (line != NULL && ++line < end) {
+        const char *colon = memchr(line, ':', end - line);
+        if (colon == NULL) {
+            break;
+        }
+        size_t key_len = colon - line;
+        const char *value = colon + 1;
+        while (value < end && *value == ' ') {
+            value++;
+        }
+
+        switch (line[0]) {
+            case 'R':
+                if (KEY_IS(line, key_len, "Rss")) {
+                    sample->rss_kb = parse_ull(&value, end);
+                    found = 1;
+                }
+                break;
+            case 'P':
+                if (KEY_IS(line, key_len, "Pss")) {
+                    sample->pss_kb = parse_ull(&value, end);
+                }
+                else if (KEY_IS(line, key_len, "Private_Clean") || KEY_IS(line, key_len, "Private_Dirty")
+                         || KEY_IS(line, key_len, "Private_Hugetlb")) {
+                    sample->uss_kb += parse_ull(&value, end);
+                }
+                break;
+            case 'A':
+                if (KEY_IS(line, key_len, "Anonymous")) {
+                    sample->anon_kb = parse_ull(&value, end);
+                }
+                break;
+            case 'S':
+                if (KEY_IS(line, key_len, "Swap")) {
+                    sample->swap_kb = parse_ull(&value, end);
+                }
+                else if (KEY_IS(line, key_len, "SwapPss")) {
+                    sample->swap_pss_kb = parse_ull(&value, end);
+                }
+                break;
+            default:
+                break;
+        }
+        line = memchr(value, '\n', end - value);
+    }
+
+    sample->file_kb = (sample->rss_kb > sample->anon_kb) ? sample->rss_kb - sample->anon_kb : 0;
+    return found ? 0 : -1;
+}
+
+/*  Parses /proc/<pid>/io in one pass, seven "key: value" lines.
+    The first letter and the key length tell the keys apart, only
+    write_bytes and wchar need more than that.
+    Returns 0 on success, -1 if there is no rchar line.
+ */
+int parseProcIo(const char *buf, size_t len, IoCounters *io) {
+    const char *end = buf + len;
+    const char *line = buf;
+    int found = 0;
+
+    memset(io, 0, sizeof(*io));
+    while (line != NULL && line < end) {
+        const char *colon = memchr(line, ':', end - line);
+        if (colon == NULL) {
+            break;
+        }
+        size_t key_len = colon - line;
+        const char *value = colon + 1;
+        while (value < end && *value == ' ') {
+            value++;
+        }
+        unsigned long long number = parse_ull(&value, end);
+
+        switch (line[0]) {
+            case 'r':
+                if (key_len == 5) {
+                    io->rchar = number;
+                    found = 1;
+                }
+                else if (key_len == 10) {
+                    io->read_bytes = number;
+                }
+                break;
+            case 'w':
+                if (KEY_IS(line, key_len, "wchar")) {
+                    io->wchar = number;
+                }
+                else if (KEY_IS(line, key_len, "write_bytes")) {
+                    io->write_bytes = number;
+                }
+                break;
+            case 's':
+                if (KEY_IS(line, key_len, "syscr")) {
+                    io->syscr = number;
+                }
+                else if (KEY_IS(line, key_len, "syscw")) {
+                    io->syscw = number;
+                }
+                break;
+            case 'c':
+                io->cancelled_write_bytes = number;
+                break;
+            default:
+                break;
+        }
+        line = memchr(value, '\n', end - value);
+        if (line != NULL) {
+            line++;
+        }
+    }
+    return found ? 0 : -1;
+}
+
+// Function to turn two io readings seconds apart into per second rates
+void ioRates(const IoCounters *from, const IoCounters *to, double seconds, IoRates *rates) {
+    if (seconds <= 0) {
+        memset(rates, 0, sizeof(*rates));
+        return;
+    }
+    rates->rchar = (to->rchar - from->rchar) / seconds;
+    rates->wchar = (to->wchar - from->wchar) / seconds;
+    rates->syscalls = ((to->syscr + to->syscw) - (from->syscr + from->syscw)) / seconds;
+    rates->read_bytes = (to->read_bytes - from->read_bytes) / seconds;
+    rates->write_bytes = (to->write_bytes - from->write_bytes) / seconds;
+    rates->cancelled_write_bytes = (to->cancelled_write_bytes - from->cancelled_write_bytes) / seconds;
+}
+
+/*  Function to take a sample of a process.
+    what is a mask of the SAMPLE_* flags.
+    Returns 0 on success, -1 with errno set otherwise
+    (ESRCH once the process is gone).
+ */
+int sampleProc(ProcSampler *sampler, ProcSample *sample, int what) {
+    if (what & SAMPLE_STAT) {
+        char buf[STAT_BUF_SIZE];
+        ssize_t n = reread(sampler, "stat", &sampler->stat_fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            return -1;
+        }
+        if (parseProcStat(buf, (size_t)n, sample) == -1) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (what & SAMPLE_STATUS) {
+        char stack_buf[STATUS_BUF_SIZE];
+        char *buf = stack_buf;
+        size_t size = sizeof(stack_buf);
+        ssize_t n = reread(sampler, "status", &sampler->status_fd, buf, size);
+
+        // A full buffer may have cut off the end, with many cpus the
+        // Cpus_allowed and Mems_allowed lines alone take several KB
+        while (n == (ssize_t)size - 1 && size < STATUS_MAX_SIZE) {
+            char *bigger = (buf == stack_buf) ? malloc(size * 2) : realloc(buf, size * 2);
+            countStat(COUNT_ALLOCS, 1);
+            if (bigger == NULL) {
+                break;
+            }
+            buf = bigger;
+            size *= 2;
+            n = reread(sampler, "status", &sampler->status_fd, buf, size);
+        }
+        if (n != -1) {
+            parseProcStatus(buf, (size_t)n, sample);
+        }
+        if (buf != stack_buf) {
+            free(buf);
+        }
+        if (n == -1) {
+            return -1;
+        }
+    }
+
+    // schedstat is three numbers and much cheaper to generate than status
+    if (what & SAMPLE_SCHEDSTAT) {
+        char buf[128];
+        ssize_t n = reread(sampler, "schedstat", &sampler->schedstat_fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            return -1;
+        }
+        const char *p = buf;
+        const char *end = buf + n;
+        sample->run_time_ns = parse_ull(&p, end);
+        p++;
+        sample->wait_time_ns = parse_ull(&p, end);
+        p++;
+        sample->timeslices = (unsigned long)parse_ull(&p, end);
+    }
+
+    // statm gives rss alone, without the cost of formatting all of stat
+    if (what & SAMPLE_STATM) {
+        char buf[128];
+        ssize_t n = reread(sampler, "statm", &sampler->statm_fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            return -1;
+        }
+        const char *p = buf;
+        const char *end = buf + n;
+        parse_ull(&p, end);
+        p++;
+        sample->rss = (long)parse_ull(&p, end);
+    }
+
+    // smaps_rollup walks every mapping in the kernel, the dearest file here
+    if (what & SAMPLE_SMAPS) {
+        char buf[SMAPS_BUF_SIZE];
+        ssize_t n = reread(sampler, "smaps_rollup", &sampler->smaps_fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            return -1;
+        }
+        if (parseSmapsRollup(buf, (size_t)n, sample) == -1) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (what & SAMPLE_IO) {
+        char buf[256];
+        ssize_t n = reread(sampler, "io", &sampler->io_fd, buf, sizeof(buf));
+
+        if (n == -1) {
+            return -1;
+        }
+        if (parseProcIo(buf, (size_t)n, &sample->io) == -1) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to close the cached fds
+void closeProcSampler(ProcSampler *sampler) {
+    if (sampler->stat_fd >= 0) {
+        close(sampler->stat_fd);
+        sampler->stat_fd = -1;
+    }
+    if (sampler->status_fd >= 0) {
+        close(sampler->status_fd);
+        sampler->status_fd = -1;
+    }
+    if (sampler->schedstat_fd >= 0) {
+        close(sampler->schedstat_fd);
+        sampler->schedstat_fd = -1;
+    }
+    if (sampler->statm_fd >= 0) {
+        close(sampler->statm_fd);
+        sampler->statm_fd = -1;
+    }
+    if (sampler->smaps_fd >= 0) {
+        close(sampler->smaps_fd);
+        sampler->smaps_fd = -1;
+    }
+    if (sampler->io_fd >= 0) {
+        close(sampler->io_fd);
+        sampler->io_fd = -1;
+    }
+}
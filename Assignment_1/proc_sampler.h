@@ -0,0 +1,94 @@
+#ifndef _PROCSAMPLER_H_
+#define _PROCSAMPLER_H_
+
+#include <sys/types.h>
+
+// Fields of /proc/<pid>/io, totals since the process started
+typedef struct {
+    unsigned long long rchar;         // bytes returned by read syscalls, page cache and pipes too
+    unsigned long long wchar;         // bytes passed to write syscalls
+    unsigned long long syscr;         // read syscalls
+    unsigned long long syscw;         // write syscalls
+    unsigned long long read_bytes;    // bytes fetched from storage
+    unsigned long long write_bytes;   // bytes sent to storage
+    unsigned long long cancelled_write_bytes; // dirtied, then truncated before writeback
+} IoCounters;
+
+// Per second rates between two IoCounters readings
+typedef struct {
+    double rchar;
+    double wchar;
+    double syscalls;                  // read and write syscalls together
+    double read_bytes;
+    double write_bytes;
+    double cancelled_write_bytes;
+} IoRates;
+
+// Fields pman reads from /proc/<pid>/stat and /proc/<pid>/status
+typedef struct {
+    char comm[64];
+    char state;
+    pid_t ppid;
+    unsigned long minflt;
+    unsigned long majflt;
+    unsigned long utime;            // clock ticks
+    unsigned long stime;            // clock ticks
+    long priority;
+    long nice;
+    long num_threads;
+    unsigned long long starttime;   // clock ticks after boot
+    unsigned long vsize;            // bytes
+    long rss;                       // pages
+    int processor;
+    unsigned int policy;
+    unsigned long voluntary_ctxt_switches;
+    unsigned long nonvoluntary_ctxt_switches;
+    unsigned long long run_time_ns;   // schedstat: time spent on a cpu
+    unsigned long long wait_time_ns;  // schedstat: time spent runnable, waiting
+    unsigned long timeslices;         // schedstat: times scheduled in
+    unsigned long rss_kb;             // smaps_rollup: Rss, this and the rest in kB
+    unsigned long pss_kb;             // smaps_rollup: Pss, shared pages split between their users
+    unsigned long uss_kb;             // smaps_rollup: Private_Clean + Private_Dirty + Private_Hugetlb
+    unsigned long anon_kb;            // smaps_rollup: Anonymous
+    unsigned long file_kb;            // Rss - Anonymous, file backed and shared memory
+    unsigned long swap_kb;            // smaps_rollup: Swap
+    unsigned long swap_pss_kb;        // smaps_rollup: SwapPss
+    IoCounters io;                    // /proc/<pid>/io
+} ProcSample;
+
+/*  Open /proc files of one process.
+    They are opened once and re-read with pread() at offset 0,
+    which makes the kernel regenerate their contents.
+ */
+typedef struct {
+    pid_t pid;
+    int stat_fd;
+    int status_fd;
+    int schedstat_fd;
+    int statm_fd;
+    int smaps_fd;         // smaps_rollup
+    int io_fd;
+} ProcSampler;
+
+// What sampleProc() should read
+#define SAMPLE_STAT   1
+#define SAMPLE_STATUS 2
+#define SAMPLE_SCHEDSTAT 4
+#define SAMPLE_STATM  8
+#define SAMPLE_SMAPS  16
+#define SAMPLE_IO     32
+#define SAMPLE_ALL    (SAMPLE_STAT | SAMPLE_STATUS)
+
+
+void initProcSampler(ProcSampler *sampler, pid_t pid);
+int sampleProc(ProcSampler *sampler, ProcSample *sample, int what);
+void closeProcSampler(ProcSampler *sampler);
+int parseProcStat(const char *buf, size_t len, ProcSample *sample);
+int parseProcStatus(const char *buf, size_t len, ProcSample *sample);
+int parseSmapsRollup(const char *buf, size_t len, ProcSample *sample);
+int parseProcIo(const char *buf, size_t len, IoCounters *io);
+void ioRates(const IoCounters *from, const IoCounters *to, double seconds, IoRates *rates);
+
+
+
+#endif
@@ -0,0 +1,507 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include "proc_tree.h"
+#include "stats.h"
+
+// States of TreeNode.seen during a walk
+#define NODE_STALE   0   // not found yet, closed after the walk if it stays so
+#define NODE_SAMPLED 1   // read this walk, not known to be in the tree (fallbacks only)
+#define NODE_IN_TREE 2
+
+// Starting number of nodes, must be a power of two
+#define TREE_MIN_CAPACITY 16
+
+// 1 if the kernel has /proc/<pid>/task/<tid>/children (CONFIG_PROC_CHILDREN), -1 until checked
+static int children_files = -1;
+
+// A process and its parent, as read by the fallbacks
+typedef struct {
+    pid_t pid;
+    pid_t ppid;
+} PidPair;
+
+// Function to create an empty tree
+ProcTree * newProcTree(void) {
+    ProcTree *tree = calloc(1, sizeof(ProcTree));
+    countStat(COUNT_ALLOCS, 1);
+
+    if (tree == NULL) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return tree;
+}
+
+// Home slot of a pid in the index (Fibonacci hashing like the job table)
+static size_t home_slot(const ProcTree *tree, pid_t pid) {
+    return (size_t)(((uint32_t)pid * 2654435769u) & (tree->index_capacity - 1));
+}
+
+// Index of the node for pid, -1 if there is none
+static long find_node(const ProcTree *tree, pid_t pid) {
+    size_t mask = tree->index_capacity - 1;
+
+    if (tree->index_capacity == 0) {
+        return -1;
+    }
+    for (size_t i = home_slot(tree, pid); tree->index[i] != 0; i = (i + 1) & mask) {
+        if (tree->nodes[tree->index[i] - 1].pid == pid) {
+            return tree->index[i] - 1;
+        }
+    }
+    return -1;
+}
+
+// Rebuilds the index for the current nodes, at most half full
+static void rebuild_index(ProcTree *tree) {
+    size_t capacity = TREE_MIN_CAPACITY * 2;
+
+    while (capacity < tree->capacity * 2) {
+        capacity *= 2;
+    }
+    if (capacity != tree->index_capacity) {
+        free(tree->index);
+        tree->index = malloc(capacity * sizeof(uint32_t));
+        countStat(COUNT_ALLOCS, 1);
+        if (tree->index == NULL) {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        tree->index_capacity = capacity;
+    }
+    memset(tree->index, 0, capacity * sizeof(uint32_t));
+
+    size_t mask = capacity - 1;
+    for (size_t n = 0; n < tree->count; n++) {
+        size_t i = home_slot(tree, tree->nodes[n].pid);
+        while (tree->index[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        tree->index[i] = n + 1;
+    }
+}
+
+// Returns the index of the node for pid, adding a node if there is none
+static size_t add_node(ProcTree *tree, pid_t pid) {
+    long found = find_node(tree, pid);
+
+    if (found >= 0) {
+        return (size_t) found;
+    }
+    if (tree->count == tree->capacity) {
+        size_t capacity = tree->capacity ? tree->capacity * 2 : TREE_MIN_CAPACITY;
+        TreeNode *nodes = realloc(tree->nodes, capacity * sizeof(TreeNode));
+        countStat(COUNT_ALLOCS, 1);
+        if (nodes == NULL) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        tree->nodes = nodes;
+        tree->capacity = capacity;
+    }
+
+    TreeNode *node = &tree->nodes[tree->count++];
+    node->pid = pid;
+    node->children_fd = -1;
+    node->seen = NODE_STALE;
+    initProcSampler(&node->sampler, pid);
+
+    if (tree->index_capacity < tree->capacity * 2) {
+        rebuild_index(tree);
+    }
+    else {
+        size_t mask = tree->index_capacity - 1;
+        size_t i = home_slot(tree, pid);
+        while (tree->index[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        tree->index[i] = tree->count;
+    }
+    return tree->count - 1;
+}
+
+// Closes the fds of a node
+static void close_node(TreeNode *node) {
+    closeProcSampler(&node->sampler);
+    if (node->children_fd >= 0) {
+        close(node->children_fd);
+        node->children_fd = -1;
+    }
+}
+
+// Checks once whether this kernel has the children files
+static int have_children_files(void) {
+    char path[64];
+
+    if (children_files == -1) {
+        snprintf(path, sizeof(path), "/proc/self/task/%d/children", getpid());
+        children_files = (access(path, R_OK) == 0);
+    }
+    return children_files;
+}
+
+/*  Reads a whole small file into a malloc'd NUL terminated buffer.
+    pread from offset 0 if fd is open, otherwise path is opened and closed.
+    Returns NULL on failure.
+ */
+static char * read_whole(int fd, const char *path, size_t *len) {
+    size_t cap = 4096;
+    size_t used = 0;
+    int own = (fd < 0);
+    char *buf = malloc(cap);
+    countStat(COUNT_ALLOCS, 1);
+
+    if (buf == NULL) {
+        return NULL;
+    }
+    if (own) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        countStat(COUNT_SYSCALLS, 1);
+        if (fd == -1) {
+            free(buf);
+            return NULL;
+        }
+    }
+    while (1) {
+        countStat(COUNT_SYSCALLS, 1);
+        countStat(COUNT_PROC_READS, 1);
+        ssize_t n = pread(fd, buf + used, cap - used - 1, used);
+        if (n <= 0) {
+            break;
+        }
+        used += n;
+        // A short read got the rest, /proc files are generated in one go
+        if (used + 1 < cap) {
+            break;
+        }
+        char *bigger = realloc(buf, cap * 2);
+        countStat(COUNT_ALLOCS, 1);
+        if (bigger == NULL) {
+            break;
+        }
+        buf = bigger;
+        cap *= 2;
+    }
+    if (own) {
+        close(fd);
+    }
+    buf[used] = '\0';
+    *len = used;
+    return buf;
+}
+
+// Samples node n for the walk, returns 0 if the process is still there
+static int sample_node(ProcTree *tree, size_t n) {
+    TreeNode *node = &tree->nodes[n];
+
+    if (node->seen != NODE_STALE) {
+        return 0;
+    }
+    if (sampleProc(&node->sampler, &node->sample, SAMPLE_STAT) == -1) {
+        return -1;
+    }
+    node->seen = NODE_SAMPLED;
+    return 0;
+}
+
+// Marks node n as part of the tree and appends it to the walk order
+static void join_tree(ProcTree *tree, size_t n, size_t **order, size_t *order_len, size_t *order_cap) {
+    tree->nodes[n].seen = NODE_IN_TREE;
+    if (*order_len == *order_cap) {
+        *order_cap *= 2;
+        *order = realloc(*order, *order_cap * sizeof(size_t));
+        countStat(COUNT_ALLOCS, 1);
+        if (*order == NULL) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    (*order)[(*order_len)++] = n;
+}
+
+// Adds the pids listed in a children file to the tree
+static void add_children(ProcTree *tree, const char *list, size_t **order, size_t *order_len, size_t *order_cap) {
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long pid = strtol(p, &end, 10);
+
+        if (end == p) {
+            break;
+        }
+        p = end;
+        if (pid <= 0) {
+            continue;
+        }
+        size_t n = add_node(tree, (pid_t) pid);
+        if (tree->nodes[n].seen == NODE_IN_TREE || sample_node(tree, n) == -1) {
+            continue;
+        }
+        join_tree(tree, n, order, order_len, order_cap);
+    }
+}
+
+/*  Walks down from the job through the children files, breadth first.
+    A process only lists the children of each of its threads, so the
+    task directory is read for processes with more than one thread.
+ */
+static void walk_children(ProcTree *tree, size_t **order, size_t *order_len, size_t *order_cap) {
+    char path[320];
+
+    for (size_t q = 0; q < *order_len; q++) {
+        size_t n = (*order)[q];
+        pid_t pid = tree->nodes[n].pid;
+        size_t len;
+
+        if (tree->nodes[n].sample.num_threads <= 1) {
+            if (tree->nodes[n].children_fd == -1) {
+                snprintf(path, sizeof(path), "/proc/%d/task/%d/children", pid, pid);
+                tree->nodes[n].children_fd = open(path, O_RDONLY | O_CLOEXEC);
+                countStat(COUNT_SYSCALLS, 1);
+            }
+            if (tree->nodes[n].children_fd == -1) {
+                continue;
+            }
+            char *list = read_whole(tree->nodes[n].children_fd, NULL, &len);
+            if (list != NULL) {
+                add_children(tree, list, order, order_len, order_cap);
+                free(list);
+            }
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/proc/%d/task", pid);
+        DIR *dir = opendir(path);
+        if (dir == NULL) {
+            continue;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+                continue;
+            }
+            snprintf(path, sizeof(path), "/proc/%d/task/%s/children", pid, entry->d_name);
+            char *list = read_whole(-1, path, &len);
+            if (list != NULL) {
+                add_children(tree, list, order, order_len, order_cap);
+                free(list);
+            }
+        }
+        closedir(dir);
+    }
+}
+
+/*  Reads the parent of pid. Known processes are re-read through their
+    open fds, others are opened and closed again, so only processes that
+    turn out to be in the tree keep fds.
+    Returns the parent, or -1 if the process is gone.
+ */
+static pid_t read_parent(ProcTree *tree, pid_t pid) {
+    long n = find_node(tree, pid);
+
+    if (n >= 0) {
+        return (sample_node(tree, (size_t) n) == 0) ? tree->nodes[n].sample.ppid : -1;
+    }
+
+    ProcSampler sampler;
+    ProcSample sample;
+    initProcSampler(&sampler, pid);
+    int result = sampleProc(&sampler, &sample, SAMPLE_STAT);
+    closeProcSampler(&sampler);
+    return (result == 0) ? sample.ppid : -1;
+}
+
+// Appends a pid and its parent to the candidate list
+static void push_pair(PidPair **pairs, size_t *count, size_t *cap, pid_t pid, pid_t ppid) {
+    if (*count == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        *pairs = realloc(*pairs, *cap * sizeof(PidPair));
+        countStat(COUNT_ALLOCS, 1);
+        if (*pairs == NULL) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    (*pairs)[*count].pid = pid;
+    (*pairs)[*count].ppid = ppid;
+    (*count)++;
+}
+
+/*  Collects every candidate process with its parent: the members of
+    the job's cgroup, or every process in /proc without one.
+    Returns the number of candidates.
+ */
+static size_t collect_candidates(ProcTree *tree, pid_t root, int group_fd, PidPair **pairs) {
+    size_t count = 0;
+    size_t cap = 0;
+
+    *pairs = NULL;
+    if (group_fd >= 0) {
+        int fd = openat(group_fd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+        countStat(COUNT_SYSCALLS, 1);
+        if (fd >= 0) {
+            size_t len;
+            char *list = read_whole(fd, NULL, &len);
+            close(fd);
+            for (char *p = list; p != NULL && *p; ) {
+                char *end;
+                long pid = strtol(p, &end, 10);
+                if (end == p) {
+                    break;
+                }
+                p = end;
+                if (pid > 0 && pid != root) {
+                    pid_t ppid = read_parent(tree, (pid_t) pid);
+                    if (ppid > 0) {
+                        push_pair(pairs, &count, &cap, (pid_t) pid, ppid);
+                    }
+                }
+            }
+            free(list);
+            return count;
+        }
+    }
+
+    DIR *dir = opendir("/proc");
+    if (dir == NULL) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+            continue;
+        }
+        pid_t pid = (pid_t) atoi(entry->d_name);
+        if (pid == root) {
+            continue;
+        }
+        pid_t ppid = read_parent(tree, pid);
+        if (ppid > 0) {
+            push_pair(pairs, &count, &cap, pid, ppid);
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+/*  Finds the descendants among the candidates by following parents,
+    a pass per level of the tree until no new process joins.
+ */
+static void walk_parents(ProcTree *tree, pid_t root, int group_fd, size_t **order, size_t *order_len, size_t *order_cap) {
+    PidPair *pairs;
+    size_t count = collect_candidates(tree, root, group_fd, &pairs);
+    int grew = 1;
+
+    while (grew) {
+        grew = 0;
+        for (size_t i = 0; i < count; i++) {
+            long parent = find_node(tree, pairs[i].ppid);
+            if (parent < 0 || tree->nodes[parent].seen != NODE_IN_TREE) {
+                continue;
+            }
+            size_t n = add_node(tree, pairs[i].pid);
+            if (tree->nodes[n].seen == NODE_IN_TREE || sample_node(tree, n) == -1) {
+                continue;
+            }
+            join_tree(tree, n, order, order_len, order_cap);
+            grew = 1;
+        }
+    }
+    free(pairs);
+}
+
+/*  Function to find and sample a job and all of its descendants.
+    Uses the children files when the kernel has them, otherwise the
+    job's cgroup (group_fd, -1 for none), otherwise a pass over /proc.
+    Processes gone since the last walk are dropped.
+    Returns the number of processes in the tree, -1 if the job is gone.
+ */
+int walkProcTree(ProcTree *tree, pid_t root, int group_fd) {
+    struct timespec start, end;
+    size_t order_cap = TREE_MIN_CAPACITY;
+    size_t order_len = 0;
+    size_t *order = malloc(order_cap * sizeof(size_t));
+    countStat(COUNT_ALLOCS, 1);
+
+    if (order == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t n = 0; n < tree->count; n++) {
+        tree->nodes[n].seen = NODE_STALE;
+    }
+    size_t n = add_node(tree, root);
+    if (sample_node(tree, n) == 0) {
+        tree->nodes[n].seen = NODE_IN_TREE;
+        order[order_len++] = n;
+
+        if (have_children_files()) {
+            tree->source = TREE_CHILDREN;
+            walk_children(tree, &order, &order_len, &order_cap);
+        }
+        else {
+            tree->source = (group_fd >= 0) ? TREE_CGROUP : TREE_PROC;
+            walk_parents(tree, root, group_fd, &order, &order_len, &order_cap);
+        }
+    }
+
+    // Keep the tree's nodes in walk order, close the rest
+    for (size_t i = 0; i < tree->count; i++) {
+        if (tree->nodes[i].seen != NODE_IN_TREE) {
+            close_node(&tree->nodes[i]);
+        }
+    }
+    TreeNode *nodes = malloc((order_len ? order_len : 1) * sizeof(TreeNode));
+    countStat(COUNT_ALLOCS, 1);
+    if (nodes == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    tree->utime = 0;
+    tree->stime = 0;
+    tree->rss = 0;
+    for (size_t i = 0; i < order_len; i++) {
+        nodes[i] = tree->nodes[order[i]];
+        tree->utime += nodes[i].sample.utime;
+        tree->stime += nodes[i].sample.stime;
+        tree->rss += nodes[i].sample.rss;
+    }
+    free(tree->nodes);
+    free(order);
+    tree->nodes = nodes;
+    tree->count = order_len;
+    tree->capacity = order_len ? order_len : 1;
+    rebuild_index(tree);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    tree->walk_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    return (order_len > 0) ? (int) order_len : -1;
+}
+
+// Function to close every node and free the tree
+void freeProcTree(ProcTree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    for (size_t n = 0; n < tree->count; n++) {
+        close_node(&tree->nodes[n]);
+    }
+    free(tree->nodes);
+    free(tree->index);
+    free(tree);
+}
+
+// Returns how a walk source is shown by pstat
+const char * treeSourceName(int source) {
+    static const char *names[] = {"children files", "cgroup.procs", "/proc scan"};
+    return names[source];
+}
@@ -0,0 +1,51 @@
+#ifndef _PROCTREE_H_
+#define _PROCTREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "proc_sampler.h"
+
+// How a walk found the descendants
+#define TREE_CHILDREN 0   // /proc/<pid>/task/<tid>/children of every process in the tree
+#define TREE_CGROUP   1   // cgroup.procs of the job's group and each member's parent
+#define TREE_PROC     2   // the parent of every process in /proc, when neither is available
+
+// One process of a tree, with its /proc fds kept open between walks
+typedef struct {
+    pid_t pid;
+    int children_fd;      // /proc/<pid>/task/<pid>/children, -1 until opened
+    char seen;            // state during a walk, see proc_tree.c
+    ProcSampler sampler;
+    ProcSample sample;
+} TreeNode;
+
+typedef struct ProcTree ProcTree;
+
+/*  A job and all of its descendants.
+    The tree is kept between walks, so a process found before is
+    re-read through its open fds and only new processes are opened.
+    After a walk nodes[0] is the job and parents come before children.
+ */
+struct ProcTree{
+    TreeNode * nodes;
+    size_t count;
+    size_t capacity;
+    uint32_t * index;             // open addressed hash of pid -> node index + 1, 0 is empty
+    size_t index_capacity;
+    int source;                   // TREE_* the last walk used
+    unsigned long long utime;     // totals over the tree, clock ticks
+    unsigned long long stime;
+    long rss;                     // pages
+    double walk_us;               // what the last walk took
+};
+
+
+ProcTree * newProcTree(void);
+int walkProcTree(ProcTree *tree, pid_t root, int group_fd);
+void freeProcTree(ProcTree *tree);
+const char * treeSourceName(int source);
+
+
+
+#endif
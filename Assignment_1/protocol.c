@@ -0,0 +1,118 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "protocol.h"
+
+/*  Function to get the socket path used when none is given:
+    $XDG_RUNTIME_DIR/pman.sock, or /tmp/pman-<uid>.sock without it.
+ */
+void defaultSocketPath(char *path, size_t size) {
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+    if (runtime_dir != NULL && runtime_dir[0] != '\0') {
+        snprintf(path, size, "%s/pman.sock", runtime_dir);
+    }
+    else {
+        snprintf(path, size, "/tmp/pman-%u.sock", (unsigned) getuid());
+    }
+}
+
+// Function to write the length of a frame into its 4 byte header
+void putFrameHeader(char *header, uint32_t len) {
+    uint32_t net_len = htonl(len);
+    memcpy(header, &net_len, FRAME_HEADER_SIZE);
+}
+
+// Function to read the length out of a 4 byte frame header
+uint32_t getFrameHeader(const char *header) {
+    uint32_t net_len;
+    memcpy(&net_len, header, FRAME_HEADER_SIZE);
+    return ntohl(net_len);
+}
+
+// Writes all of buf to a blocking fd, returns 0 or -1
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Reads exactly len bytes from a blocking fd, returns 0 or -1 (EOF too)
+static int read_all(int fd, char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+
+        if (n == 0) {
+            return -1;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*  Function to send one frame over a blocking socket.
+    Header and data go out in a single send when they fit.
+    Returns 0 on success, -1 on failure.
+ */
+int sendFrame(int fd, const char *data, uint32_t len) {
+    char small[4096];
+
+    if (len <= sizeof(small) - FRAME_HEADER_SIZE) {
+        putFrameHeader(small, len);
+        memcpy(small + FRAME_HEADER_SIZE, data, len);
+        return write_all(fd, small, FRAME_HEADER_SIZE + len);
+    }
+
+    char header[FRAME_HEADER_SIZE];
+    putFrameHeader(header, len);
+    if (write_all(fd, header, FRAME_HEADER_SIZE) == -1) {
+        return -1;
+    }
+    return write_all(fd, data, len);
+}
+
+/*  Function to receive one frame from a blocking socket.
+    Returns the malloc'd data with a '\0' after it and sets *len,
+    or NULL if the connection closed or failed.
+ */
+char * recvFrame(int fd, uint32_t *len) {
+    char header[FRAME_HEADER_SIZE];
+
+    if (read_all(fd, header, FRAME_HEADER_SIZE) == -1) {
+        return NULL;
+    }
+    *len = getFrameHeader(header);
+
+    char *data = malloc((size_t) *len + 1);
+    if (data == NULL) {
+        perror("malloc failed");
+        return NULL;
+    }
+    if (read_all(fd, data, *len) == -1) {
+        free(data);
+        return NULL;
+    }
+    data[*len] = '\0';
+    return data;
+}
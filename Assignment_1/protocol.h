@@ -0,0 +1,27 @@
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Control protocol between pman --daemon and pmanctl.
+    Every request and response is one frame: a 4 byte length in
+    network byte order followed by that many bytes of text. A request
+    is a command line as typed at the prompt ("bglist", "bg foo"),
+    the response is everything the command printed.
+ */
+#define FRAME_HEADER_SIZE 4
+
+// Longest request the daemon accepts, longer ones close the connection
+#define MAX_REQUEST_SIZE (1 << 20)
+
+
+void defaultSocketPath(char *path, size_t size);
+void putFrameHeader(char *header, uint32_t len);
+uint32_t getFrameHeader(const char *header);
+int sendFrame(int fd, const char *data, uint32_t len);
+char * recvFrame(int fd, uint32_t *len);
+
+
+
+#endif
@@ -0,0 +1,292 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include "ptop.h"
+#include "stats.h"
+
+// One line of the ptop display, rebuilt on every refresh
+typedef struct {
+    Job *job;
+    int has_rate;
+    double cpu_percent;
+    long rss_kb;
+    long rss_delta_kb;
+    double switch_rate;
+    double read_rate;         // storage bytes per second, ptop -s io only
+    double write_rate;
+    double syscall_rate;
+} PtopRow;
+
+static int active = 0;
+static JobTable *ptop_table = NULL;
+static long ptop_interval_ms = 1000;
+static int ptop_sort = PTOP_SORT_CPU;
+static int ptop_rows = 20;
+static int refreshes_left = 0;
+
+static Watch timer_watch;
+static int timer_created = 0;
+
+// Grown to the job count, reused across refreshes
+static PtopRow *rows = NULL;
+static size_t rows_capacity = 0;
+
+// Monotonic clock in seconds
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*  Adds a sample to the job's ring.
+    Returns 1 and copies the previous newest sample into *previous,
+    or 0 if this is the first sample of the job.
+ */
+static int push_history(Job *job, const HistoryEntry *entry, HistoryEntry *previous) {
+    JobHistory *history = job->history;
+    int has_previous = 0;
+
+    // The ring is allocated the first time a job is sampled and never again
+    if (history == NULL) {
+        history = calloc(1, sizeof(JobHistory));
+        countStat(COUNT_ALLOCS, 1);
+        if (history == NULL) {
+            perror("calloc failed");
+            exit(EXIT_FAILURE);
+        }
+        job->history = history;
+    }
+
+    if (history->count > 0) {
+        *previous = history->entries[history->head];
+        has_previous = 1;
+        history->head = (history->head + 1) % PTOP_HISTORY;
+    }
+    if (history->count < PTOP_HISTORY) {
+        history->count++;
+    }
+    history->entries[history->head] = *entry;
+    return has_previous;
+}
+
+/*  Samples every job once and fills rows.
+    Returns the number of rows, *sweep_seconds gets the sampling cost.
+ */
+static size_t sample_jobs(double *sweep_seconds) {
+    long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    double start = now_seconds();
+    size_t n = 0;
+
+    if (rows_capacity < ptop_table->count) {
+        rows_capacity = ptop_table->count * 2;
+        rows = realloc(rows, rows_capacity * sizeof(PtopRow));
+        countStat(COUNT_ALLOCS, 1);
+        if (rows == NULL) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (Job *job = ptop_table->first; job != NULL; job = job->next) {
+        ProcSample sample;
+        HistoryEntry entry;
+
+        /* Only the two cheapest files here, they hold everything the
+           sort needs. stat is read later for the rows actually shown.
+           io is read only when sorting by it. */
+        int io = ptop_sort == PTOP_SORT_IO;
+        if (sampleProc(&job->sampler, &sample, SAMPLE_SCHEDSTAT | SAMPLE_STATM | (io ? SAMPLE_IO : 0)) == -1) {
+            continue;
+        }
+        entry.time = now_seconds();
+        entry.run_time_ns = sample.run_time_ns;
+        entry.rss = sample.rss;
+        entry.timeslices = sample.timeslices;
+        entry.has_io = io;
+        entry.io_read = io ? sample.io.read_bytes : 0;
+        entry.io_write = io ? sample.io.write_bytes : 0;
+        entry.io_syscalls = io ? sample.io.syscr + sample.io.syscw : 0;
+
+        HistoryEntry previous;
+        int has_previous = push_history(job, &entry, &previous);
+        PtopRow *row = &rows[n++];
+
+        row->job = job;
+        row->rss_kb = sample.rss * page_kb;
+        row->has_rate = 0;
+        row->cpu_percent = 0;
+        row->rss_delta_kb = 0;
+        row->switch_rate = 0;
+        row->read_rate = 0;
+        row->write_rate = 0;
+        row->syscall_rate = 0;
+
+        if (has_previous && entry.time > previous.time) {
+            double elapsed = entry.time - previous.time;
+
+            row->has_rate = 1;
+            row->cpu_percent = (entry.run_time_ns - previous.run_time_ns) / 1e9 / elapsed * 100.0;
+            row->rss_delta_kb = (entry.rss - previous.rss) * page_kb;
+            row->switch_rate = (entry.timeslices - previous.timeslices) / elapsed;
+            if (io && previous.has_io) {
+                row->read_rate = (entry.io_read - previous.io_read) / elapsed;
+                row->write_rate = (entry.io_write - previous.io_write) / elapsed;
+                row->syscall_rate = (entry.io_syscalls - previous.io_syscalls) / elapsed;
+            }
+            else if (io) {
+                row->has_rate = 0;
+            }
+        }
+    }
+
+    *sweep_seconds = now_seconds() - start;
+    return n;
+}
+
+// qsort comparators, biggest first
+static int by_cpu(const void *a, const void *b) {
+    const PtopRow *x = a, *y = b;
+    return (y->cpu_percent > x->cpu_percent) - (y->cpu_percent < x->cpu_percent);
+}
+
+static int by_mem(const void *a, const void *b) {
+    const PtopRow *x = a, *y = b;
+    return (y->rss_kb > x->rss_kb) - (y->rss_kb < x->rss_kb);
+}
+
+static int by_io(const void *a, const void *b) {
+    const PtopRow *x = a, *y = b;
+    double x_rate = x->read_rate + x->write_rate, y_rate = y->read_rate + y->write_rate;
+    return (y_rate > x_rate) - (y_rate < x_rate);
+}
+
+// Name of a sort order for the header
+static const char *sort_name(int sort_by) {
+    switch (sort_by) {
+        case PTOP_SORT_MEM: return "memory";
+        case PTOP_SORT_IO:  return "io";
+        default:            return "cpu";
+    }
+}
+
+// Samples all jobs and redraws the screen in place
+static void refresh(void) {
+    double sweep_seconds;
+    size_t n = sample_jobs(&sweep_seconds);
+
+    qsort(rows, n, sizeof(PtopRow), ptop_sort == PTOP_SORT_MEM ? by_mem : ptop_sort == PTOP_SORT_IO ? by_io : by_cpu);
+
+    // Home the cursor and clear, so the table is redrawn in place
+    printf("\033[H\033[2J");
+    printf("ptop: %zu jobs, every %.1f s, sorted by %s (press enter to quit)\n",
+           ptop_table->count, ptop_interval_ms / 1000.0, sort_name(ptop_sort));
+    printf("sweep %.2f ms, %.3f%% of one core\n\n",
+           sweep_seconds * 1e3, sweep_seconds / (ptop_interval_ms / 1000.0) * 100.0);
+    if (ptop_sort == PTOP_SORT_IO) {
+        printf("%8s %5s %7s %12s %12s %10s  %s\n",
+               "PID", "STATE", "CPU%", "READ(KB/s)", "WRITE(KB/s)", "SYSC/s", "COMM");
+    }
+    else {
+        printf("%8s %5s %7s %10s %10s %9s  %s\n",
+               "PID", "STATE", "CPU%", "RSS(KB)", "dRSS(KB)", "CSW/s", "COMM");
+    }
+
+    for (size_t i = 0; i < n && (int)i < ptop_rows; i++) {
+        PtopRow *row = &rows[i];
+        ProcSample sample;
+
+        // State and name of the rows on screen
+        if (sampleProc(&row->job->sampler, &sample, SAMPLE_STAT) == -1) {
+            sample.state = '?';
+            sample.comm[0] = '\0';
+        }
+        if (ptop_sort == PTOP_SORT_IO && row->has_rate) {
+            printf("%8d %5c %7.1f %12.1f %12.1f %10.1f  %s\n", row->job->pid, sample.state,
+                   row->cpu_percent, row->read_rate / 1024, row->write_rate / 1024,
+                   row->syscall_rate, sample.comm);
+        }
+        else if (ptop_sort == PTOP_SORT_IO) {
+            printf("%8d %5c %7s %12s %12s %10s  %s\n", row->job->pid, sample.state,
+                   "-", "-", "-", "-", sample.comm);
+        }
+        else if (row->has_rate) {
+            printf("%8d %5c %7.1f %10ld %+10ld %9.1f  %s\n", row->job->pid, sample.state,
+                   row->cpu_percent, row->rss_kb, row->rss_delta_kb, row->switch_rate, sample.comm);
+        }
+        else {
+            printf("%8d %5c %7s %10ld %10s %9s  %s\n", row->job->pid, sample.state,
+                   "-", row->rss_kb, "-", "-", sample.comm);
+        }
+    }
+    fflush(stdout);
+}
+
+// Timer handler, one refresh per tick
+static void on_tick(Watch *watch, uint32_t events) {
+    readTimer(watch);
+    if (!active) {
+        return;
+    }
+    refresh();
+
+    // refreshes of 0 means run until the user stops it
+    if (refreshes_left > 0 && --refreshes_left == 0) {
+        stopPtop();
+    }
+}
+
+/*  Function to start the live view.
+    Every interval_ms all jobs of table are sampled and the screen is
+    redrawn. refreshes limits the number of redraws (0 for no limit).
+    Returns 0 on success, -1 if the timer could not be set up.
+ */
+int startPtop(JobTable *table, long interval_ms, int sort_by, int rows_shown, int refreshes) {
+    if (!timer_created) {
+        if (createTimer(&timer_watch, on_tick, NULL) == -1) {
+            return -1;
+        }
+        timer_created = 1;
+    }
+
+    ptop_table = table;
+    ptop_interval_ms = interval_ms;
+    ptop_sort = sort_by;
+    ptop_rows = rows_shown;
+    refreshes_left = refreshes;
+    active = 1;
+
+    // First redraw right away and counted, rates need a second sample
+    refresh();
+    if (refreshes_left > 0 && --refreshes_left == 0) {
+        active = 0;
+        return 0;
+    }
+    if (armTimer(&timer_watch, interval_ms, interval_ms) == -1) {
+        perror("timerfd_settime failed");
+        active = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Function to leave the live view
+void stopPtop(void) {
+    if (!active) {
+        return;
+    }
+    armTimer(&timer_watch, 0, 0);
+    active = 0;
+}
+
+// Returns 1 while the live view owns the screen
+int isPtopActive(void) {
+    return active;
+}
+
+// Function to free the history ring of a job that is going away
+void freeJobHistory(Job *job) {
+    free(job->history);
+    job->history = NULL;
+}
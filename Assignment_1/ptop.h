@@ -0,0 +1,43 @@
+#ifndef _PTOP_H_
+#define _PTOP_H_
+
+#include "job_table.h"
+
+// Samples kept per job, the ring is allocated once per job
+#define PTOP_HISTORY 16
+
+// One sample of a job as kept in its history ring
+typedef struct {
+    double time;                    // seconds on CLOCK_MONOTONIC
+    unsigned long long run_time_ns; // cpu time from schedstat
+    long rss;                       // pages
+    unsigned long timeslices;       // times scheduled in (context switches)
+    int has_io;                     // 1 if the io fields were read (ptop -s io)
+    unsigned long long io_read;     // bytes fetched from storage
+    unsigned long long io_write;    // bytes sent to storage
+    unsigned long long io_syscalls; // read and write syscalls
+} HistoryEntry;
+
+/*  Fixed-size ring of the newest PTOP_HISTORY samples of a job.
+    head is the slot of the newest sample.
+ */
+struct JobHistory{
+    unsigned int head;
+    unsigned int count;
+    HistoryEntry entries[PTOP_HISTORY];
+};
+
+// Orders for the ptop rows
+#define PTOP_SORT_CPU 0
+#define PTOP_SORT_MEM 1
+#define PTOP_SORT_IO  2
+
+
+int startPtop(JobTable *table, long interval_ms, int sort_by, int rows, int refreshes);
+void stopPtop(void);
+int isPtopActive(void);
+void freeJobHistory(Job *job);
+
+
+
+#endif
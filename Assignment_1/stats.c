@@ -0,0 +1,189 @@
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <limits.h>
+#include "event_loop.h"
+#include "stats.h"
+
+// Names printed by stats, in STAT_ order
+static const char *stat_names[STAT_COUNT] = {
+    "bg", "bgmany", "bglist", "bgkill", "bgstop", "bgstart", "bgqueue", "bglog",
+    "bgplace", "pstat", "pstat --all", "ptop", "stats", "unknown", "reap", "sigchld",
+    "bghistory", "pstat --mem", "bgperf", "pstat --perf",
+    "pstat --io", "bgrenice", "bgdeps"
+};
+
+static LatencyHistogram histograms[STAT_COUNT];
+uint64_t stat_counters[COUNT_COUNT];
+
+// When the numbers were last reset
+static uint64_t since_ns;
+
+// What one recordLatency() costs, measured by initStats()
+static double record_cost_ns;
+
+// stats -o: the file the numbers are written to every interval
+static Watch dump_watch = {-1, NULL, NULL};
+static char dump_path[PATH_MAX];
+
+// Function to read the monotonic clock in nanoseconds
+uint64_t statClock(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Adds one latency to a histogram
+static void add_sample(LatencyHistogram *histogram, uint64_t ns) {
+    int bucket = (ns == 0) ? 0 : 64 - __builtin_clzll(ns);
+
+    if (bucket >= STAT_BUCKETS) {
+        bucket = STAT_BUCKETS - 1;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_ns += ns;
+    if (ns > histogram->max_ns) {
+        histogram->max_ns = ns;
+    }
+}
+
+/*  Function to set up the histograms.
+    Also times a batch of recordings, so stats can tell how much
+    of the recorded time the recording itself took.
+ */
+void initStats(void) {
+    LatencyHistogram scratch;
+    const int rounds = 100000;
+
+    memset(&scratch, 0, sizeof(scratch));
+    uint64_t start = statClock();
+    for (int i = 0; i < rounds; i++) {
+        add_sample(&scratch, statClock() - start);
+    }
+    // One recording reads the clock twice, the loop read it once per round
+    record_cost_ns = 2.0 * (statClock() - start) / rounds;
+    resetStats();
+}
+
+/*  Function to record how long something took, start_ns is the
+    statClock() reading from when it began.
+ */
+void recordLatency(int which, uint64_t start_ns) {
+    add_sample(&histograms[which], statClock() - start_ns);
+}
+
+// Function to clear all histograms and counters
+void resetStats(void) {
+    memset(histograms, 0, sizeof(histograms));
+    memset(stat_counters, 0, sizeof(stat_counters));
+    since_ns = statClock();
+}
+
+/*  Latency under which a fraction of the samples fall, in ns.
+    The upper edge of the bucket it lands in, never above the maximum.
+ */
+static uint64_t percentile(const LatencyHistogram *histogram, double fraction) {
+    uint64_t wanted = (uint64_t) (fraction * histogram->count + 0.999999);
+    uint64_t seen = 0;
+
+    for (int b = 0; b < STAT_BUCKETS; b++) {
+        seen += histogram->buckets[b];
+        if (seen >= wanted) {
+            uint64_t edge = 1ull << b;
+            return (edge < histogram->max_ns) ? edge : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+// Function to print every histogram that has samples, the counters and the recording cost
+void printStats(FILE *out) {
+    uint64_t records = 0;
+    uint64_t recorded_ns = 0;
+
+    fprintf(out, "%-12s %9s %10s %10s %10s %10s %10s\n",
+            "latency(us)", "count", "mean", "p50", "p90", "p99", "max");
+    for (int i = 0; i < STAT_COUNT; i++) {
+        const LatencyHistogram *histogram = &histograms[i];
+
+        if (histogram->count == 0) {
+            continue;
+        }
+        fprintf(out, "%-12s %9llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", stat_names[i],
+                (unsigned long long) histogram->count,
+                histogram->total_ns / 1e3 / histogram->count,
+                percentile(histogram, 0.50) / 1e3, percentile(histogram, 0.90) / 1e3,
+                percentile(histogram, 0.99) / 1e3, histogram->max_ns / 1e3);
+        records += histogram->count;
+        recorded_ns += histogram->total_ns;
+    }
+
+    fprintf(out, "syscalls     %llu\n", (unsigned long long) stat_counters[COUNT_SYSCALLS]);
+    fprintf(out, "/proc reads  %llu\n", (unsigned long long) stat_counters[COUNT_PROC_READS]);
+    fprintf(out, "allocations  %llu\n", (unsigned long long) stat_counters[COUNT_ALLOCS]);
+    fprintf(out, "over         %.1f s\n", (statClock() - since_ns) / 1e9);
+
+    double overhead_ns = records * record_cost_ns;
+    fprintf(out, "recording    %llu x %.0f ns = %.3f ms, %.2f%% of the recorded time\n",
+            (unsigned long long) records, record_cost_ns, overhead_ns / 1e6,
+            recorded_ns > 0 ? 100.0 * overhead_ns / recorded_ns : 0.0);
+}
+
+/*  Writes the numbers to the dump file.
+    Through a temporary file and rename(), so a reader never sees half a dump.
+ */
+static int write_dump(void) {
+    char tmp_path[PATH_MAX + 8];
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", dump_path);
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL) {
+        perror(tmp_path);
+        return -1;
+    }
+    printStats(file);
+    if (fclose(file) != 0 || rename(tmp_path, dump_path) == -1) {
+        perror(dump_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Runs every dump interval
+static void on_dump_timer(Watch *watch, uint32_t events) {
+    readTimer(watch);
+    if (write_dump() == -1) {
+        stopStatsDump();
+    }
+}
+
+/*  Function to write the numbers to path now and then every interval_ms.
+    Returns 0 on success, -1 if the file cannot be written.
+ */
+int startStatsDump(const char *path, long interval_ms) {
+    snprintf(dump_path, sizeof(dump_path), "%s", path);
+    if (write_dump() == -1) {
+        dump_path[0] = '\0';
+        return -1;
+    }
+    if (dump_watch.fd == -1 && createTimer(&dump_watch, on_dump_timer, NULL) == -1) {
+        dump_path[0] = '\0';
+        return -1;
+    }
+    return armTimer(&dump_watch, interval_ms, interval_ms);
+}
+
+// Function to stop writing the dump file
+void stopStatsDump(void) {
+    if (dump_watch.fd != -1) {
+        armTimer(&dump_watch, 0, 0);
+    }
+    dump_path[0] = '\0';
+}
+
+// Returns the file stats -o writes to, NULL if none
+const char * statsDumpPath(void) {
+    return dump_path[0] ? dump_path : NULL;
+}
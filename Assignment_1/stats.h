@@ -0,0 +1,72 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// What a latency is recorded for: every command, the reaper and the SIGCHLD handler
+#define STAT_BG         0
+#define STAT_BGMANY     1
+#define STAT_BGLIST     2
+#define STAT_BGKILL     3
+#define STAT_BGSTOP     4
+#define STAT_BGSTART    5
+#define STAT_BGQUEUE    6
+#define STAT_BGLOG      7
+#define STAT_BGPLACE    8
+#define STAT_PSTAT      9
+#define STAT_PSTAT_ALL  10
+#define STAT_PTOP       11
+#define STAT_STATS      12
+#define STAT_UNKNOWN    13
+#define STAT_REAP       14
+#define STAT_SIGCHLD    15
+#define STAT_BGHISTORY  16
+#define STAT_PSTAT_MEM  17
+#define STAT_BGPERF     18
+#define STAT_PSTAT_PERF 19
+#define STAT_PSTAT_IO   20
+#define STAT_BGRENICE   21
+#define STAT_BGDEPS     22
+#define STAT_COUNT      23
+
+// Counters, bumped with countStat()
+#define COUNT_SYSCALLS   0   // syscalls pman itself issues on its command and event paths
+#define COUNT_PROC_READS 1   // reads of /proc files
+#define COUNT_ALLOCS     2   // malloc, realloc and strdup calls by pman's own code
+#define COUNT_COUNT      3
+
+// Buckets of a histogram, bucket b holds latencies in [2^(b-1), 2^b) ns
+#define STAT_BUCKETS 40
+
+/*  Latency histogram of one command.
+    Log2 buckets keep recording to a shift and an increment, and still
+    give percentiles to within a factor of two.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[STAT_BUCKETS];
+} LatencyHistogram;
+
+extern uint64_t stat_counters[COUNT_COUNT];
+
+// Adds n to a counter, cheap enough for every syscall site
+static inline void countStat(int which, uint64_t n) {
+    stat_counters[which] += n;
+}
+
+
+void initStats(void);
+uint64_t statClock(void);
+void recordLatency(int which, uint64_t start_ns);
+void resetStats(void);
+void printStats(FILE *out);
+int startStatsDump(const char *path, long interval_ms);
+void stopStatsDump(void);
+const char * statsDumpPath(void);
+
+
+
+#endif
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include "bg_options.h"
+#include "supervisor.h"
+#include "stats.h"
+
+/*  Jobs waiting to be started again, the newest first.
+    Their delays are timers on the timer wheel, the list is only for
+    bglist and bgkill.
+ */
+static Supervisor *first_pending = NULL;
+static size_t pending_count = 0;
+
+static restart_handler on_restart = NULL;
+
+// Takes sup off the pending restart list
+static void unlink_pending(Supervisor *sup) {
+    if (sup->prev != NULL) {
+        sup->prev->next = sup->next;
+    }
+    else {
+        first_pending = sup->next;
+    }
+    if (sup->next != NULL) {
+        sup->next->prev = sup->prev;
+    }
+    sup->prev = NULL;
+    sup->next = NULL;
+    pending_count--;
+}
+
+// Runs when the delay of a restart has passed
+static void on_restart_due(Timer *timer) {
+    Supervisor *sup = timer->data;
+
+    unlink_pending(sup);
+    on_restart(sup);
+}
+
+// Function to set the handler that starts a job again once its delay has passed
+void initSupervisor(restart_handler handler) {
+    on_restart = handler;
+}
+
+// Copies the option string at *field into p, returns where the next one goes
+static char * copy_option(const char **field, char *p) {
+    if (*field == NULL) {
+        return p;
+    }
+    size_t len = strlen(*field) + 1;
+    memcpy(p, *field, len);
+    *field = p;
+    return p + len;
+}
+
+/*  Function to keep what is needed to start path with argv and opts
+    again. argv and the option strings are copied into one block.
+ */
+Supervisor * newSupervisor(const char *path, char **argv, const BgOptions *opts) {
+    size_t argc = 0;
+    size_t size = 0;
+
+    for (; argv[argc] != NULL; argc++) {
+        size += strlen(argv[argc]) + 1;
+    }
+    const char *strings[] = {opts->group, opts->pgroup, opts->tags};
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        size += (strings[i] != NULL) ? strlen(strings[i]) + 1 : 0;
+    }
+
+    Supervisor *sup = calloc(1, sizeof(Supervisor));
+    countStat(COUNT_ALLOCS, 1);
+    if (sup != NULL) {
+        sup->path = strdup(path);
+        sup->argv = malloc((argc + 1) * sizeof(char *));
+        sup->strings = malloc(size ? size : 1);
+        sup->opts = malloc(sizeof(BgOptions));
+        countStat(COUNT_ALLOCS, 4);
+    }
+    if (sup == NULL || sup->path == NULL || sup->argv == NULL || sup->strings == NULL || sup->opts == NULL) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    initTimer(&sup->timer, on_restart_due, sup);
+
+    char *p = sup->strings;
+    for (size_t i = 0; i < argc; i++) {
+        size_t len = strlen(argv[i]) + 1;
+        memcpy(p, argv[i], len);
+        sup->argv[i] = p;
+        p += len;
+    }
+    sup->argv[argc] = NULL;
+
+    *sup->opts = *opts;
+    // Prerequisites only hold for the first start, restarts do not wait
+    sup->opts->after = NULL;
+    sup->opts->after_ok = NULL;
+    p = copy_option(&sup->opts->group, p);
+    p = copy_option(&sup->opts->pgroup, p);
+    copy_option(&sup->opts->tags, p);
+    return sup;
+}
+
+// Function to free a supervisor whose restart timer is stopped or was never started
+void freeSupervisor(Supervisor *sup) {
+    if (sup == NULL) {
+        return;
+    }
+    free(sup->path);
+    free(sup->argv);
+    free(sup->strings);
+    free(sup->opts);
+    free(sup);
+}
+
+// Returns 1 if the policy restarts a job that ended with wait status
+int wantsRestart(const Supervisor *sup, int status) {
+    if (sup->opts->restart == RESTART_ALWAYS) {
+        return 1;
+    }
+    if (sup->opts->restart == RESTART_ON_FAILURE) {
+        return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    return 0;
+}
+
+/*  Function to count one more restart of a job that ran for ran_ns.
+    Returns the delay before it in ms: the first delay doubled for every
+    restart in a row, at most MAX_BACKOFF_MS. A run of STABLE_RUN_MS or
+    more starts the count again. Returns -1 once max restarts are used up.
+ */
+long nextBackoff(Supervisor *sup, uint64_t ran_ns) {
+    if (ran_ns >= (uint64_t) STABLE_RUN_MS * 1000000) {
+        sup->restarts = 0;
+    }
+    if (sup->restarts >= sup->opts->max_restarts) {
+        return -1;
+    }
+
+    long delay = sup->opts->backoff_ms;
+    for (int i = 0; i < sup->restarts && delay < MAX_BACKOFF_MS; i++) {
+        delay *= 2;
+    }
+    sup->restarts++;
+    sup->total++;
+    return (delay < MAX_BACKOFF_MS) ? delay : MAX_BACKOFF_MS;
+}
+
+// Function to start the job of sup again after delay_ms
+void scheduleRestart(Supervisor *sup, long delay_ms) {
+    sup->prev = NULL;
+    sup->next = first_pending;
+    if (first_pending != NULL) {
+        first_pending->prev = sup;
+    }
+    first_pending = sup;
+    pending_count++;
+    startTimer(&sup->timer, delay_ms);
+}
+
+/*  Function to drop the pending restart of the job that last ran as pid.
+    Returns its supervisor for the caller to free, NULL if there was none.
+ */
+Supervisor * cancelRestart(pid_t pid) {
+    for (Supervisor *sup = first_pending; sup != NULL; sup = sup->next) {
+        if (sup->last_pid == pid) {
+            stopTimer(&sup->timer);
+            unlink_pending(sup);
+            return sup;
+        }
+    }
+    return NULL;
+}
+
+// Returns the number of jobs waiting to be started again
+size_t pendingRestarts(void) {
+    return pending_count;
+}
+
+// Function to print every job waiting to be started again
+void printPendingRestarts(void) {
+    for (Supervisor *sup = first_pending; sup != NULL; sup = sup->next) {
+        printf("%d: %s restarting in %.1f s (restart %d of %d)\n", sup->last_pid, sup->path,
+               timerRemaining(&sup->timer) / 1000.0, sup->restarts, sup->opts->max_restarts);
+    }
+}
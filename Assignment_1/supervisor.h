@@ -0,0 +1,53 @@
+#ifndef _SUPERVISOR_H_
+#define _SUPERVISOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "timer_wheel.h"
+
+// Longest wait between restarts, however often the job failed
+#define MAX_BACKOFF_MS (5 * 60 * 1000)
+
+// A run at least this long counts as healthy, the next failure starts from the first delay again
+#define STABLE_RUN_MS (60 * 1000)
+
+typedef struct Supervisor Supervisor;
+typedef struct BgOptions BgOptions;
+typedef struct Dependents Dependents;
+
+// Called when a restart is due, the handler starts the job again
+typedef void (*restart_handler)(Supervisor *sup);
+
+/*  What pman needs to start a job again (bg --restart).
+    Owned by the running Job, or by its restart timer while the
+    job waits to be started again.
+ */
+struct Supervisor{
+    char * path;              // resolved executable
+    char ** argv;             // NULL terminated, strings live in strings
+    char * strings;           // argv and the option strings in one block
+    BgOptions * opts;         // copy of the bg options
+    int restarts;             // restarts in a row, reset by a stable run
+    unsigned long total;      // restarts ever
+    pid_t last_pid;           // pid of the last run, bgkill cancels a pending restart with it
+    Timer timer;              // pending restart on the timer wheel
+    Supervisor * prev;        // in the pending restart list
+    Supervisor * next;
+    Dependents * dependents;  // bg --after jobs waiting for it, kept here between runs
+};
+
+
+void initSupervisor(restart_handler handler);
+Supervisor * newSupervisor(const char *path, char **argv, const BgOptions *opts);
+void freeSupervisor(Supervisor *sup);
+int wantsRestart(const Supervisor *sup, int status);
+long nextBackoff(Supervisor *sup, uint64_t ran_ns);
+void scheduleRestart(Supervisor *sup, long delay_ms);
+Supervisor * cancelRestart(pid_t pid);
+size_t pendingRestarts(void);
+void printPendingRestarts(void);
+
+
+
+#endif
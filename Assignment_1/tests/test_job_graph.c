@@ -0,0 +1,189 @@
+/*
+    Checks the bg --after scheduler in job_graph.c without starting
+    anything. A job is stood in for by the Dependents list it owns,
+    and start_ready() does what pump_graph() in main.c does with the
+    nodes that come out: cancel the failed ones, start the others.
+
+    Run: make test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../job_graph.h"
+
+static int failures = 0;
+
+// Prints what did not match, the run goes on so every failure is shown
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#define MAX_NODES 16
+
+// Ids of the nodes started and cancelled so far, in order
+static int started[MAX_NODES];
+static int cancelled[MAX_NODES];
+static int started_count = 0;
+static int cancelled_count = 0;
+
+// Dependents of the nodes that were started, by id, for ending them later
+static Dependents *running_deps[MAX_NODES + 1];
+
+/*  Takes every node the graph lets go of, like pump_graph(). A failed
+    node is cancelled and fails its own dependents in turn.
+ */
+static void start_ready(JobGraph *graph) {
+    GraphNode *node;
+
+    while ((node = nextReady(graph)) != NULL) {
+        if (node->failed) {
+            cancelled[cancelled_count++] = node->id;
+            releaseDependents(graph, node->dependents, 0);
+        }
+        else {
+            started[started_count++] = node->id;
+            running_deps[node->id] = node->dependents;
+            graph->running++;
+        }
+        freeGraphNode(node);
+    }
+}
+
+// Ends a started node, exited with 0 if ok
+static void end_node(JobGraph *graph, int id, int ok) {
+    graph->running--;
+    releaseDependents(graph, running_deps[id], ok);
+    running_deps[id] = NULL;
+    start_ready(graph);
+}
+
+static void reset(JobGraph *graph, int limit) {
+    initJobGraph(graph, limit);
+    started_count = 0;
+    cancelled_count = 0;
+    memset(running_deps, 0, sizeof(running_deps));
+}
+
+/*  job -> A (--after-ok job) -> B (--after-ok A), C (--after A).
+    The job fails: A is cancelled, so B is too, but C only needed A
+    to end and still runs.
+ */
+static void test_after_ok_failure(void) {
+    JobGraph graph;
+    Dependents *job = NULL;
+
+    reset(&graph, 4);
+    GraphNode *a = newGraphNode(&graph, NULL);
+    addDependent(&job, a, 1);
+    GraphNode *b = newGraphNode(&graph, NULL);
+    addDependent(&a->dependents, b, 1);
+    GraphNode *c = newGraphNode(&graph, NULL);
+    addDependent(&a->dependents, c, 0);
+    CHECK(graph.waiting == 3);
+    CHECK(a->waiting == 1 && b->waiting == 1 && c->waiting == 1);
+
+    start_ready(&graph);
+    CHECK(started_count == 0 && cancelled_count == 0);
+
+    releaseDependents(&graph, job, 0);
+    start_ready(&graph);
+    CHECK(cancelled_count == 2);
+    CHECK(cancelled[0] == 1 && cancelled[1] == 2);
+    CHECK(started_count == 1 && started[0] == 3);
+    CHECK(graph.waiting == 0 && graph.ready == 0);
+    end_node(&graph, 3, 1);
+}
+
+// With --after alone a failed prerequisite does not cancel anything
+static void test_after_runs_anyway(void) {
+    JobGraph graph;
+    Dependents *job = NULL;
+
+    reset(&graph, 4);
+    GraphNode *a = newGraphNode(&graph, NULL);
+    addDependent(&job, a, 0);
+    releaseDependents(&graph, job, 0);
+    start_ready(&graph);
+    CHECK(started_count == 1 && cancelled_count == 0);
+    end_node(&graph, 1, 0);
+}
+
+/*  A node waits for every prerequisite, the --after-ok one failing
+    marks it but it stays until the last one has ended too.
+ */
+static void test_waits_for_all(void) {
+    JobGraph graph;
+    Dependents *first = NULL;
+    Dependents *second = NULL;
+
+    reset(&graph, 4);
+    GraphNode *a = newGraphNode(&graph, NULL);
+    addDependent(&first, a, 1);
+    addDependent(&second, a, 0);
+    CHECK(a->waiting == 2);
+
+    releaseDependents(&graph, first, 0);
+    CHECK(a->waiting == 1 && a->failed);
+    start_ready(&graph);
+    CHECK(cancelled_count == 0 && graph.waiting == 1);
+
+    releaseDependents(&graph, second, 1);
+    start_ready(&graph);
+    CHECK(cancelled_count == 1 && started_count == 0);
+}
+
+/*  Six nodes after one job with a limit of 2: two start, the next
+    starts as one ends, in the order they were added. A cancelled
+    node needs no slot and comes out even while both are in use.
+ */
+static void test_limit(void) {
+    JobGraph graph;
+    Dependents *job = NULL;
+    Dependents *other = NULL;
+
+    reset(&graph, 2);
+    for (int i = 0; i < 5; i++) {
+        addDependent(&job, newGraphNode(&graph, NULL), 0);
+    }
+    GraphNode *failing = newGraphNode(&graph, NULL);
+    addDependent(&other, failing, 1);
+
+    releaseDependents(&graph, job, 1);
+    start_ready(&graph);
+    CHECK(started_count == 2 && started[0] == 1 && started[1] == 2);
+    CHECK(graph.running == 2 && graph.ready == 3 && graph.waiting == 1);
+
+    end_node(&graph, 1, 1);
+    CHECK(started_count == 3 && started[2] == 3);
+    CHECK(graph.running == 2 && graph.ready == 2);
+
+    // Let the queue drain so the failed node is at the head while full
+    end_node(&graph, 2, 1);
+    end_node(&graph, 3, 1);
+    CHECK(started_count == 5 && graph.ready == 0 && graph.running == 2);
+    releaseDependents(&graph, other, 0);
+    start_ready(&graph);
+    CHECK(cancelled_count == 1 && cancelled[0] == 6);
+    CHECK(graph.running == 2 && graph.waiting == 0 && graph.ready == 0);
+
+    end_node(&graph, 4, 1);
+    end_node(&graph, 5, 1);
+    CHECK(graph.running == 0);
+}
+
+int main(void) {
+    test_after_ok_failure();
+    test_after_runs_anyway();
+    test_waits_for_all();
+    test_limit();
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("job_graph: all checks passed\n");
+    return 0;
+}
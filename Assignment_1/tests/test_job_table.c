@@ -0,0 +1,142 @@
+/*
+    Checks the pid hash in job_table.c. The table is included here so
+    the test can pick pids by their home slot and build probe clusters
+    on purpose: deleting from the middle of one shifts the later
+    entries back, and every pid left must still be found.
+
+    Run: make test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../job_table.c"
+
+static int failures = 0;
+
+// Prints what did not match, the run goes on so every failure is shown
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// Finds the next pid after *pid whose home slot is home
+static pid_t next_pid_at(const JobTable *table, size_t home, pid_t *pid) {
+    do {
+        (*pid)++;
+    } while (home_slot(table, *pid) != home);
+    return *pid;
+}
+
+/*  Every job must be reachable: no empty slot between its home slot
+    and where it sits, and findJob returns it. The insertion order
+    list must hold the same jobs.
+ */
+static void check_table(JobTable *table) {
+    size_t mask = table->capacity - 1;
+    size_t listed = 0;
+
+    for (Job *job = table->first; job != NULL; job = job->next) {
+        listed++;
+        CHECK(findJob(table, job->pid) == job);
+        for (size_t i = home_slot(table, job->pid); table->slots[i] != job; i = (i + 1) & mask) {
+            if (table->slots[i] == NULL) {
+                printf("FAIL: pid %d is past an empty slot\n", job->pid);
+                failures++;
+                break;
+            }
+        }
+    }
+    CHECK(listed == table->count);
+}
+
+/*  Builds one cluster from home: four pids that all start at home,
+    with two more whose home is one and two slots further in between.
+    Then takes entries out of the middle of it one at a time.
+ */
+static void test_cluster(size_t home) {
+    JobTable table;
+    pid_t pid = 1000;
+    pid_t pids[6];
+
+    initJobTable(&table);
+    size_t mask = table.capacity - 1;
+    pids[0] = next_pid_at(&table, home, &pid);
+    pids[1] = next_pid_at(&table, home, &pid);
+    pids[2] = next_pid_at(&table, (home + 1) & mask, &pid);
+    pids[3] = next_pid_at(&table, home, &pid);
+    pids[4] = next_pid_at(&table, (home + 2) & mask, &pid);
+    pids[5] = next_pid_at(&table, home, &pid);
+    for (int i = 0; i < 6; i++) {
+        add_newJob(&table, pids[i], "/bin/true");
+    }
+    CHECK(table.capacity == 16);
+
+    // All six sit next to each other from home on
+    for (size_t i = 0; i < 6; i++) {
+        CHECK(table.slots[(home + i) & mask] != NULL);
+    }
+    check_table(&table);
+
+    // Middle first, then one whose home is inside the cluster, then the head
+    int order[] = {1, 2, 0, 4, 5, 3};
+    for (int n = 0; n < 6; n++) {
+        CHECK(deleteJob(&table, pids[order[n]]) == 1);
+        CHECK(findJob(&table, pids[order[n]]) == NULL);
+        check_table(&table);
+    }
+    CHECK(table.count == 0 && table.first == NULL);
+
+    // Nothing is left behind in the slots either
+    for (size_t i = 0; i < table.capacity; i++) {
+        CHECK(table.slots[i] == NULL);
+    }
+    freeJobTable(&table);
+}
+
+// Random adds and removes through several resizes, against a plain array
+static void test_random(void) {
+    enum { PIDS = 4096, ROUNDS = 200000 };
+    static char present[PIDS];
+    JobTable table;
+    size_t count = 0;
+
+    initJobTable(&table);
+    srand(1);
+    for (int round = 0; round < ROUNDS; round++) {
+        pid_t pid = 1 + rand() % (PIDS - 1);
+
+        if (present[pid]) {
+            removeJob(&table, findJob(&table, pid));
+            present[pid] = 0;
+            count--;
+        }
+        else {
+            add_newJob(&table, pid, "/bin/true");
+            present[pid] = 1;
+            count++;
+        }
+    }
+    CHECK(table.count == count);
+    for (pid_t pid = 1; pid < PIDS; pid++) {
+        Job *job = findJob(&table, pid);
+        CHECK(present[pid] ? (job != NULL && job->pid == pid) : job == NULL);
+    }
+    check_table(&table);
+    freeJobTable(&table);
+}
+
+int main(void) {
+    test_cluster(5);
+    // The cluster wraps round from the last slot to the first
+    test_cluster(14);
+    test_random();
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("job_table: all checks passed\n");
+    return 0;
+}
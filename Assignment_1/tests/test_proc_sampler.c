@@ -0,0 +1,107 @@
+/*
+    Checks the /proc parsers in proc_sampler.c on fixed input.
+    Process names may hold spaces and ')', and status may be much
+    longer than usual on hosts with many cpus.
+
+    Run: make test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../proc_sampler.h"
+
+static int failures = 0;
+
+// Prints what did not match, the run goes on so every failure is shown
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// Fields 4 to 52 of a stat line, ppid 1, utime 14, stime 15, starttime 22, processor 39
+#define STAT_TAIL " S 1 100 100 0 -1 4194304 7 0 3 0 14 15 0 0 20 0 2 0 22 23 24 " \
+                  "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 39 0 41 0 0 0 0 0 0 0 0 0 0 0\n"
+
+// Parses line with parseProcStat, returns what it returned
+static int parse_stat(const char *line, ProcSample *sample) {
+    memset(sample, 0, sizeof(*sample));
+    return parseProcStat(line, strlen(line), sample);
+}
+
+static void test_stat_comm(void) {
+    ProcSample sample;
+
+    CHECK(parse_stat("1234 (sleep)" STAT_TAIL, &sample) == 0);
+    CHECK(strcmp(sample.comm, "sleep") == 0);
+    CHECK(sample.state == 'S');
+    CHECK(sample.ppid == 1);
+
+    // The last ')' ends the name, so the fields after it stay in place
+    CHECK(parse_stat("1234 (a b) c)" STAT_TAIL, &sample) == 0);
+    CHECK(strcmp(sample.comm, "a b) c") == 0);
+    CHECK(sample.state == 'S');
+    CHECK(sample.ppid == 1);
+    CHECK(sample.utime == 14);
+    CHECK(sample.stime == 15);
+    CHECK(sample.num_threads == 2);
+    CHECK(sample.starttime == 22);
+    CHECK(sample.vsize == 23);
+    CHECK(sample.rss == 24);
+    CHECK(sample.processor == 39);
+    CHECK(sample.policy == 41);
+
+    CHECK(parse_stat("1234 ((x)" STAT_TAIL, &sample) == 0);
+    CHECK(strcmp(sample.comm, "(x") == 0);
+    CHECK(parse_stat("1234 ()" STAT_TAIL, &sample) == 0);
+    CHECK(strcmp(sample.comm, "") == 0);
+    CHECK(sample.ppid == 1);
+}
+
+static void test_stat_malformed(void) {
+    ProcSample sample;
+
+    CHECK(parse_stat("1234 (no end S 1 2 3\n", &sample) == -1);
+    CHECK(parse_stat("1234 no name) S 1 2 3\n", &sample) == -1);
+    CHECK(parse_stat("1234 (name)", &sample) == -1);
+    CHECK(parse_stat("", &sample) == -1);
+}
+
+// The switch counts come last, after lines that can be very long
+static void test_status_long_lines(void) {
+    size_t mask = 64 * 1024;
+    char *buf = malloc(mask + 256);
+    ProcSample sample;
+
+    if (buf == NULL) {
+        printf("FAIL: malloc\n");
+        failures++;
+        return;
+    }
+    memset(&sample, 0, sizeof(sample));
+    strcpy(buf, "Name:\tsleep\nCpus_allowed:\t");
+    size_t len = strlen(buf);
+    memset(buf + len, 'f', mask);
+    len += mask;
+    strcpy(buf + len, "\nvoluntary_ctxt_switches:\t12\nnonvoluntary_ctxt_switches:\t3\n");
+    len += strlen(buf + len);
+
+    CHECK(parseProcStatus(buf, len, &sample) == 0);
+    CHECK(sample.voluntary_ctxt_switches == 12);
+    CHECK(sample.nonvoluntary_ctxt_switches == 3);
+    free(buf);
+}
+
+int main(void) {
+    test_stat_comm();
+    test_stat_malformed();
+    test_status_long_lines();
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("proc_sampler: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,200 @@
+/*
+    Checks the timer wheel in timer_wheel.c on a fake clock.
+    The wheel is included here so the test can drive advance() one
+    tick at a time: timers must fire exactly at their due tick across
+    the level boundaries, after the wheel skipped idle ticks, and
+    when they are moved or stopped while pending.
+
+    Run: make test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+// The wheel reads this instead of the monotonic clock
+static uint64_t fake_ns = 1000000000ull;
+
+static int fake_clock_gettime(clockid_t clock, struct timespec *ts) {
+    ts->tv_sec = fake_ns / 1000000000ull;
+    ts->tv_nsec = fake_ns % 1000000000ull;
+    return 0;
+}
+
+#define clock_gettime fake_clock_gettime
+#include "../timer_wheel.c"
+#undef clock_gettime
+
+static int failures = 0;
+
+// Prints what did not match, the run goes on so every failure is shown
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#define MAX_TIMERS 64
+
+// A timer with the ticks it fired at, data points back here
+typedef struct {
+    Timer timer;
+    int fired;
+    uint64_t fired_at;
+} TestTimer;
+
+static TestTimer timers[MAX_TIMERS];
+
+// Records the tick the timer fired at
+static void on_fire(Timer *timer) {
+    TestTimer *test = timer->data;
+
+    test->fired++;
+    test->fired_at = now_tick();
+}
+
+// Moves the fake clock to tick without running anything
+static void set_tick(uint64_t tick) {
+    fake_ns = origin_ns + tick * 1000000ull;
+}
+
+// Runs every tick up to and with last, as if the timerfd fired for each
+static void run_to(uint64_t last) {
+    for (uint64_t tick = now_tick() + 1; tick <= last; tick++) {
+        set_tick(tick);
+        advance(tick);
+    }
+}
+
+// Sets up count timers that have not fired
+static void reset_timers(int count) {
+    for (int i = 0; i < count; i++) {
+        initTimer(&timers[i].timer, on_fire, &timers[i]);
+        timers[i].fired = 0;
+        timers[i].fired_at = 0;
+    }
+}
+
+// Delays on both sides of where a timer moves up a level
+static void test_level_boundaries(void) {
+    static const long delays[] = {1, 2, 62, 63, 64, 65, 127, 128, 129, 4095, 4096, 4097, 5000, 262143, 262144, 300000};
+    int count = sizeof(delays) / sizeof(delays[0]);
+
+    // Start off a slot boundary so the levels are not aligned with the timers
+    run_to(now_tick() + 37);
+    uint64_t start = now_tick();
+    reset_timers(count);
+    for (int i = 0; i < count; i++) {
+        startTimer(&timers[i].timer, delays[i]);
+    }
+    CHECK(pendingTimers() == (size_t) count);
+
+    run_to(start + 300001);
+    for (int i = 0; i < count; i++) {
+        CHECK(timers[i].fired == 1);
+        CHECK(timers[i].fired_at == start + delays[i]);
+    }
+    CHECK(pendingTimers() == 0);
+}
+
+/*  A delay of 64 lands in the level 0 slot the wheel is at right now,
+    so it has to wait on level 1 and must not fire on this round.
+    Also from a position where the level 1 slot index wraps past 63.
+ */
+static void test_same_index(void) {
+    uint64_t starts[] = {100, 4030, 4095, 8191};
+
+    for (int s = 0; s < 4; s++) {
+        run_to(now_tick() + (starts[s] - now_tick() % 4096 + 4096) % 4096);
+        uint64_t start = now_tick();
+
+        reset_timers(3);
+        startTimer(&timers[0].timer, 64);
+        startTimer(&timers[1].timer, 4096);
+        startTimer(&timers[2].timer, 200);
+        run_to(start + 63);
+        CHECK(timers[0].fired == 0);
+        run_to(start + 4096);
+        CHECK(timers[0].fired == 1 && timers[0].fired_at == start + 64);
+        CHECK(timers[1].fired == 1 && timers[1].fired_at == start + 4096);
+        CHECK(timers[2].fired == 1 && timers[2].fired_at == start + 200);
+    }
+}
+
+// After a stretch with nothing pending the wheel skips ahead instead of visiting every slot
+static void test_skip_ahead(void) {
+    reset_timers(2);
+
+    // Nothing ran for a while, the new timer still waits its full delay
+    set_tick(now_tick() + 100000);
+    uint64_t start = now_tick();
+    startTimer(&timers[0].timer, 10);
+    CHECK(current == start + 1);
+    run_to(start + 9);
+    CHECK(timers[0].fired == 0);
+    run_to(start + 10);
+    CHECK(timers[0].fired == 1 && timers[0].fired_at == start + 10);
+
+    // The timerfd is late for a pending one, the wheel must not skip past it
+    start = now_tick();
+    startTimer(&timers[0].timer, 5);
+    set_tick(start + 50);
+    startTimer(&timers[1].timer, 5);
+    advance(start + 50);
+    CHECK(timers[0].fired == 2 && timers[0].fired_at == start + 50);
+    CHECK(timers[1].fired == 0);
+    run_to(start + 55);
+    CHECK(timers[1].fired == 1 && timers[1].fired_at == start + 55);
+}
+
+// Starting a pending timer again moves it, stopping it means it never fires
+static void test_restart_and_stop(void) {
+    uint64_t start = now_tick();
+
+    reset_timers(4);
+    startTimer(&timers[0].timer, 100);
+    startTimer(&timers[1].timer, 5000);
+    startTimer(&timers[2].timer, 70);
+    startTimer(&timers[3].timer, 3000);
+    CHECK(pendingTimers() == 4);
+
+    run_to(start + 50);
+    startTimer(&timers[0].timer, 100);   // later, from level 1 to level 1
+    startTimer(&timers[1].timer, 10);    // earlier, from level 2 to level 0
+    stopTimer(&timers[2].timer);
+    CHECK(pendingTimers() == 3);
+    CHECK(!timerPending(&timers[2].timer));
+    CHECK(timerRemaining(&timers[0].timer) == 100);
+
+    run_to(start + 2000);
+    stopTimer(&timers[3].timer);
+    stopTimer(&timers[3].timer);         // not pending any more, left alone
+    CHECK(pendingTimers() == 0);
+
+    run_to(start + 6000);
+    CHECK(timers[0].fired == 1 && timers[0].fired_at == start + 150);
+    CHECK(timers[1].fired == 1 && timers[1].fired_at == start + 60);
+    CHECK(timers[2].fired == 0);
+    CHECK(timers[3].fired == 0);
+}
+
+int main(void) {
+    if (initEventLoop() == -1 || initTimerWheel() == -1) {
+        printf("FAIL: could not set up the timer wheel\n");
+        return EXIT_FAILURE;
+    }
+
+    test_level_boundaries();
+    test_same_index();
+    test_skip_ahead();
+    test_restart_and_stop();
+
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("timer_wheel: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "event_loop.h"
+#include "timer_wheel.h"
+#include "stats.h"
+
+/*  Every deadline in pman (bg --timeout, restart delays) sits in one
+    hierarchical timer wheel. Level 0 has a slot per ms for the next
+    64 ms, level 1 a slot per 64 ms for the next 4 s and so on. A timer
+    goes into the slot its due tick falls in, on the lowest level that
+    reaches it, and moves down a level when its slot comes round, so
+    starting and stopping one is O(1) whatever the number pending.
+    One timerfd is armed for the next slot that has anything in it,
+    found with a bitmap per level, so pending timers cost nothing
+    until one of their slots is due.
+ */
+static Timer *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t occupied[WHEEL_LEVELS];   // bit i set while slot i has timers
+static uint64_t current = 0;              // next tick to run, no slot is due before it
+static size_t pending = 0;
+
+static Watch wheel_watch = {-1, NULL, NULL};
+static uint64_t origin_ns = 0;            // monotonic time of tick 0
+static uint64_t armed = UINT64_MAX;       // tick the timerfd fires at, UINT64_MAX if none
+
+// Monotonic clock in ms since the wheel was created
+static uint64_t now_tick(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec - origin_ns) / 1000000;
+}
+
+// First tick at or after current at which the slot comes round
+static uint64_t slot_tick(int level, int index) {
+    int shift = level * WHEEL_BITS;
+    uint64_t base = (current + (1ull << shift) - 1) >> shift;
+
+    return (base + ((index - base) & (WHEEL_SLOTS - 1))) << shift;
+}
+
+// Tick of the next slot that has timers, UINT64_MAX if there are none
+static uint64_t next_tick(void) {
+    uint64_t next = UINT64_MAX;
+
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if (occupied[level] == 0) {
+            continue;
+        }
+        int shift = level * WHEEL_BITS;
+        uint64_t base = (current + (1ull << shift) - 1) >> shift;
+        int pos = base & (WHEEL_SLOTS - 1);
+
+        // Rotated so bit 0 is the slot at base, the lowest set bit is the nearest slot
+        uint64_t bits = (occupied[level] >> pos) | (pos ? occupied[level] << (WHEEL_SLOTS - pos) : 0);
+        uint64_t tick = (base + __builtin_ctzll(bits)) << shift;
+        if (tick < next) {
+            next = tick;
+        }
+    }
+    return next;
+}
+
+// Arms the timerfd for tick unless it already fires by then
+static void arm_for(uint64_t tick) {
+    if (tick >= armed) {
+        return;
+    }
+    uint64_t now = now_tick();
+    armed = tick;
+    countStat(COUNT_SYSCALLS, 1);
+    armTimer(&wheel_watch, (tick > now) ? (long) (tick - now) : 1, 0);
+}
+
+/*  Puts a timer in the slot its due tick falls in, on the lowest level
+    that reaches that far. Returns the tick that slot comes round at.
+ */
+static uint64_t place(Timer *timer) {
+    uint64_t at = (timer->due > current) ? timer->due : current;
+
+    // Too far for the wheel, it comes round at the end and is placed again
+    if (at - current >= WHEEL_SPAN_MS) {
+        at = current + WHEEL_SPAN_MS - 1;
+    }
+    uint64_t delta = at - current;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ull << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    int index = (at >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+    Timer **head = &slots[level][index];
+
+    timer->slot = level * WHEEL_SLOTS + index;
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = timer;
+    }
+    *head = timer;
+    occupied[level] |= 1ull << index;
+    return slot_tick(level, index);
+}
+
+// Takes a pending timer out of its slot
+static void unlink_timer(Timer *timer) {
+    int level = timer->slot / WHEEL_SLOTS;
+    int index = timer->slot % WHEEL_SLOTS;
+
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    }
+    else {
+        slots[level][index] = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    if (slots[level][index] == NULL) {
+        occupied[level] &= ~(1ull << index);
+    }
+    timer->slot = -1;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/*  Runs every slot that is due by now. Higher levels are moved down
+    first, a timer may land in the level 0 slot that runs right after.
+ */
+static void advance(uint64_t now) {
+    uint64_t tick;
+
+    while ((tick = next_tick()) <= now) {
+        current = tick;
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            int shift = level * WHEEL_BITS;
+            if ((tick & ((1ull << shift) - 1)) != 0) {
+                continue;
+            }
+            Timer **head = &slots[level][(tick >> shift) & (WHEEL_SLOTS - 1)];
+            while (*head != NULL) {
+                Timer *timer = *head;
+                unlink_timer(timer);
+                place(timer);
+            }
+        }
+
+        // Timers the handlers start go into later slots, never this one
+        current = tick + 1;
+        Timer **head = &slots[0][tick & (WHEEL_SLOTS - 1)];
+        while (*head != NULL) {
+            Timer *timer = *head;
+            unlink_timer(timer);
+            if (timer->due > tick) {
+                place(timer);
+                continue;
+            }
+            pending--;
+            timer->handler(timer);
+        }
+    }
+
+    // Nothing is due before now, so the slots in between need not be visited
+    if (current <= now) {
+        current = now + 1;
+    }
+}
+
+// Runs when the next slot is due, fires its timers and arms for the one after
+static void on_wheel(Watch *watch, uint32_t events) {
+    readTimer(watch);
+    armed = UINT64_MAX;
+    advance(now_tick());
+    if (pending > 0) {
+        arm_for(next_tick());
+    }
+}
+
+/*  Function to create the timerfd that drives the wheel.
+    Returns 0 on success, -1 on failure.
+ */
+int initTimerWheel(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    origin_ns = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    return createTimer(&wheel_watch, on_wheel, NULL);
+}
+
+// Function to set up a timer that is not pending, handler runs with it once it is due
+void initTimer(Timer *timer, timer_handler handler, void *data) {
+    memset(timer, 0, sizeof(Timer));
+    timer->handler = handler;
+    timer->data = data;
+    timer->slot = -1;
+}
+
+/*  Function to make timer fire after delay_ms, a pending timer is
+    moved. Only a new earliest slot touches the timerfd.
+ */
+void startTimer(Timer *timer, long delay_ms) {
+    uint64_t now = now_tick();
+
+    if (timer->slot != -1) {
+        unlink_timer(timer);
+        pending--;
+    }
+    // Skip ahead over slots that are empty, unless the timerfd is late for one
+    if (next_tick() > now && current <= now) {
+        current = now + 1;
+    }
+    timer->due = now + (uint64_t) (delay_ms > 0 ? delay_ms : 0);
+    pending++;
+    arm_for(place(timer));
+}
+
+// Function to cancel a pending timer, one that is not pending is left alone
+void stopTimer(Timer *timer) {
+    // The timerfd stays armed, firing for nothing costs less than finding the next slot
+    if (timer->slot != -1) {
+        unlink_timer(timer);
+        pending--;
+    }
+}
+
+// Returns 1 if the timer is waiting to fire
+int timerPending(const Timer *timer) {
+    return timer->slot != -1;
+}
+
+// Returns the ms until a pending timer fires, 0 if it is due
+long timerRemaining(const Timer *timer) {
+    uint64_t now = now_tick();
+
+    return (timer->due > now) ? (long) (timer->due - now) : 0;
+}
+
+// Returns the number of pending timers
+size_t pendingTimers(void) {
+    return pending;
+}
@@ -0,0 +1,44 @@
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64 slots per level, a level covers 64 times the one below, the lowest 1 ms per slot
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 5
+
+// Longest delay the wheel holds, about 12 days. Longer ones go round again
+#define WHEEL_SPAN_MS (1ull << (WHEEL_BITS * WHEEL_LEVELS))
+
+typedef struct Timer Timer;
+
+// Called once the timer is due, it is no longer pending and may be started again
+typedef void (*timer_handler)(Timer *timer);
+
+/*  One deadline on the wheel.
+    Usually embedded in what it belongs to (a Job for its timeout),
+    data points back to that owner. Nothing is allocated for it.
+ */
+struct Timer{
+    uint64_t due;             // wheel tick (ms) it fires at
+    timer_handler handler;
+    void * data;
+    int slot;                 // level * WHEEL_SLOTS + index, -1 while not pending
+    Timer * prev;             // in its slot
+    Timer * next;
+};
+
+
+int initTimerWheel(void);
+void initTimer(Timer *timer, timer_handler handler, void *data);
+void startTimer(Timer *timer, long delay_ms);
+void stopTimer(Timer *timer);
+int timerPending(const Timer *timer);
+long timerRemaining(const Timer *timer);
+size_t pendingTimers(void);
+
+
+
+#endif